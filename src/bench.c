@@ -0,0 +1,1066 @@
+/* bench
+  Headless physics benchmark, loads a levels
+  collision through physfs and drives scripted
+  entities around it without a window or gl.
+
+  Also times octree builds on made up meshes
+  and skeletal animation sampling for crowds
+  of made up characters.
+
+  Prints JSON to stdout so runs can be diffed
+  and tracked for regressions.
+
+  usage: bench [level.iqm] [entities] [ticks]
+         bench fuzz [iterations]
+         bench cluster
+         bench frustum [iterations]
+
+  The fuzz mode checks the batched ellipsoid
+  sweep against the scalar one on random
+  triangles and exits non zero on mismatch.
+  The cluster mode checks light binning the
+  same way against a brute force search, the
+  frustum mode batched culling against the
+  single box and sphere tests.
+*/
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <time.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include <physfs.h>
+#include "exengine/engine.h"
+#include "exengine/scene.h"
+#include "exengine/iqm.h"
+#include "exengine/entity.h"
+#include "exengine/jobs.h"
+#include "exengine/frustum.h"
+
+#define BENCH_DT (1.0 / 60.0)
+#define BENCH_QUERIES 100000
+#define BENCH_RAYS 100000
+#define BENCH_SNAPSHOTS 1000
+#define BENCH_BONES 64
+#define BENCH_FRAMES 60
+#define BENCH_ANIM_TICKS 120
+
+// scripted entities are this big, like the player
+static vec3 bench_radius = {0.5f, 1.0f, 0.5f};
+
+static double bench_time()
+{
+#ifdef _WIN32
+  LARGE_INTEGER freq, count;
+  QueryPerformanceFrequency(&freq);
+  QueryPerformanceCounter(&count);
+  return (double)count.QuadPart / (double)freq.QuadPart;
+#else
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+#endif
+}
+
+// same sequence on every platform, unlike rand()
+static uint32_t bench_seed;
+static float bench_random(float min, float max)
+{
+  bench_seed = bench_seed * 1664525u + 1013904223u;
+  return min + (max - min) * (float)(bench_seed >> 8) / 16777216.0f;
+}
+
+static uint32_t bench_random_index(uint32_t len)
+{
+  bench_seed = bench_seed * 1664525u + 1013904223u;
+  return (bench_seed >> 8) % len;
+}
+
+// a random point on a floor facing triangle
+static void bench_floor_point(ex_scene_t *s, vec3 out)
+{
+  size_t len = s->coll_vertices_last / 3;
+  uint32_t tri;
+  for (int i=0; i<64; i++) {
+    tri = bench_random_index(len);
+    if (s->coll_cache.normal[1][tri] > 0.8f)
+      break;
+  }
+
+  vec3 *v = &s->coll_vertices[tri*3];
+  for (int i=0; i<3; i++)
+    out[i] = (v[0][i] + v[1][i] + v[2][i]) / 3.0f;
+}
+
+static double bench_build(ex_scene_t *s)
+{
+  double start = bench_time();
+  ex_scene_build_collision(s);
+  return (bench_time() - start) * 1e3;
+}
+
+/*
+  Rolling terrain made of unit quads, two
+  triangles each, for timing tree builds on
+  meshes far bigger than the level files.
+  Data is the first vertex index, like the
+  scenes collision tree.
+*/
+static ex_rect_t* bench_mesh(size_t tris, ex_rect_t *region)
+{
+  ex_rect_t *boxes = malloc(sizeof(ex_rect_t) * tris);
+  size_t side = (size_t)ceil(sqrt(tris / 2.0));
+
+  // hills scale with the mesh so its bounds stay
+  // roughly cubic and the tree splits all the way
+  float height = 0.25f * side, freq = 12.0f / side;
+
+  for (size_t i=0; i<tris; i++) {
+    size_t quad = i / 2;
+    float x = (float)(quad % side), z = (float)(quad / side);
+
+    vec3 tri[3];
+    for (int j=0; j<3; j++) {
+      // 0 1 2 and 1 3 2 of the quad
+      int corner = (i & 1) ? (j == 0 ? 1 : j == 1 ? 3 : 2) : j;
+      tri[j][0] = x + (corner & 1);
+      tri[j][2] = z + (corner >> 1);
+      tri[j][1] = height * sinf(tri[j][0] * freq) * cosf(tri[j][2] * freq);
+    }
+
+    boxes[i] = ex_rect_from_triangle(tri);
+    if (i == 0)
+      *region = boxes[i];
+    vec3_min(region->min, region->min, boxes[i].min);
+    vec3_max(region->max, region->max, boxes[i].max);
+  }
+
+  return boxes;
+}
+
+static double bench_mesh_build(ex_rect_t region, ex_rect_t *boxes, size_t tris, int parallel, ex_octree_compact_t **out)
+{
+  // the build reorders its input
+  ex_rect_t *b = malloc(sizeof(ex_rect_t) * tris);
+  uint32_t  *d = malloc(sizeof(uint32_t) * tris);
+  memcpy(b, boxes, sizeof(ex_rect_t) * tris);
+  for (size_t i=0; i<tris; i++)
+    d[i] = i * 3;
+
+  double start = bench_time();
+  ex_octree_compact_t *c;
+  if (parallel)
+    c = ex_octree_compact_build_parallel(region, b, d, tris);
+  else
+    c = ex_octree_compact_build(region, b, d, tris);
+  double time = (bench_time() - start) * 1e3;
+
+  free(b);
+  free(d);
+  *out = c;
+  return time;
+}
+
+static void bench_meshes()
+{
+  size_t sizes[] = {10000, 100000, 1000000, 5000000};
+  for (int i=0; i<4; i++) {
+    ex_rect_t region;
+    ex_rect_t *boxes = bench_mesh(sizes[i], &region);
+
+    ex_octree_compact_t *c;
+    double time = bench_mesh_build(region, boxes, sizes[i], 0, &c);
+    printf("%s{\"triangles\": %zu, \"octree_ms\": %.2f, \"nodes\": %zu}", i ? ", " : "", sizes[i], time, c->nodes_len);
+
+    ex_octree_compact_destroy(c);
+    free(boxes);
+  }
+}
+
+static int bench_same_tree(ex_octree_compact_t *a, ex_octree_compact_t *b)
+{
+  if (a->nodes_len != b->nodes_len || a->data_len != b->data_len)
+    return 0;
+
+  // field by field, the nodes have padding
+  for (size_t i=0; i<a->nodes_len; i++) {
+    ex_octree_node_t *na = &a->nodes[i], *nb = &b->nodes[i];
+    if (memcmp(&na->region, &nb->region, sizeof(ex_rect_t)) ||
+        na->first_child != nb->first_child || na->child_count != nb->child_count ||
+        na->data_first  != nb->data_first  || na->data_len    != nb->data_len)
+      return 0;
+  }
+
+  return !memcmp(a->data, b->data, sizeof(uint32_t) * a->data_len);
+}
+
+/*
+  Parallel builds of a mesh big enough to
+  be split into jobs, checked against the
+  serial build of the same mesh.
+*/
+static void bench_meshes_parallel(size_t tris, int *threads, int len)
+{
+  ex_rect_t region;
+  ex_rect_t *boxes = bench_mesh(tris, &region);
+
+  // once to warm up, the first touch of the memory is slow
+  ex_octree_compact_t *serial;
+  bench_mesh_build(region, boxes, tris, 0, &serial);
+  ex_octree_compact_destroy(serial);
+  double serial_time = bench_mesh_build(region, boxes, tris, 0, &serial);
+  printf("{\"triangles\": %zu, \"serial_ms\": %.2f, \"threads\": [", tris, serial_time);
+
+  for (int i=0; i<len; i++) {
+    ex_jobs_init(threads[i]);
+    ex_octree_compact_t *c;
+    double time = bench_mesh_build(region, boxes, tris, 1, &c);
+    ex_jobs_shutdown();
+
+    printf("%s{\"threads\": %i, \"octree_ms\": %.2f, \"speedup\": %.2f, \"matches_serial\": %s}", i ? ", " : "", threads[i], time, serial_time / time, bench_same_tree(serial, c) ? "true" : "false");
+    ex_octree_compact_destroy(c);
+  }
+  printf("]}");
+
+  ex_octree_compact_destroy(serial);
+  free(boxes);
+}
+
+/*
+  A third of the entities walk in a random
+  direction, changing it every second, the
+  rest stand around.  Gravity and friction
+  are the same as in game.c.
+*/
+static void bench_script(ex_entity_t **entities, size_t count, int tick)
+{
+  bench_seed = tick * 7919u;
+
+  for (size_t i=0; i<count; i++) {
+    ex_entity_t *e = entities[i];
+
+    vec3 friction;
+    vec3_scale(friction, e->velocity, 15.0f * BENCH_DT);
+    friction[1] = 0.0f;
+    if (e->grounded)
+      vec3_sub(e->velocity, e->velocity, friction);
+    e->velocity[1] -= 100.0f * BENCH_DT;
+
+    if (i % 3 == 0 && (tick / 60) % 2 == 0) {
+      e->velocity[0] += bench_random(-1.0f, 1.0f) * 100.0f * BENCH_DT;
+      e->velocity[2] += bench_random(-1.0f, 1.0f) * 100.0f * BENCH_DT;
+    }
+  }
+}
+
+static ex_entity_t** bench_spawn(ex_scene_t *s, size_t count)
+{
+  ex_entity_t **entities = malloc(sizeof(ex_entity_t*) * count);
+
+  bench_seed = 1;
+  for (size_t i=0; i<count; i++) {
+    entities[i] = ex_entity_new(s, bench_radius);
+    bench_floor_point(s, entities[i]->position);
+    entities[i]->position[1] += bench_radius[1] * 1.5f;
+  }
+
+  return entities;
+}
+
+static void bench_despawn(ex_entity_t **entities, size_t count)
+{
+  for (size_t i=0; i<count; i++)
+    ex_entity_destroy(entities[i]);
+  free(entities);
+}
+
+static void bench_entities(ex_scene_t *s, size_t count, int ticks)
+{
+  // one by one
+  ex_entity_t **entities = bench_spawn(s, count);
+  uint64_t sleeping = 0;
+  double time = 0.0;
+  for (int t=0; t<ticks; t++) {
+    bench_script(entities, count, t);
+
+    double start = bench_time();
+    for (size_t i=0; i<count; i++)
+      ex_entity_update(entities[i], BENCH_DT);
+    time += bench_time() - start;
+
+    for (size_t i=0; i<count; i++)
+      sleeping += entities[i]->sleeping;
+  }
+
+  ex_entity_stats_t stats = {0, 0, 0};
+  for (size_t i=0; i<count; i++) {
+    stats.sweeps += entities[i]->stats.sweeps;
+    stats.tris   += entities[i]->stats.tris;
+    stats.nodes  += entities[i]->stats.nodes;
+  }
+  bench_despawn(entities, count);
+
+  // across the job threads
+  entities = bench_spawn(s, count);
+  double batch_time = 0.0;
+  for (int t=0; t<ticks; t++) {
+    bench_script(entities, count, t);
+
+    double start = bench_time();
+    ex_entity_update_batch(entities, count, BENCH_DT);
+    batch_time += bench_time() - start;
+  }
+  bench_despawn(entities, count);
+
+  double entity_ticks = (double)count * ticks;
+  double sweeps = stats.sweeps > 0 ? (double)stats.sweeps : 1.0;
+  printf("      \"entities\": {\"count\": %zu, \"ticks\": %i, ", count, ticks);
+  printf("\"ns_per_entity_tick\": %.1f, \"batch_ns_per_entity_tick\": %.1f, ", time * 1e9 / entity_ticks, batch_time * 1e9 / entity_ticks);
+  printf("\"sweeps_per_entity_tick\": %.3f, \"tris_per_sweep\": %.2f, \"nodes_per_sweep\": %.2f, ", stats.sweeps / entity_ticks, stats.tris / sweeps, stats.nodes / sweeps);
+  printf("\"sleeping\": %.3f},\n", sleeping / entity_ticks);
+}
+
+// twice an entities size, around floor points
+static ex_rect_t* bench_query_boxes(ex_scene_t *s)
+{
+  ex_rect_t *boxes = malloc(sizeof(ex_rect_t) * BENCH_QUERIES);
+  bench_seed = 2;
+  for (int i=0; i<BENCH_QUERIES; i++) {
+    vec3 p;
+    bench_floor_point(s, p);
+    p[1] += bench_radius[1];
+    vec3_sub(boxes[i].min, p, bench_radius);
+    vec3_sub(boxes[i].min, boxes[i].min, bench_radius);
+    vec3_add(boxes[i].max, p, bench_radius);
+    vec3_add(boxes[i].max, boxes[i].max, bench_radius);
+  }
+
+  return boxes;
+}
+
+/*
+  The same tree queried through the pointer
+  octree and its compact form, the compact
+  one is made from the pointer one so both
+  have to return the same triangles.
+*/
+static void bench_compact(ex_scene_t *s)
+{
+  ex_octree_t *o = ex_octree_new(OBJ_TYPE_UINT);
+  memcpy(o->region.min, s->coll_vertices[0], sizeof(vec3));
+  memcpy(o->region.max, s->coll_vertices[0], sizeof(vec3));
+  for (size_t i=0; i<s->coll_vertices_last; i+=3) {
+    ex_octree_obj_t *obj = malloc(sizeof(ex_octree_obj_t));
+    obj->data_uint = i;
+    obj->box       = ex_rect_from_triangle(&s->coll_vertices[i]);
+    vec3_min(o->region.min, o->region.min, obj->box.min);
+    vec3_max(o->region.max, o->region.max, obj->box.max);
+    list_add(o->obj_list, (void*)obj);
+  }
+  ex_octree_build(o);
+  ex_octree_compact_t *c = ex_octree_compact(o);
+
+  ex_rect_t *boxes = bench_query_boxes(s);
+  ex_octree_data_t *lists = malloc(sizeof(ex_octree_data_t) * c->nodes_len);
+  uint64_t pointer_tris = 0;
+
+  double start = bench_time();
+  for (int i=0; i<BENCH_QUERIES; i++) {
+    int count = 0;
+    ex_octree_get_colliding(o, &boxes[i], lists, &count);
+    for (int j=0; j<count; j++)
+      pointer_tris += lists[j].len;
+  }
+  double pointer = bench_time() - start;
+
+  ex_query_buffer_t query;
+  ex_query_buffer_init(&query);
+  uint64_t compact_tris = 0;
+
+  start = bench_time();
+  for (int i=0; i<BENCH_QUERIES; i++) {
+    ex_octree_compact_query(c, &boxes[i], &query);
+    compact_tris += query.len;
+  }
+  double compact = bench_time() - start;
+
+  ex_query_buffer_destroy(&query);
+  free(lists);
+  free(boxes);
+  ex_octree_compact_destroy(c);
+  ex_octree_destroy(o);
+
+  printf("  \"compact\": {\"queries\": %i, \"pointer_ns_per_query\": %.1f, \"compact_ns_per_query\": %.1f, ", BENCH_QUERIES, pointer * 1e9 / BENCH_QUERIES, compact * 1e9 / BENCH_QUERIES);
+  printf("\"tris_per_query\": %.2f, \"matches_pointer\": %s},\n", (double)compact_tris / BENCH_QUERIES, pointer_tris == compact_tris ? "true" : "false");
+}
+
+static void bench_queries(ex_scene_t *s)
+{
+  ex_rect_t *boxes = bench_query_boxes(s);
+
+  ex_query_buffer_t query;
+  ex_query_buffer_init(&query);
+  uint64_t tris = 0, nodes = 0;
+
+  double start = bench_time();
+  for (int i=0; i<BENCH_QUERIES; i++) {
+    ex_scene_query_collision(s, &boxes[i], &query);
+    tris  += query.len;
+    nodes += query.nodes;
+  }
+  double time = bench_time() - start;
+
+  ex_query_buffer_destroy(&query);
+  free(boxes);
+
+  printf("      \"queries\": {\"count\": %i, \"ns_per_query\": %.1f, ", BENCH_QUERIES, time * 1e9 / BENCH_QUERIES);
+  printf("\"tris_per_query\": %.2f, \"nodes_per_query\": %.2f},\n", (double)tris / BENCH_QUERIES, (double)nodes / BENCH_QUERIES);
+}
+
+static void bench_rays(ex_scene_t *s)
+{
+  ex_ray_t *rays = malloc(sizeof(ex_ray_t) * BENCH_RAYS);
+  ex_ray_hit_t *hits = malloc(sizeof(ex_ray_hit_t) * BENCH_RAYS);
+  bench_seed = 3;
+  for (int i=0; i<BENCH_RAYS; i++) {
+    bench_floor_point(s, rays[i].from);
+    rays[i].from[1] += bench_radius[1];
+    vec3 dir = {bench_random(-1.0f, 1.0f), bench_random(-0.5f, 0.5f), bench_random(-1.0f, 1.0f)};
+    vec3_norm(dir, dir);
+    vec3_scale(rays[i].to, dir, 100.0f);
+  }
+
+  double start = bench_time();
+  ex_scene_raycast(s, rays, hits, BENCH_RAYS);
+  double time = bench_time() - start;
+
+  int hit = 0;
+  for (int i=0; i<BENCH_RAYS; i++)
+    hit += hits[i].hit;
+
+  free(rays);
+  free(hits);
+
+  printf("      \"rays\": {\"count\": %i, \"rays_per_sec\": %.0f, \"hit_rate\": %.3f}\n", BENCH_RAYS, BENCH_RAYS / time, (double)hit / BENCH_RAYS);
+}
+
+static void bench_broadphase(ex_scene_t *s, size_t count)
+{
+  ex_rect_t bounds;
+  memcpy(bounds.min, s->coll_vertices[0], sizeof(vec3));
+  memcpy(bounds.max, s->coll_vertices[0], sizeof(vec3));
+  for (size_t i=1; i<s->coll_vertices_last; i++) {
+    vec3_min(bounds.min, bounds.min, s->coll_vertices[i]);
+    vec3_max(bounds.max, bounds.max, s->coll_vertices[i]);
+  }
+
+  // spread out over the whole level
+  ex_entity_t **entities = bench_spawn(s, count);
+  for (size_t i=0; i<count; i++)
+    for (int j=0; j<3; j++)
+      entities[i]->position[j] = bench_random(bounds.min[j], bounds.max[j]);
+
+  ex_entity_broadphase_t *b = ex_entity_broadphase_new();
+  for (size_t i=0; i<count; i++)
+    ex_entity_broadphase_add(b, entities[i]);
+  ex_entity_broadphase_update(b);
+
+  // entities wander a little between updates
+  int updates = 100;
+  uint64_t pairs = 0;
+  double time = 0.0;
+  for (int u=0; u<updates; u++) {
+    for (size_t i=0; i<count; i++) {
+      entities[i]->position[0] += bench_random(-0.1f, 0.1f);
+      entities[i]->position[2] += bench_random(-0.1f, 0.1f);
+    }
+
+    double start = bench_time();
+    ex_entity_broadphase_update(b);
+    time += bench_time() - start;
+    pairs += b->pairs_len;
+  }
+
+  ex_entity_broadphase_destroy(b);
+  bench_despawn(entities, count);
+
+  printf("{\"entities\": %zu, \"ns_per_update\": %.0f, \"pairs\": %.1f}", count, time * 1e9 / updates, (double)pairs / updates);
+}
+
+/*
+  A made up character, every bone swings
+  back and forth around its own axis over
+  a looping 60 frame walk.
+*/
+static ex_model_t* bench_skeleton()
+{
+  ex_model_t *m = ex_model_new();
+  m->bones_len  = BENCH_BONES;
+  m->frames_len = BENCH_FRAMES;
+  m->anims_len  = 1;
+
+  m->bones = malloc(sizeof(ex_bone_t) * BENCH_BONES);
+  m->inverse_base = malloc(sizeof(mat4x4) * BENCH_BONES);
+  int parents[BENCH_BONES];
+  vec3 axis[BENCH_BONES];
+  float swing[BENCH_BONES];
+
+  bench_seed = 4;
+  for (int i=0; i<BENCH_BONES; i++) {
+    snprintf(m->bones[i].name, 64, "bone%i", i);
+    m->bones[i].parent = parents[i] = i ? bench_random_index(i) : -1;
+    mat4x4_identity(m->inverse_base[i]);
+
+    vec3 a = {bench_random(-1.0f, 1.0f), bench_random(-1.0f, 1.0f), bench_random(-1.0f, 1.0f)};
+    vec3_norm(axis[i], a);
+    swing[i] = bench_random(0.1f, 0.6f);
+  }
+
+  m->frames = malloc(sizeof(ex_frame_t) * BENCH_FRAMES);
+  for (int f=0; f<BENCH_FRAMES; f++) {
+    m->frames[f] = malloc(sizeof(ex_pose_t) * BENCH_BONES);
+    for (int i=0; i<BENCH_BONES; i++) {
+      ex_pose_t *p = &m->frames[f][i];
+      float angle = swing[i] * sinf(2.0f * M_PI * f / BENCH_FRAMES) * 0.5f;
+      vec3_scale(p->rotate, axis[i], sinf(angle));
+      p->rotate[3] = cosf(angle);
+      p->translate[0] = p->translate[2] = 0.0f;
+      p->translate[1] = i ? 0.2f : 1.0f;
+      p->scale[0] = p->scale[1] = p->scale[2] = 1.0f;
+    }
+  }
+
+  m->anims = malloc(sizeof(ex_anim_t));
+  m->anims[0] = (ex_anim_t){"walk", 0, BENCH_FRAMES, 30.0f, 1};
+  m->pose     = malloc(sizeof(ex_pose_t) * BENCH_BONES);
+  m->skeleton = malloc(sizeof(mat4x4) * BENCH_BONES);
+  m->animation = ex_animation_new(parents, BENCH_BONES, m->frames, BENCH_FRAMES, m->inverse_base);
+
+  return m;
+}
+
+static double bench_animate(ex_model_t **characters, size_t count)
+{
+  double start = bench_time();
+  for (int t=0; t<BENCH_ANIM_TICKS; t++)
+    for (size_t i=0; i<count; i++)
+      ex_model_update(characters[i], BENCH_DT);
+
+  double bones = (double)count * BENCH_BONES * BENCH_ANIM_TICKS;
+  return bones / (bench_time() - start);
+}
+
+/*
+  In step every character lands on the same
+  frame, so the pose cache builds it once.
+  Spread out they hardly ever share one, and
+  scalar is the per bone path models without
+  sampled tracks take.
+*/
+static void bench_animation(ex_model_t *skeleton, size_t count)
+{
+  ex_model_t **characters = malloc(sizeof(ex_model_t*) * count);
+  for (size_t i=0; i<count; i++) {
+    characters[i] = ex_model_new();
+    ex_model_copy_animation(characters[i], skeleton);
+    ex_model_set_anim(characters[i], "walk");
+  }
+
+  ex_animation_t *a = skeleton->animation;
+  a->hits = a->misses = 0;
+  double synced = bench_animate(characters, count);
+  double synced_hits = (double)a->hits / (a->hits + a->misses);
+
+  bench_seed = 5;
+  for (size_t i=0; i<count; i++)
+    characters[i]->current_time = bench_random(0.0f, BENCH_FRAMES / 30.0f);
+  a->hits = a->misses = 0;
+  double spread = bench_animate(characters, count);
+  double spread_hits = (double)a->hits / (a->hits + a->misses);
+
+  for (size_t i=0; i<count; i++)
+    characters[i]->animation = NULL;
+  double scalar = bench_animate(characters, count);
+
+  for (size_t i=0; i<count; i++) {
+    characters[i]->animation = a;
+    ex_model_destroy(characters[i]);
+  }
+  free(characters);
+
+  printf("{\"characters\": %zu, \"bones\": %i, ", count, BENCH_BONES);
+  printf("\"synced_bones_per_sec\": %.0f, \"synced_cache_hits\": %.3f, ", synced, synced_hits);
+  printf("\"spread_bones_per_sec\": %.0f, \"spread_cache_hits\": %.3f, ", spread, spread_hits);
+  printf("\"scalar_bones_per_sec\": %.0f}", scalar);
+}
+
+static ex_model_t** bench_crowd(ex_model_t *skeleton, size_t count)
+{
+  ex_model_t **characters = malloc(sizeof(ex_model_t*) * count);
+  bench_seed = 6;
+  for (size_t i=0; i<count; i++) {
+    characters[i] = ex_model_new();
+    ex_model_copy_animation(characters[i], skeleton);
+    ex_model_set_anim(characters[i], "walk");
+    characters[i]->current_time = bench_random(0.0f, BENCH_FRAMES / 30.0f);
+  }
+
+  return characters;
+}
+
+static void bench_disband(ex_model_t **characters, size_t count)
+{
+  for (size_t i=0; i<count; i++)
+    ex_model_destroy(characters[i]);
+  free(characters);
+}
+
+/*
+  A spread out crowd through the job threads,
+  checked bit for bit against updating the
+  same crowd one by one.
+*/
+static void bench_animation_threads(ex_model_t *skeleton, size_t count, int threads)
+{
+  ex_model_t **serial = bench_crowd(skeleton, count);
+  for (int t=0; t<BENCH_ANIM_TICKS; t++)
+    for (size_t i=0; i<count; i++)
+      ex_model_update(serial[i], BENCH_DT);
+
+  ex_model_t **batched = bench_crowd(skeleton, count);
+  ex_model_anim_scratch_t scratch;
+  memset(&scratch, 0, sizeof(ex_model_anim_scratch_t));
+  double start = bench_time();
+  for (int t=0; t<BENCH_ANIM_TICKS; t++)
+    ex_model_update_batch(&scratch, batched, count, BENCH_DT);
+  double time = bench_time() - start;
+  ex_model_anim_scratch_destroy(&scratch);
+
+  int same = 1;
+  for (size_t i=0; i<count; i++)
+    same &= memcmp(serial[i]->skeleton, batched[i]->skeleton, sizeof(mat4x4) * BENCH_BONES) == 0;
+
+  bench_disband(serial, count);
+  bench_disband(batched, count);
+
+  double bones = (double)count * BENCH_BONES * BENCH_ANIM_TICKS;
+  printf("{\"threads\": %i, \"characters\": %zu, \"bones_per_sec\": %.0f, \"matches_serial\": %s}", threads, count, bones / time, same ? "true" : "false");
+}
+
+static void bench_snapshot(ex_scene_t *s)
+{
+  size_t count = 1000;
+  ex_entity_t **entities = bench_spawn(s, count);
+  ex_entity_state_t *states = malloc(sizeof(ex_entity_state_t) * count);
+
+  double start = bench_time();
+  for (int i=0; i<BENCH_SNAPSHOTS; i++)
+    ex_entity_snapshot(entities, count, states);
+  double snapshot = bench_time() - start;
+
+  start = bench_time();
+  for (int i=0; i<BENCH_SNAPSHOTS; i++)
+    ex_entity_restore(entities, count, states);
+  double restore = bench_time() - start;
+
+  free(states);
+  bench_despawn(entities, count);
+
+  printf("  \"snapshot\": {\"entities\": %zu, \"bytes\": %zu, \"snapshot_ns\": %.0f, \"restore_ns\": %.0f}\n", count, sizeof(ex_entity_state_t) * count, snapshot * 1e9 / BENCH_SNAPSHOTS, restore * 1e9 / BENCH_SNAPSHOTS);
+}
+
+static float bench_fuzz_snap(float v)
+{
+  // on the grid a third of the time, for exact
+  // ties and axis aligned planes and edges
+  return bench_random_index(3) == 0 ? roundf(v) : v;
+}
+
+static void bench_fuzz_packet(ex_coll_packet_t *p, vec3 position, vec3 velocity, vec3 radius)
+{
+  memset(p, 0, sizeof(ex_coll_packet_t));
+  memcpy(p->e_radius, radius, sizeof(vec3));
+  vec3_div(p->e_base_point, position, radius);
+  vec3_div(p->e_velocity, velocity, radius);
+  vec3_norm(p->e_norm_velocity, p->e_velocity);
+  p->nearest_distance = FLT_MAX;
+}
+
+static int bench_fuzz_same(ex_coll_packet_t *a, ex_coll_packet_t *b)
+{
+  if (a->found_collision != b->found_collision ||
+      memcmp(&a->nearest_distance, &b->nearest_distance, sizeof(float)) ||
+      memcmp(&a->t, &b->t, sizeof(double)))
+    return 0;
+
+  if (!a->found_collision)
+    return 1;
+
+  return !memcmp(a->intersect_point, b->intersect_point, sizeof(vec3)) &&
+         !memcmp(&a->plane, &b->plane, sizeof(ex_plane_t)) &&
+         !memcmp(a->a, b->a, sizeof(vec3)) &&
+         !memcmp(a->b, b->b, sizeof(vec3)) &&
+         !memcmp(a->c, b->c, sizeof(vec3));
+}
+
+/*
+  Random ellipsoids swept against random
+  triangle sets, mixing in grid snapped,
+  axis aligned and degenerate triangles.
+  The batched sweep has to pick exactly the
+  same hit as the scalar one, bit for bit.
+*/
+static int bench_fuzz(long iterations)
+{
+  bench_seed = 7;
+  long hits = 0, mismatches = 0;
+  vec3 *vertices = malloc(sizeof(vec3) * 3 * 37);
+  uint32_t indices[37];
+
+  for (long it=0; it<iterations; it++) {
+    vec3 radius, position, velocity;
+    for (int i=0; i<3; i++) {
+      radius[i]   = bench_fuzz_snap(bench_random(0.3f, 3.0f));
+      position[i] = bench_fuzz_snap(bench_random(-5.0f, 5.0f));
+      velocity[i] = bench_fuzz_snap(bench_random(-4.0f, 4.0f));
+    }
+    if (bench_random_index(2))
+      radius[1] = radius[2] = radius[0];
+
+    // zero velocity components
+    uint32_t axis = bench_random_index(6);
+    if (axis < 3)
+      velocity[axis] = 0.0f;
+    if (bench_random_index(8) == 0)
+      velocity[0] = velocity[2] = 0.0f;
+
+    // out of order, the batch has to gather
+    size_t count = 1 + bench_random_index(37);
+    for (size_t i=0; i<count; i++) {
+      indices[i] = (count - 1 - i) * 3;
+
+      vec3 center;
+      for (int j=0; j<3; j++)
+        center[j] = bench_fuzz_snap(bench_random(-7.0f, 7.0f));
+      float size = bench_random(0.1f, 8.0f);
+
+      vec3 *v = &vertices[i*3];
+      for (int k=0; k<3; k++)
+        for (int j=0; j<3; j++)
+          v[k][j] = bench_fuzz_snap(center[j] + bench_random(-size, size));
+
+      uint32_t shape = bench_random_index(10);
+      if (shape == 0) {
+        uint32_t flat = bench_random_index(3);
+        for (int k=0; k<3; k++)
+          v[k][flat] = center[flat];
+      } else if (shape == 1) {
+        memcpy(v[2], v[1], sizeof(vec3));
+      } else if (shape == 2 && i > 0) {
+        memcpy(v[0], v[-2], sizeof(vec3));
+      }
+    }
+
+    ex_coll_packet_t scalar, batched;
+    bench_fuzz_packet(&scalar, position, velocity, radius);
+    bench_fuzz_packet(&batched, position, velocity, radius);
+
+    // an earlier hit to beat
+    if (bench_random_index(4) == 0) {
+      scalar.found_collision  = batched.found_collision  = 1;
+      scalar.nearest_distance = batched.nearest_distance = bench_random(0.0f, 3.0f);
+    }
+
+    for (size_t i=0; i<count; i++) {
+      vec3 *v = &vertices[indices[i]];
+      vec3 a, b, c;
+      vec3_div(a, v[0], radius);
+      vec3_div(b, v[1], radius);
+      vec3_div(c, v[2], radius);
+      ex_collision_check_triangle(&scalar, a, b, c);
+    }
+    ex_collision_check_triangles(&batched, vertices, indices, count, NULL);
+
+    hits += scalar.found_collision;
+    if (!bench_fuzz_same(&scalar, &batched)) {
+      if (mismatches < 8)
+        fprintf(stderr, "mismatch at %li, t %.9g/%.9g\n", it, scalar.t, batched.t);
+      mismatches++;
+    }
+  }
+
+  free(vertices);
+
+  printf("{\"fuzz\": {\"iterations\": %li, \"hits\": %li, \"mismatches\": %li}}\n", iterations, hits, mismatches);
+  return mismatches == 0;
+}
+
+/*
+  Random points in view against every light,
+  each light reaching a point has to be listed
+  in the points froxel, in the order added.
+*/
+static int bench_cluster_check(ex_cluster_t *c, size_t lights, size_t samples)
+{
+  mat4x4 projection, view;
+  mat4x4_perspective(projection, rad(70.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+  mat4x4_look_at(view, (vec3){5.0f, 3.0f, 5.0f}, (vec3){60.0f, 0.0f, -80.0f}, (vec3){0.0f, 1.0f, 0.0f});
+
+  vec3 color = {1.0f, 1.0f, 1.0f};
+  ex_cluster_begin(c, view, projection);
+  for (size_t i=0; i<lights; i++) {
+    vec3 position = {bench_random(-400.0f, 400.0f), bench_random(-5.0f, 20.0f), bench_random(-400.0f, 400.0f)};
+    ex_cluster_add_light(c, position, color, bench_random(2.0f, 20.0f));
+  }
+  ex_cluster_build(c);
+
+  size_t needed = 0, missing = 0, unordered = 0;
+  for (size_t s=0; s<samples; s++) {
+    // a random pixel at a log spaced depth
+    float x = bench_random(-1.0f, 1.0f), y = bench_random(-1.0f, 1.0f);
+    float depth = expf(bench_random(logf(0.2f), logf(900.0f)));
+    vec3 p = {x * depth / projection[0][0], y * depth / projection[1][1], -depth};
+
+    uint32_t *cell = c->cells[ex_cluster_cell(c, p)];
+    uint32_t *listed = &c->indices[cell[0]];
+    for (uint32_t j=1; j<cell[1]; j++)
+      unordered += listed[j] <= listed[j-1];
+
+    for (size_t i=0; i<c->lights_len; i++) {
+      float *l = c->lights[i].position_radius;
+      vec3 d = {l[0] - p[0], l[1] - p[1], l[2] - p[2]};
+      if (vec3_mul_inner(d, d) > l[3] * l[3])
+        continue;
+
+      needed++;
+      uint32_t j = 0;
+      while (j < cell[1] && listed[j] != i)
+        j++;
+      missing += j == cell[1];
+    }
+  }
+
+  printf("{\"lights\": %zu, \"samples\": %zu, \"pairs\": %zu, \"needed\": %zu, \"missing\": %zu, \"unordered\": %zu}",
+    lights, samples, c->indices_len, needed, missing, unordered);
+  return missing == 0 && unordered == 0;
+}
+
+static int bench_cluster()
+{
+  bench_seed = 7;
+  ex_cluster_t *c = ex_cluster_new();
+
+  int ok = 1;
+  size_t lights[] = {100, 1000, 10000};
+  printf("{\"cluster\": [");
+  for (int i=0; i<3; i++) {
+    printf(i ? ", " : "");
+    ok &= bench_cluster_check(c, lights[i], 20000);
+  }
+  printf("]}\n");
+
+  ex_cluster_destroy(c);
+  return ok;
+}
+
+/*
+  Random frustums against random boxes and
+  spheres, some on the grid so they touch the
+  planes exactly.  Counts run from 0 to 37 so
+  every partial simd tail gets hit.  Batched
+  culling has to keep exactly the same list.
+*/
+static int bench_frustum(long iterations)
+{
+  bench_seed = 7;
+  long visible = 0, mismatches = 0;
+  float *center[3], *half[3], *radius;
+  for (int i=0; i<3; i++) {
+    center[i] = malloc(sizeof(float) * 37);
+    half[i]   = malloc(sizeof(float) * 37);
+  }
+  radius = malloc(sizeof(float) * 37);
+  uint32_t batched[37], scalar[37];
+
+  for (long it=0; it<iterations; it++) {
+    vec3 eye, target, up = {0.0f, 1.0f, 0.0f};
+    for (int i=0; i<3; i++) {
+      eye[i]    = bench_fuzz_snap(bench_random(-10.0f, 10.0f));
+      target[i] = bench_fuzz_snap(bench_random(-10.0f, 10.0f));
+    }
+    // looking down an axis, for axis aligned planes
+    if (bench_random_index(4) == 0) {
+      memcpy(target, eye, sizeof(vec3));
+      target[bench_random_index(2) * 2] += 1.0f;
+    }
+    if (vec3_len((vec3){target[0] - eye[0], 0.0f, target[2] - eye[2]}) <= 0.0f)
+      target[0] += 1.0f;
+
+    mat4x4 view, projection, view_projection;
+    mat4x4_look_at(view, eye, target, up);
+    mat4x4_perspective(projection, rad(bench_random(30.0f, 110.0f)), bench_random(0.5f, 2.5f), bench_random(0.05f, 1.0f), bench_random(20.0f, 200.0f));
+    mat4x4_mul(view_projection, projection, view);
+
+    ex_frustum_t f;
+    ex_frustum_from_matrix(&f, view_projection);
+
+    size_t count = bench_random_index(38);
+    for (size_t i=0; i<count; i++) {
+      for (int j=0; j<3; j++) {
+        center[j][i] = bench_fuzz_snap(bench_random(-60.0f, 60.0f));
+        half[j][i]   = bench_random_index(8) ? bench_fuzz_snap(bench_random(0.0f, 10.0f)) : 0.0f;
+      }
+      radius[i] = bench_random_index(8) ? bench_fuzz_snap(bench_random(0.0f, 10.0f)) : 0.0f;
+    }
+
+    size_t len = ex_frustum_cull_aabbs(&f, center, half, count, batched), expect = 0;
+    for (size_t i=0; i<count; i++) {
+      vec3 c = {center[0][i], center[1][i], center[2][i]};
+      vec3 h = {half[0][i], half[1][i], half[2][i]};
+      if (ex_frustum_aabb(&f, c, h))
+        scalar[expect++] = i;
+    }
+    int same = len == expect && memcmp(batched, scalar, sizeof(uint32_t) * len) == 0;
+    visible += len;
+
+    len = ex_frustum_cull_spheres(&f, center, radius, count, batched), expect = 0;
+    for (size_t i=0; i<count; i++) {
+      vec3 c = {center[0][i], center[1][i], center[2][i]};
+      if (ex_frustum_sphere(&f, c, radius[i]))
+        scalar[expect++] = i;
+    }
+    same &= len == expect && memcmp(batched, scalar, sizeof(uint32_t) * len) == 0;
+    visible += len;
+
+    if (!same) {
+      if (mismatches < 8)
+        fprintf(stderr, "mismatch at %li, %zu shapes\n", it, count);
+      mismatches++;
+    }
+  }
+
+  for (int i=0; i<3; i++) {
+    free(center[i]);
+    free(half[i]);
+  }
+  free(radius);
+
+  printf("{\"frustum\": {\"iterations\": %li, \"visible\": %li, \"mismatches\": %li}}\n", iterations, visible, mismatches);
+  return mismatches == 0;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc > 1 && strcmp(argv[1], "fuzz") == 0) {
+    long iterations = argc > 2 ? atol(argv[2]) : 100000;
+    return bench_fuzz(iterations) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  if (argc > 1 && strcmp(argv[1], "cluster") == 0)
+    return bench_cluster() ? EXIT_SUCCESS : EXIT_FAILURE;
+
+  if (argc > 1 && strcmp(argv[1], "frustum") == 0) {
+    long iterations = argc > 2 ? atol(argv[2]) : 100000;
+    return bench_frustum(iterations) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  const char *level = argc > 1 ? argv[1] : "data/level.iqm";
+  size_t count = argc > 2 ? strtoul(argv[2], NULL, 10) : 1000;
+  int ticks    = argc > 3 ? atoi(argv[3]) : 600;
+
+  // the packed data file if its there, loose files otherwise
+  PHYSFS_init(argv[0]);
+  PHYSFS_mount(EX_DATA_FILE, NULL, 1);
+  PHYSFS_mount(".", NULL, 1);
+
+  ex_scene_t *s = ex_scene_new(EX_SCENE_HEADLESS);
+  size_t len = ex_iqm_load_collision(s, level);
+  if (len == 0) {
+    PHYSFS_deinit();
+    return EXIT_FAILURE;
+  }
+
+  printf("{\n  \"level\": \"%s\", \"triangles\": %zu,\n", level, len / 3);
+
+  // tree builds against thread count
+  printf("  \"build\": [");
+  int threads[] = {1, 2, 4, 8};
+  for (int i=0; i<4; i++) {
+    ex_jobs_init(threads[i]);
+    s->bvh = 0;
+    double octree = bench_build(s);
+    s->bvh = 1;
+    double bvh = bench_build(s);
+    ex_jobs_shutdown();
+
+    printf("%s{\"threads\": %i, \"octree_ms\": %.2f, \"bvh_ms\": %.2f}", i ? ", " : "", threads[i], octree, bvh);
+  }
+  printf("],\n");
+
+  // made up meshes, the level files are tiny
+  printf("  \"meshes\": [");
+  bench_meshes();
+  printf("],\n");
+
+  // and split across the job threads
+  printf("  \"meshes_parallel\": ");
+  bench_meshes_parallel(1000000, threads, 4);
+  printf(",\n");
+
+  bench_compact(s);
+
+  // animation against thread count
+  ex_model_t *skeleton = bench_skeleton();
+  printf("  \"animation_threads\": [");
+  for (int i=0; i<4; i++) {
+    ex_jobs_init(threads[i]);
+    printf("%s", i ? ", " : "");
+    bench_animation_threads(skeleton, 1000, threads[i]);
+    ex_jobs_shutdown();
+  }
+  printf("],\n");
+
+  // the rest runs on one worker per core
+  ex_jobs_init(0);
+  printf("  \"threads\": %i,\n", ex_jobs_threads());
+
+  printf("  \"trees\": {\n");
+  for (int bvh=0; bvh<2; bvh++) {
+    s->bvh = bvh;
+    ex_scene_build_collision(s);
+
+    printf("    \"%s\": {\n", bvh ? "bvh" : "octree");
+    bench_entities(s, count, ticks);
+    bench_queries(s);
+    bench_rays(s);
+    printf("    }%s\n", bvh ? "" : ",");
+  }
+  printf("  },\n");
+
+  printf("  \"broadphase\": [");
+  bench_broadphase(s, 1000);
+  printf(", ");
+  bench_broadphase(s, 10000);
+  printf("],\n");
+
+  printf("  \"animation\": [");
+  bench_animation(skeleton, 100);
+  printf(", ");
+  bench_animation(skeleton, 1000);
+  ex_model_destroy(skeleton);
+  printf("],\n");
+
+  bench_snapshot(s);
+  printf("}\n");
+
+  // exiting frees the scene, destroying it
+  // would print after the json
+  ex_jobs_shutdown();
+  PHYSFS_deinit();
+
+  return EXIT_SUCCESS;
+}
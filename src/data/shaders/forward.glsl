@@ -106,7 +106,6 @@ uniform bool      u_dir_active;
 /* ------------ */
 
 /* point light */
-const int MAX_PL = 64;
 struct point_light {
   vec3 position;
   vec3 color;
@@ -116,12 +115,21 @@ struct point_light {
 // for dynamic lights
 uniform point_light u_point_light;
 uniform samplerCube u_point_depth;
-// for static ones done in a single render pass
-uniform point_light u_point_lights[MAX_PL];
-uniform int         u_point_count;
+// dynamic casters, when split from the static ones
+uniform samplerCube u_point_depth_dynamic;
+uniform bool        u_point_split;
 uniform bool        u_point_active;
 /* ------------ */
 
+/* clustered lights, the ones without shadows */
+uniform bool           u_cluster_active;
+uniform samplerBuffer  u_cluster_lights;
+uniform usamplerBuffer u_cluster_cells;
+uniform usamplerBuffer u_cluster_indices;
+uniform ivec3          u_cluster_size;
+uniform vec2           u_cluster_slice;
+/* ------------ */
+
 vec3 pcf_offset[20] = vec3[]
 (
   vec3( 1,  1,  1), vec3( 1, -1,  1), vec3(-1, -1,  1), vec3(-1,  1,  1), 
@@ -131,11 +139,9 @@ vec3 pcf_offset[20] = vec3[]
   vec3( 0,  1,  1), vec3( 0, -1,  1), vec3( 0, -1, -1), vec3( 0,  1, -1)
 );
 
-vec3 calc_point_light(point_light light)
+// light position already in view space
+vec3 calc_point_light_view(point_light l)
 {
-  point_light l = light;
-  l.position = vec3(u_view * vec4(l.position, 1.0));
-
   vec3 fragpos = frag;
   vec3 normals = texture(u_norm, uv).rgb;
   normals = normalize(normals * 2.0 - 1.0);
@@ -179,6 +185,8 @@ vec3 calc_point_light(point_light light)
     float closest_depth = 0.0f;
     for (int i=0; i<samples; ++i) {
       closest_depth  = texture(u_point_depth, frag_to_light + pcf_offset[i] * radius).r;
+      if (u_point_split)
+        closest_depth = min(closest_depth, texture(u_point_depth_dynamic, frag_to_light + pcf_offset[i] * radius).r);
       closest_depth *= l.far;
       if (current_depth - bias > closest_depth)
         shadow += 1.0;
@@ -189,6 +197,43 @@ vec3 calc_point_light(point_light light)
   return vec3((1.0 - shadow) * (diffuse + specular));
 }
 
+vec3 calc_point_light(point_light light)
+{
+  point_light l = light;
+  l.position = vec3(u_view * vec4(l.position, 1.0));
+  return calc_point_light_view(l);
+}
+
+// every non shadow casting light in this froxel
+vec3 calc_cluster_lights(vec3 fragpos)
+{
+  // nothing was drawn here
+  if (fragpos.z >= 0.0)
+    return vec3(0.0);
+
+  vec4 clip = u_projection * vec4(fragpos, 1.0);
+  vec2 tile = (clip.xy / clip.w) * 0.5 + 0.5;
+  ivec3 c;
+  c.xy = clamp(ivec2(floor(tile * vec2(u_cluster_size.xy))), ivec2(0), u_cluster_size.xy - 1);
+  c.z  = clamp(int(floor(log(max(-fragpos.z, 1e-4)) * u_cluster_slice.x + u_cluster_slice.y)), 0, u_cluster_size.z - 1);
+
+  uvec2 range = texelFetch(u_cluster_cells, (c.z * u_cluster_size.y + c.y) * u_cluster_size.x + c.x).rg;
+
+  vec3 result = vec3(0.0);
+  for (uint i=0u; i<range.y; i++) {
+    int index = int(texelFetch(u_cluster_indices, int(range.x + i)).r);
+
+    point_light l;
+    l.position  = texelFetch(u_cluster_lights, index*2).xyz;
+    l.color     = texelFetch(u_cluster_lights, index*2+1).rgb;
+    l.is_shadow = false;
+    l.far       = 0.0;
+    result += calc_point_light_view(l);
+  }
+
+  return result;
+}
+
 void main()
 {
   vec3 diffuse = vec3(0.0f);
@@ -197,14 +242,13 @@ void main()
     diffuse += texture(u_texture, uv).rgb * 0.125;
   } else {
     // shadow casters
-    if (u_point_active && u_point_count <= 0)
+    if (u_point_active && !u_cluster_active)
       diffuse += calc_point_light(u_point_light);
   }
     
   // non shadow casters
-  if (u_point_count > 0)
-    for (int i=0; i<u_point_count; i++)
-      diffuse += calc_point_light(u_point_lights[i]);
+  if (u_cluster_active)
+    diffuse += calc_cluster_lights(frag);
 
   color = vec4(diffuse, 1.0);
 }
@@ -61,12 +61,16 @@ layout (triangles) in;
 layout (triangle_strip, max_vertices=18) out;
 
 uniform mat4 u_shadow_matrices[6];
+uniform int u_face_mask;
 
 out vec4 frag;
 
 void main()
 {
   for (int face=0; face<6; ++face) {
+    if ((u_face_mask & (1 << face)) == 0)
+      continue;
+
     gl_Layer = face;
     for (int i=0; i<3; ++i) {
       frag = gl_in[i].gl_Position;
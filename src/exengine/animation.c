@@ -0,0 +1,311 @@
+#include "animation.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define EX_ANIM_WIDTH 8
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define EX_ANIM_WIDTH 4
+#else
+#define EX_ANIM_WIDTH 1
+#endif
+
+// tracks are padded to this, same layout on every build
+#define EX_ANIM_PAD 8
+
+#if EX_ANIM_WIDTH == 8
+typedef __m256 ex_vf_t;
+
+static inline ex_vf_t ex_vf_set1(float f)              { return _mm256_set1_ps(f); }
+static inline ex_vf_t ex_vf_load(const float *p)       { return _mm256_loadu_ps(p); }
+static inline void    ex_vf_store(float *p, ex_vf_t a) { _mm256_storeu_ps(p, a); }
+static inline ex_vf_t ex_vf_add(ex_vf_t a, ex_vf_t b)  { return _mm256_add_ps(a, b); }
+static inline ex_vf_t ex_vf_sub(ex_vf_t a, ex_vf_t b)  { return _mm256_sub_ps(a, b); }
+static inline ex_vf_t ex_vf_mul(ex_vf_t a, ex_vf_t b)  { return _mm256_mul_ps(a, b); }
+static inline ex_vf_t ex_vf_and(ex_vf_t a, ex_vf_t b)  { return _mm256_and_ps(a, b); }
+static inline ex_vf_t ex_vf_xor(ex_vf_t a, ex_vf_t b)  { return _mm256_xor_ps(a, b); }
+static inline ex_vf_t ex_vf_lt(ex_vf_t a, ex_vf_t b)   { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+static inline int     ex_vf_mask(ex_vf_t m)            { return _mm256_movemask_ps(m); }
+static inline ex_vf_t ex_vf_rsqrt(ex_vf_t a)           { return _mm256_rsqrt_ps(a); }
+#elif EX_ANIM_WIDTH == 4
+typedef __m128 ex_vf_t;
+
+static inline ex_vf_t ex_vf_set1(float f)              { return _mm_set1_ps(f); }
+static inline ex_vf_t ex_vf_load(const float *p)       { return _mm_loadu_ps(p); }
+static inline void    ex_vf_store(float *p, ex_vf_t a) { _mm_storeu_ps(p, a); }
+static inline ex_vf_t ex_vf_add(ex_vf_t a, ex_vf_t b)  { return _mm_add_ps(a, b); }
+static inline ex_vf_t ex_vf_sub(ex_vf_t a, ex_vf_t b)  { return _mm_sub_ps(a, b); }
+static inline ex_vf_t ex_vf_mul(ex_vf_t a, ex_vf_t b)  { return _mm_mul_ps(a, b); }
+static inline ex_vf_t ex_vf_and(ex_vf_t a, ex_vf_t b)  { return _mm_and_ps(a, b); }
+static inline ex_vf_t ex_vf_xor(ex_vf_t a, ex_vf_t b)  { return _mm_xor_ps(a, b); }
+static inline ex_vf_t ex_vf_lt(ex_vf_t a, ex_vf_t b)   { return _mm_cmplt_ps(a, b); }
+static inline int     ex_vf_mask(ex_vf_t m)            { return _mm_movemask_ps(m); }
+static inline ex_vf_t ex_vf_rsqrt(ex_vf_t a)           { return _mm_rsqrt_ps(a); }
+#else
+typedef union { float f; uint32_t u; } ex_vf_t;
+
+static inline ex_vf_t ex_vf_set1(float f)              { ex_vf_t r; r.f = f; return r; }
+static inline ex_vf_t ex_vf_load(const float *p)       { return ex_vf_set1(*p); }
+static inline void    ex_vf_store(float *p, ex_vf_t a) { *p = a.f; }
+static inline ex_vf_t ex_vf_add(ex_vf_t a, ex_vf_t b)  { return ex_vf_set1(a.f + b.f); }
+static inline ex_vf_t ex_vf_sub(ex_vf_t a, ex_vf_t b)  { return ex_vf_set1(a.f - b.f); }
+static inline ex_vf_t ex_vf_mul(ex_vf_t a, ex_vf_t b)  { return ex_vf_set1(a.f * b.f); }
+static inline ex_vf_t ex_vf_and(ex_vf_t a, ex_vf_t b)  { ex_vf_t r; r.u = a.u & b.u; return r; }
+static inline ex_vf_t ex_vf_xor(ex_vf_t a, ex_vf_t b)  { ex_vf_t r; r.u = a.u ^ b.u; return r; }
+static inline ex_vf_t ex_vf_lt(ex_vf_t a, ex_vf_t b)   { ex_vf_t r; r.u = a.f < b.f ? 0xFFFFFFFFu : 0; return r; }
+static inline int     ex_vf_mask(ex_vf_t m)            { return m.u != 0; }
+static inline ex_vf_t ex_vf_rsqrt(ex_vf_t a)           { return ex_vf_set1(1.0f / sqrtf(a.f)); }
+#endif
+
+// mat4x4_mul_affine a row at a time, b's rows pick from a's
+static inline void ex_animation_mul(mat4x4 out, mat4x4 a, mat4x4 b)
+{
+#if EX_ANIM_WIDTH > 1
+  __m128 a0 = _mm_loadu_ps(a[0]), a1 = _mm_loadu_ps(a[1]);
+  __m128 a2 = _mm_loadu_ps(a[2]), a3 = _mm_loadu_ps(a[3]);
+  __m128 rows[3];
+  for (int c=0; c<3; c++) {
+    rows[c] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(b[c][0]), a0), _mm_mul_ps(_mm_set1_ps(b[c][1]), a1)),
+                         _mm_add_ps(_mm_mul_ps(_mm_set1_ps(b[c][2]), a2), _mm_mul_ps(_mm_set1_ps(b[c][3]), a3)));
+  }
+  for (int c=0; c<3; c++)
+    _mm_storeu_ps(out[c], rows[c]);
+  _mm_storeu_ps(out[3], a3);
+#else
+  mat4x4_mul_affine(out, a, b);
+#endif
+}
+
+ex_animation_t* ex_animation_new(const int *parents, size_t bones_len, ex_frame_t *frames, size_t frames_len, mat4x4 *inverse_base)
+{
+  ex_animation_t *a = malloc(sizeof(ex_animation_t));
+  a->bones_len  = bones_len;
+  a->frames_len = frames_len;
+  a->stride     = (bones_len + EX_ANIM_PAD - 1) / EX_ANIM_PAD * EX_ANIM_PAD;
+
+  size_t frame_size = EX_ANIM_CHANNELS * a->stride;
+  a->tracks = malloc(sizeof(float) * frame_size * frames_len);
+  for (size_t f=0; f<frames_len; f++) {
+    float *t = &a->tracks[f * frame_size];
+    for (size_t b=0; b<a->stride; b++) {
+      // padding is the identity, keeps its lanes finite
+      ex_pose_t p = {{0.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 1.0f}, {0.0f, 0.0f, 0.0f, 1.0f}};
+      if (b < bones_len) {
+        p = frames[f][b];
+        quat_norm(p.rotate, p.rotate);
+      }
+
+      for (int c=0; c<3; c++) {
+        t[(0 + c) * a->stride + b] = p.translate[c];
+        t[(7 + c) * a->stride + b] = p.scale[c];
+      }
+      for (int c=0; c<4; c++)
+        t[(3 + c) * a->stride + b] = p.rotate[c];
+    }
+  }
+
+  a->parents = malloc(sizeof(int) * bones_len);
+  memcpy(a->parents, parents, sizeof(int) * bones_len);
+  a->inverse_base = malloc(sizeof(mat4x4) * bones_len);
+  memcpy(a->inverse_base, inverse_base, sizeof(mat4x4) * bones_len);
+
+  for (int i=0; i<EX_POSE_CACHE_SIZE; i++) {
+    a->cache[i].valid    = 0;
+    a->cache[i].skeleton = NULL;
+    a->cache[i].world    = NULL;
+  }
+  a->cache_next = 0;
+  a->hits   = 0;
+  a->misses = 0;
+  a->users  = 1;
+
+  return a;
+}
+
+void ex_animation_blend(ex_animation_t *a, uint32_t frame_a, uint32_t frame_b, float weight, float *pose)
+{
+  size_t stride = a->stride;
+  const float *ta = &a->tracks[frame_a * EX_ANIM_CHANNELS * stride];
+  const float *tb = &a->tracks[frame_b * EX_ANIM_CHANNELS * stride];
+
+  weight = MIN(MAX(weight, 0.0f), 1.0f);
+  ex_vf_t wa = ex_vf_set1(1.0f - weight);
+  ex_vf_t wb = ex_vf_set1(weight);
+  ex_vf_t sign_bit = ex_vf_set1(-0.0f);
+
+  for (size_t i=0; i<stride; i+=EX_ANIM_WIDTH) {
+    // translate and scale
+    static const int lerped[6] = {0, 1, 2, 7, 8, 9};
+    for (int j=0; j<6; j++) {
+      size_t o = lerped[j] * stride + i;
+      ex_vf_store(&pose[o], ex_vf_add(ex_vf_mul(ex_vf_load(&ta[o]), wa), ex_vf_mul(ex_vf_load(&tb[o]), wb)));
+    }
+
+    // rotation, b flipped onto a's side
+    ex_vf_t qa[4], qb[4];
+    ex_vf_t dot = ex_vf_set1(0.0f);
+    for (int c=0; c<4; c++) {
+      qa[c] = ex_vf_load(&ta[(3 + c) * stride + i]);
+      qb[c] = ex_vf_load(&tb[(3 + c) * stride + i]);
+      dot = ex_vf_add(dot, ex_vf_mul(qa[c], qb[c]));
+    }
+    ex_vf_t flip = ex_vf_and(dot, sign_bit);
+
+    ex_vf_t q[4];
+    ex_vf_t len2 = ex_vf_set1(0.0f);
+    for (int c=0; c<4; c++) {
+      q[c] = ex_vf_add(ex_vf_mul(qa[c], wa), ex_vf_mul(ex_vf_xor(qb[c], flip), wb));
+      len2 = ex_vf_add(len2, ex_vf_mul(q[c], q[c]));
+    }
+
+    // estimate plus one newton step
+    ex_vf_t inv = ex_vf_rsqrt(len2);
+    inv = ex_vf_mul(inv, ex_vf_sub(ex_vf_set1(1.5f), ex_vf_mul(ex_vf_mul(ex_vf_set1(0.5f), len2), ex_vf_mul(inv, inv))));
+    for (int c=0; c<4; c++)
+      ex_vf_store(&pose[(3 + c) * stride + i], ex_vf_mul(q[c], inv));
+
+    // bones turning too far for nlerp
+    int far = ex_vf_mask(ex_vf_lt(ex_vf_xor(dot, flip), ex_vf_set1(EX_ANIM_NLERP_DOT)));
+    for (int j=0; far && j<EX_ANIM_WIDTH; j++, far >>= 1) {
+      if (!(far & 1) || i + j >= a->bones_len)
+        continue;
+
+      quat ra, rb, r;
+      for (int c=0; c<4; c++) {
+        ra[c] = ta[(3 + c) * stride + i + j];
+        rb[c] = tb[(3 + c) * stride + i + j];
+      }
+      quat_slerp(r, ra, rb, weight);
+      quat_norm(r, r);
+      for (int c=0; c<4; c++)
+        pose[(3 + c) * stride + i + j] = r[c];
+    }
+  }
+}
+
+void ex_animation_build(ex_animation_t *a, const float *pose, mat4x4 *skeleton, mat4x4 *world)
+{
+  size_t stride = a->stride;
+  float local[12 * stride];
+
+  // rows of translate * rotate * scale, straight from the pose
+  for (size_t i=0; i<stride; i+=EX_ANIM_WIDTH) {
+    ex_vf_t t[3], s[3];
+    for (int c=0; c<3; c++) {
+      t[c] = ex_vf_load(&pose[(0 + c) * stride + i]);
+      s[c] = ex_vf_load(&pose[(7 + c) * stride + i]);
+    }
+    ex_vf_t x = ex_vf_load(&pose[3 * stride + i]);
+    ex_vf_t y = ex_vf_load(&pose[4 * stride + i]);
+    ex_vf_t z = ex_vf_load(&pose[5 * stride + i]);
+    ex_vf_t w = ex_vf_load(&pose[6 * stride + i]);
+
+    ex_vf_t two = ex_vf_set1(2.0f), one = ex_vf_set1(1.0f);
+    ex_vf_t x2 = ex_vf_mul(x, two), y2 = ex_vf_mul(y, two), z2 = ex_vf_mul(z, two);
+    ex_vf_t xx = ex_vf_mul(x, x2), yy = ex_vf_mul(y, y2), zz = ex_vf_mul(z, z2);
+    ex_vf_t xy = ex_vf_mul(x, y2), xz = ex_vf_mul(x, z2), yz = ex_vf_mul(y, z2);
+    ex_vf_t wx = ex_vf_mul(w, x2), wy = ex_vf_mul(w, y2), wz = ex_vf_mul(w, z2);
+
+    ex_vf_t rows[12] = {
+      ex_vf_mul(ex_vf_sub(one, ex_vf_add(yy, zz)), s[0]),
+      ex_vf_mul(ex_vf_sub(xy, wz), s[1]),
+      ex_vf_mul(ex_vf_add(xz, wy), s[2]),
+      t[0],
+
+      ex_vf_mul(ex_vf_add(xy, wz), s[0]),
+      ex_vf_mul(ex_vf_sub(one, ex_vf_add(xx, zz)), s[1]),
+      ex_vf_mul(ex_vf_sub(yz, wx), s[2]),
+      t[1],
+
+      ex_vf_mul(ex_vf_sub(xz, wy), s[0]),
+      ex_vf_mul(ex_vf_add(yz, wx), s[1]),
+      ex_vf_mul(ex_vf_sub(one, ex_vf_add(xx, yy)), s[2]),
+      t[2]
+    };
+    for (int j=0; j<12; j++)
+      ex_vf_store(&local[j * stride + i], rows[j]);
+  }
+
+  // parents come first, so theirs are done
+  for (size_t i=0; i<a->bones_len; i++) {
+    mat4x4 m;
+    for (int j=0; j<12; j++)
+      m[j / 4][j % 4] = local[j * stride + i];
+    m[3][0] = m[3][1] = m[3][2] = 0.0f;
+    m[3][3] = 1.0f;
+
+    int parent = a->parents[i];
+    if (parent >= 0)
+      ex_animation_mul(world[i], m, world[parent]);
+    else
+      mat4x4_dup(world[i], m);
+
+    ex_animation_mul(skeleton[i], a->inverse_base[i], world[i]);
+  }
+}
+
+ex_pose_key_t ex_animation_key(ex_animation_t *a, uint32_t frame_a, uint32_t frame_b, float weight)
+{
+  weight = MIN(MAX(weight, 0.0f), 1.0f);
+
+  ex_pose_key_t key;
+  key.frame_a = MIN(frame_a, a->frames_len - 1);
+  key.frame_b = MIN(frame_b, a->frames_len - 1);
+  key.step    = (uint32_t)(weight * EX_ANIM_WEIGHT_STEPS + 0.5f);
+  return key;
+}
+
+void ex_animation_evaluate(ex_animation_t *a, ex_pose_key_t key, mat4x4 *skeleton, mat4x4 *world)
+{
+  float pose[EX_ANIM_CHANNELS * a->stride];
+  ex_animation_blend(a, key.frame_a, key.frame_b, (float)key.step / EX_ANIM_WEIGHT_STEPS, pose);
+  ex_animation_build(a, pose, skeleton, world);
+}
+
+const ex_pose_cache_entry_t* ex_animation_sample(ex_animation_t *a, ex_pose_key_t key)
+{
+  for (int i=0; i<EX_POSE_CACHE_SIZE; i++) {
+    ex_pose_cache_entry_t *e = &a->cache[i];
+    if (e->valid && e->key.frame_a == key.frame_a && e->key.frame_b == key.frame_b && e->key.step == key.step) {
+      a->hits++;
+      return e;
+    }
+  }
+
+  // oldest entry goes
+  ex_pose_cache_entry_t *e = &a->cache[a->cache_next];
+  a->cache_next = (a->cache_next + 1) % EX_POSE_CACHE_SIZE;
+  a->misses++;
+
+  if (e->skeleton == NULL) {
+    e->skeleton = malloc(sizeof(mat4x4) * a->bones_len);
+    e->world    = malloc(sizeof(mat4x4) * a->bones_len);
+  }
+
+  ex_animation_evaluate(a, key, e->skeleton, e->world);
+  e->key   = key;
+  e->valid = 1;
+
+  return e;
+}
+
+int ex_animation_release(ex_animation_t *a)
+{
+  if (--a->users > 0)
+    return 0;
+
+  for (int i=0; i<EX_POSE_CACHE_SIZE; i++) {
+    free(a->cache[i].skeleton);
+    free(a->cache[i].world);
+  }
+
+  free(a->tracks);
+  free(a->parents);
+  free(a->inverse_base);
+  free(a);
+
+  return 1;
+}
@@ -0,0 +1,148 @@
+/* animation
+  The read only half of a skinned model,
+  every frame of every bone kept as SoA
+  tracks, one array per channel, so two
+  frames blend a simd register of bones
+  at a time.
+
+  Rotations are nlerped, slerp is only
+  used for bones that turn far between
+  two frames.  Bone matrices are built
+  straight from the blended pose, then
+  chained as affine matrices.
+
+  Copies of a model share one of these,
+  and the last few sampled poses are
+  cached in it so instances playing the
+  same frame only build it once.
+*/
+
+#ifndef EX_ANIMATION_H
+#define EX_ANIMATION_H
+
+#include <stddef.h>
+#include <inttypes.h>
+#include "mathlib.h"
+
+// translate xyz, rotate xyzw, scale xyz
+#define EX_ANIM_CHANNELS 10
+
+// cos of half the widest turn nlerp is used for,
+// 30 degrees between frames is off by 0.035
+#define EX_ANIM_NLERP_DOT 0.96f
+
+// blend weights are snapped to this many steps,
+// so nearby instances land on the same pose
+#define EX_ANIM_WEIGHT_STEPS 64
+
+#define EX_POSE_CACHE_SIZE 16
+
+typedef struct {
+  vec3 translate, scale;
+  quat rotate;
+} ex_pose_t;
+
+typedef ex_pose_t* ex_frame_t;
+
+// frames clamped, weight in steps
+typedef struct {
+  uint32_t frame_a, frame_b, step;
+} ex_pose_key_t;
+
+typedef struct {
+  ex_pose_key_t key;
+  uint8_t valid;
+  mat4x4 *skeleton, *world;
+} ex_pose_cache_entry_t;
+
+typedef struct {
+  // channel c of frame f is at
+  // tracks[(f * EX_ANIM_CHANNELS + c) * stride]
+  float *tracks;
+  size_t bones_len, frames_len, stride;
+
+  int *parents;
+  mat4x4 *inverse_base;
+
+  ex_pose_cache_entry_t cache[EX_POSE_CACHE_SIZE];
+  size_t cache_next;
+  uint64_t hits, misses;
+
+  // models sharing this
+  uint32_t users;
+} ex_animation_t;
+
+/**
+ * [ex_animation_new convert frames into tracks]
+ * @param  parents      [parent per bone, -1 for roots, parents first]
+ * @param  bones_len    [how many bones]
+ * @param  frames       [frame data]
+ * @param  frames_len   [how many frames]
+ * @param  inverse_base [inverse bind matrix per bone, copied]
+ * @return              [the animation, with one user]
+ */
+ex_animation_t* ex_animation_new(const int *parents, size_t bones_len, ex_frame_t *frames, size_t frames_len, mat4x4 *inverse_base);
+
+/**
+ * [ex_animation_blend mix two frames]
+ * @param a       [the animation]
+ * @param frame_a [first frame]
+ * @param frame_b [second frame]
+ * @param weight  [0 is frame_a, 1 is frame_b]
+ * @param pose    [EX_ANIM_CHANNELS arrays of a->stride floats]
+ *
+ * This and ex_animation_build only read the
+ * animation, so they are safe from any thread.
+ */
+void ex_animation_blend(ex_animation_t *a, uint32_t frame_a, uint32_t frame_b, float weight, float *pose);
+
+/**
+ * [ex_animation_build turn a blended pose into bone matrices]
+ * @param a        [the animation]
+ * @param pose     [from ex_animation_blend]
+ * @param skeleton [skinning matrix per bone]
+ * @param world    [model space matrix per bone]
+ */
+void ex_animation_build(ex_animation_t *a, const float *pose, mat4x4 *skeleton, mat4x4 *world);
+
+/**
+ * [ex_animation_key the pose to sample between two frames]
+ * @param  a       [the animation]
+ * @param  frame_a [first frame]
+ * @param  frame_b [second frame]
+ * @param  weight  [0 is frame_a, 1 is frame_b]
+ * @return         [equal for instances that can share a pose]
+ */
+ex_pose_key_t ex_animation_key(ex_animation_t *a, uint32_t frame_a, uint32_t frame_b, float weight);
+
+/**
+ * [ex_animation_evaluate blend and build the pose for a key]
+ * @param a        [the animation]
+ * @param key      [from ex_animation_key]
+ * @param skeleton [skinning matrix per bone]
+ * @param world    [model space matrix per bone]
+ *
+ * Skips the cache, safe from any thread.
+ */
+void ex_animation_evaluate(ex_animation_t *a, ex_pose_key_t key, mat4x4 *skeleton, mat4x4 *world);
+
+/**
+ * [ex_animation_sample evaluate through the pose cache]
+ * @param  a   [the animation]
+ * @param  key [from ex_animation_key]
+ * @return     [the cached pose]
+ *
+ * The entry is only good until the next
+ * sample, copy what you need out of it.
+ * Not thread safe.
+ */
+const ex_pose_cache_entry_t* ex_animation_sample(ex_animation_t *a, ex_pose_key_t key);
+
+/**
+ * [ex_animation_release drop a user]
+ * @param  a [the animation]
+ * @return   [1 when this was the last user and it was freed]
+ */
+int ex_animation_release(ex_animation_t *a);
+
+#endif // EX_ANIMATION_H
@@ -0,0 +1,307 @@
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include "bvh.h"
+
+typedef struct {
+  ex_rect_t *boxes;
+  vec3 *centers;
+  uint32_t *prims;
+  ex_bvh_node_t *nodes;
+  size_t nodes_len, nodes_size;
+} ex_bvh_builder_t;
+
+typedef struct {
+  ex_rect_t bounds;
+  size_t count;
+} ex_bvh_bin_t;
+
+static inline void ex_bvh_rect_empty(ex_rect_t *r)
+{
+  for (int i=0; i<3; i++) {
+    r->min[i] =  FLT_MAX;
+    r->max[i] = -FLT_MAX;
+  }
+}
+
+static inline void ex_bvh_rect_grow(ex_rect_t *r, ex_rect_t *b)
+{
+  vec3_min(r->min, r->min, b->min);
+  vec3_max(r->max, r->max, b->max);
+}
+
+static inline float ex_bvh_rect_area(ex_rect_t *r)
+{
+  vec3 d;
+  vec3_sub(d, r->max, r->min);
+  return 2.0f * (d[0]*d[1] + d[1]*d[2] + d[2]*d[0]);
+}
+
+static uint32_t ex_bvh_split(ex_bvh_builder_t *b, size_t first, size_t len, int depth)
+{
+  if (b->nodes_len >= b->nodes_size) {
+    b->nodes_size *= 2;
+    b->nodes = realloc(b->nodes, sizeof(ex_bvh_node_t) * b->nodes_size);
+  }
+  uint32_t index = b->nodes_len++;
+
+  ex_rect_t bounds, centers;
+  ex_bvh_rect_empty(&bounds);
+  ex_bvh_rect_empty(&centers);
+  for (size_t i=first; i<first+len; i++) {
+    uint32_t p = b->prims[i];
+    ex_bvh_rect_grow(&bounds, &b->boxes[p]);
+    vec3_min(centers.min, centers.min, b->centers[p]);
+    vec3_max(centers.max, centers.max, b->centers[p]);
+  }
+
+  b->nodes[index].bounds = bounds;
+  b->nodes[index].offset = first;
+  b->nodes[index].count  = len;
+
+  if (len <= EX_BVH_LEAF_SIZE || depth >= EX_BVH_MAX_DEPTH)
+    return index;
+
+  // bin along the widest centroid axis
+  vec3 extent;
+  vec3_sub(extent, centers.max, centers.min);
+  int axis = 0;
+  if (extent[1] > extent[axis]) axis = 1;
+  if (extent[2] > extent[axis]) axis = 2;
+  if (extent[axis] <= 0.0f)
+    return index;
+
+  ex_bvh_bin_t bins[EX_BVH_BINS];
+  for (int i=0; i<EX_BVH_BINS; i++) {
+    ex_bvh_rect_empty(&bins[i].bounds);
+    bins[i].count = 0;
+  }
+
+  float scale = EX_BVH_BINS / extent[axis];
+  for (size_t i=first; i<first+len; i++) {
+    uint32_t p = b->prims[i];
+    int bin = (int)((b->centers[p][axis] - centers.min[axis]) * scale);
+    bin = MIN(bin, EX_BVH_BINS-1);
+    ex_bvh_rect_grow(&bins[bin].bounds, &b->boxes[p]);
+    bins[bin].count++;
+  }
+
+  // sweep from the right, then find the cheapest
+  // split sweeping from the left
+  float right_area[EX_BVH_BINS];
+  size_t right_count[EX_BVH_BINS];
+  ex_rect_t r;
+  ex_bvh_rect_empty(&r);
+  size_t count = 0;
+  for (int i=EX_BVH_BINS-1; i>0; i--) {
+    ex_bvh_rect_grow(&r, &bins[i].bounds);
+    count += bins[i].count;
+    right_area[i]  = count ? ex_bvh_rect_area(&r) : 0.0f;
+    right_count[i] = count;
+  }
+
+  float best_cost = FLT_MAX;
+  int best_split  = -1;
+  ex_rect_t l;
+  ex_bvh_rect_empty(&l);
+  count = 0;
+  for (int i=1; i<EX_BVH_BINS; i++) {
+    ex_bvh_rect_grow(&l, &bins[i-1].bounds);
+    count += bins[i-1].count;
+    if (count == 0 || right_count[i] == 0)
+      continue;
+
+    float cost = ex_bvh_rect_area(&l) * count + right_area[i] * right_count[i];
+    if (cost < best_cost) {
+      best_cost  = cost;
+      best_split = i;
+    }
+  }
+
+  // traversing a node costs about as much as
+  // testing one object, keep the leaf if cheaper
+  float area = ex_bvh_rect_area(&bounds);
+  float leaf_cost = (float)len;
+  if (best_split < 0 || (area > 0.0f && 1.0f + best_cost / area >= leaf_cost && len <= EX_BVH_MAX_LEAF_SIZE))
+    return index;
+
+  // partition prims in place around the split
+  size_t i = first, j = first + len;
+  while (i < j) {
+    uint32_t p = b->prims[i];
+    int bin = MIN((int)((b->centers[p][axis] - centers.min[axis]) * scale), EX_BVH_BINS-1);
+    if (bin < best_split) {
+      i++;
+    } else {
+      b->prims[i]   = b->prims[--j];
+      b->prims[j]   = p;
+    }
+  }
+
+  size_t left_len = i - first;
+  ex_bvh_split(b, first, left_len, depth+1);
+  uint32_t right = ex_bvh_split(b, i, len - left_len, depth+1);
+
+  b->nodes[index].offset = right;
+  b->nodes[index].count  = 0;
+  return index;
+}
+
+ex_bvh_t* ex_bvh_build(ex_rect_t *boxes, uint32_t *data, size_t len)
+{
+  if (boxes == NULL || data == NULL || len == 0)
+    return NULL;
+
+  ex_bvh_builder_t b;
+  b.boxes      = boxes;
+  b.centers    = malloc(sizeof(vec3) * len);
+  b.prims      = malloc(sizeof(uint32_t) * len);
+  b.nodes_size = 64;
+  b.nodes_len  = 0;
+  b.nodes      = malloc(sizeof(ex_bvh_node_t) * b.nodes_size);
+
+  for (size_t i=0; i<len; i++) {
+    vec3_add(b.centers[i], boxes[i].min, boxes[i].max);
+    vec3_scale(b.centers[i], b.centers[i], 0.5f);
+    b.prims[i] = i;
+  }
+
+  ex_bvh_split(&b, 0, len, 0);
+
+  // leaves reference data in prim order
+  ex_bvh_t *bvh  = malloc(sizeof(ex_bvh_t));
+  bvh->nodes     = realloc(b.nodes, sizeof(ex_bvh_node_t) * b.nodes_len);
+  bvh->nodes_len = b.nodes_len;
+  bvh->data      = b.prims;
+  bvh->data_len  = len;
+  for (size_t i=0; i<len; i++)
+    bvh->data[i] = data[bvh->data[i]];
+
+  free(b.centers);
+
+  return bvh;
+}
+
+void ex_bvh_query(ex_bvh_t *b, ex_rect_t *bounds, ex_query_buffer_t *out)
+{
+  out->len   = 0;
+  out->nodes = 0;
+
+  if (b == NULL || b->nodes_len == 0)
+    return;
+
+  uint32_t stack[EX_BVH_MAX_DEPTH + 2];
+  int top = 0;
+  stack[top++] = 0;
+
+  while (top > 0) {
+    uint32_t index = stack[--top];
+    ex_bvh_node_t *node = &b->nodes[index];
+    out->nodes++;
+
+    if (!ex_aabb_aabb(node->bounds, *bounds))
+      continue;
+
+    if (node->count > 0) {
+      ex_query_buffer_reserve(out, node->count);
+      memcpy(&out->data[out->len], &b->data[node->offset], sizeof(uint32_t) * node->count);
+      out->len += node->count;
+      continue;
+    }
+
+    // left child is next in memory, visit it first
+    stack[top++] = node->offset;
+    stack[top++] = index + 1;
+  }
+}
+
+void ex_bvh_visit(ex_bvh_t *b, ex_rect_t *bounds, ex_visit_func_t func, void *data)
+{
+  if (b == NULL || b->nodes_len == 0)
+    return;
+
+  uint32_t stack[EX_BVH_MAX_DEPTH + 2];
+  int top = 0;
+  stack[top++] = 0;
+
+  while (top > 0) {
+    uint32_t index = stack[--top];
+    ex_bvh_node_t *node = &b->nodes[index];
+    if (!ex_aabb_aabb(node->bounds, *bounds))
+      continue;
+
+    if (node->count > 0) {
+      if (!func(data, &b->data[node->offset], node->count))
+        return;
+      continue;
+    }
+
+    stack[top++] = node->offset;
+    stack[top++] = index + 1;
+  }
+}
+
+void ex_bvh_raycast(ex_bvh_t *b, vec3 from, vec3 dir, float max, ex_ray_func_t func, void *data)
+{
+  if (b == NULL || b->nodes_len == 0)
+    return;
+
+  vec3 inv_dir;
+  for (int i=0; i<3; i++)
+    inv_dir[i] = 1.0f / dir[i];
+
+  float near;
+  if (!ex_ray_aabb(&b->nodes[0].bounds, from, inv_dir, max, &near))
+    return;
+
+  struct {
+    uint32_t index;
+    float near;
+  } stack[EX_BVH_MAX_DEPTH + 2];
+  int top = 0;
+  stack[top].index  = 0;
+  stack[top++].near = near;
+
+  while (top > 0) {
+    top--;
+    // something closer was hit since this was pushed
+    if (stack[top].near > max)
+      continue;
+
+    uint32_t index = stack[top].index;
+    ex_bvh_node_t *node = &b->nodes[index];
+    if (node->count > 0) {
+      max = func(data, &b->data[node->offset], node->count, max);
+      continue;
+    }
+
+    // push the farther child first
+    uint32_t left = index + 1, right = node->offset;
+    float near_left, near_right;
+    int hit_left  = ex_ray_aabb(&b->nodes[left].bounds, from, inv_dir, max, &near_left);
+    int hit_right = ex_ray_aabb(&b->nodes[right].bounds, from, inv_dir, max, &near_right);
+    if (hit_left && hit_right && near_left < near_right) {
+      stack[top].index    = right;
+      stack[top++].near   = near_right;
+      hit_right = 0;
+    }
+    if (hit_left) {
+      stack[top].index  = left;
+      stack[top++].near = near_left;
+    }
+    if (hit_right) {
+      stack[top].index  = right;
+      stack[top++].near = near_right;
+    }
+  }
+}
+
+void ex_bvh_destroy(ex_bvh_t *b)
+{
+  if (b == NULL)
+    return;
+
+  free(b->nodes);
+  free(b->data);
+  free(b);
+}
@@ -0,0 +1,84 @@
+/* bvh
+  A bounding volume hierarchy for static
+  collision geometry, an alternative to
+  the octree.
+
+  Unlike the octree, objects are never
+  stuck in upper nodes because they
+  straddle a split, every object lives in
+  a small leaf with a tight box.
+
+  Built top down with a binned surface
+  area heuristic, nodes are stored in
+  depth first order, so a nodes left
+  child always directly follows it.
+*/
+
+#ifndef EX_BVH_H
+#define EX_BVH_H
+
+#include <inttypes.h>
+#include "octree.h"
+
+#define EX_BVH_BINS 16
+#define EX_BVH_LEAF_SIZE 4
+#define EX_BVH_MAX_LEAF_SIZE 64
+#define EX_BVH_MAX_DEPTH 64
+
+typedef struct {
+  ex_rect_t bounds;
+  uint32_t offset; // leaf: first data, node: right child
+  uint32_t count;  // 0 for nodes
+} ex_bvh_node_t;
+
+typedef struct {
+  ex_bvh_node_t *nodes;
+  size_t nodes_len;
+  uint32_t *data;
+  size_t data_len;
+} ex_bvh_t;
+
+/**
+ * [ex_bvh_build build a bvh from object bounds]
+ * @param  boxes [the object bounds]
+ * @param  data  [the object data, returned by queries]
+ * @param  len   [the object count]
+ * @return       [the bvh, NULL if there are no objects]
+ */
+ex_bvh_t* ex_bvh_build(ex_rect_t *boxes, uint32_t *data, size_t len);
+
+/**
+ * [ex_bvh_query gather the data of all leaves overlapping bounds]
+ * @param b      [the bvh]
+ * @param bounds [the bounds to test]
+ * @param out    [reset, then filled with object data]
+ */
+void ex_bvh_query(ex_bvh_t *b, ex_rect_t *bounds, ex_query_buffer_t *out);
+
+/**
+ * [ex_bvh_visit ex_bvh_query without the buffer]
+ * @param b      [the bvh]
+ * @param bounds [the bounds to test]
+ * @param func   [called with each overlapping leafs data]
+ * @param data   [user pointer passed to func]
+ */
+void ex_bvh_visit(ex_bvh_t *b, ex_rect_t *bounds, ex_visit_func_t func, void *data);
+
+/**
+ * [ex_bvh_raycast visit leaves along a ray front to back]
+ * @param b    [the bvh]
+ * @param from [the ray origin]
+ * @param dir  [the ray direction, distances are in its length]
+ * @param max  [how far along the ray to look]
+ * @param func [called with each leafs data]
+ * @param data [user pointer passed to func]
+ */
+void ex_bvh_raycast(ex_bvh_t *b, vec3 from, vec3 dir, float max, ex_ray_func_t func, void *data);
+
+/**
+ * [ex_bvh_destroy cleanup bvh data]
+ * @param b [the bvh to destroy]
+ */
+void ex_bvh_destroy(ex_bvh_t *b);
+
+#endif // EX_BVH_H
@@ -0,0 +1,277 @@
+#include "cluster.h"
+#include "shader.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+ex_cluster_t* ex_cluster_new()
+{
+  ex_cluster_t *c = calloc(1, sizeof(ex_cluster_t));
+  return c;
+}
+
+static inline int ex_cluster_clamp(int v, int max)
+{
+  return v < 0 ? 0 : (v >= max ? max-1 : v);
+}
+
+static inline int ex_cluster_slice(ex_cluster_t *c, float depth)
+{
+  return ex_cluster_clamp((int)floorf(logf(depth) * c->slice_scale + c->slice_bias), EX_CLUSTER_Z);
+}
+
+static inline int ex_cluster_tile(float ndc, int tiles)
+{
+  return ex_cluster_clamp((int)floorf((ndc * 0.5f + 0.5f) * (float)tiles), tiles);
+}
+
+static void ex_cluster_setup(ex_cluster_t *c)
+{
+  mat4x4 *p = &c->projection;
+
+  // depth range of a gl perspective matrix
+  c->near = (*p)[3][2] / ((*p)[2][2] - 1.0f);
+  c->far  = (*p)[3][2] / ((*p)[2][2] + 1.0f);
+
+  float range = logf(c->far / c->near);
+  c->slice_scale = (float)EX_CLUSTER_Z / range;
+  c->slice_bias  = -(float)EX_CLUSTER_Z * logf(c->near) / range;
+
+  for (int z=0; z<=EX_CLUSTER_Z; z++)
+    c->slices[z] = c->near * powf(c->far / c->near, (float)z / EX_CLUSTER_Z);
+
+  // view space box around every froxel
+  for (int z=0; z<EX_CLUSTER_Z; z++) {
+    float dn = c->slices[z], df = c->slices[z+1];
+
+    for (int y=0; y<EX_CLUSTER_Y; y++) {
+      float y0 = -1.0f + 2.0f * y / EX_CLUSTER_Y;
+      float y1 = -1.0f + 2.0f * (y+1) / EX_CLUSTER_Y;
+
+      for (int x=0; x<EX_CLUSTER_X; x++) {
+        float x0 = -1.0f + 2.0f * x / EX_CLUSTER_X;
+        float x1 = -1.0f + 2.0f * (x+1) / EX_CLUSTER_X;
+
+        ex_rect_t *r = &c->bounds[(z * EX_CLUSTER_Y + y) * EX_CLUSTER_X + x];
+        r->min[0] = fminf(x0 * dn, x0 * df) / (*p)[0][0];
+        r->max[0] = fmaxf(x1 * dn, x1 * df) / (*p)[0][0];
+        r->min[1] = fminf(y0 * dn, y0 * df) / (*p)[1][1];
+        r->max[1] = fmaxf(y1 * dn, y1 * df) / (*p)[1][1];
+        r->min[2] = -df;
+        r->max[2] = -dn;
+      }
+    }
+  }
+}
+
+void ex_cluster_begin(ex_cluster_t *c, mat4x4 view, mat4x4 projection)
+{
+  memcpy(c->view, view, sizeof(mat4x4));
+
+  if (memcmp(c->projection, projection, sizeof(mat4x4))) {
+    memcpy(c->projection, projection, sizeof(mat4x4));
+    ex_cluster_setup(c);
+  }
+
+  c->lights_len = 0;
+}
+
+void ex_cluster_add_light(ex_cluster_t *c, vec3 position, vec3 color, float radius)
+{
+  if (c->lights_len >= c->lights_cap) {
+    c->lights_cap = c->lights_cap ? c->lights_cap * 2 : 64;
+    c->lights     = realloc(c->lights, sizeof(ex_cluster_light_t) * c->lights_cap);
+  }
+
+  ex_cluster_light_t *l = &c->lights[c->lights_len++];
+  vec4 world = {position[0], position[1], position[2], 1.0f};
+  mat4x4_mul_vec4(l->position_radius, c->view, world);
+  l->position_radius[3] = radius;
+  memcpy(l->color, color, sizeof(vec3));
+  l->color[3] = 0.0f;
+}
+
+// ndc rect of the box around a sphere, cut to a depth range
+static void ex_cluster_project(ex_cluster_t *c, vec3 center, float radius, float n, float f, vec4 rect)
+{
+  for (int i=0; i<2; i++) {
+    float scale = c->projection[i][i];
+    float lo = center[i] - radius, hi = center[i] + radius;
+    rect[i]   = fmaxf(-1.0f, scale * fminf(lo / n, lo / f));
+    rect[i+2] = fminf( 1.0f, scale * fmaxf(hi / n, hi / f));
+  }
+}
+
+int ex_cluster_rect(ex_cluster_t *c, vec3 center, float radius, vec4 rect)
+{
+  float depth = -center[2];
+  if (depth + radius < c->near || depth - radius > c->far)
+    return 0;
+
+  // crosses the near plane, could be anywhere
+  if (depth - radius <= c->near) {
+    rect[0] = rect[1] = -1.0f;
+    rect[2] = rect[3] =  1.0f;
+    return 1;
+  }
+
+  ex_cluster_project(c, center, radius, depth - radius, depth + radius, rect);
+  return rect[0] <= rect[2] && rect[1] <= rect[3];
+}
+
+static void ex_cluster_pair(ex_cluster_t *c, uint32_t cell, uint32_t light)
+{
+  if (c->pairs_len >= c->pairs_cap) {
+    c->pairs_cap = c->pairs_cap ? c->pairs_cap * 2 : 1024;
+    c->pairs     = realloc(c->pairs, sizeof(*c->pairs) * c->pairs_cap);
+  }
+
+  c->pairs[c->pairs_len][0] = cell;
+  c->pairs[c->pairs_len][1] = light;
+  c->pairs_len++;
+}
+
+void ex_cluster_build(ex_cluster_t *c)
+{
+  c->pairs_len = 0;
+
+  for (size_t i=0; i<c->lights_len; i++) {
+    float *center = c->lights[i].position_radius;
+    float radius  = center[3];
+
+    float depth = -center[2];
+    if (depth + radius < c->near || depth - radius > c->far)
+      continue;
+
+    int z0 = ex_cluster_slice(c, fmaxf(depth - radius, c->near));
+    int z1 = ex_cluster_slice(c, fminf(depth + radius, c->far));
+
+    float r2 = radius * radius;
+    for (int z=z0; z<=z1; z++) {
+      // the part of the sphere inside this slice, much
+      // tighter than one rect for the whole light
+      float n = fmaxf(depth - radius, c->slices[z]);
+      float f = fminf(depth + radius, c->slices[z+1]);
+
+      vec4 rect;
+      ex_cluster_project(c, center, radius, n, fmaxf(f, n), rect);
+      if (rect[0] > rect[2] || rect[1] > rect[3])
+        continue;
+
+      int x0 = ex_cluster_tile(rect[0], EX_CLUSTER_X), x1 = ex_cluster_tile(rect[2], EX_CLUSTER_X);
+      int y0 = ex_cluster_tile(rect[1], EX_CLUSTER_Y), y1 = ex_cluster_tile(rect[3], EX_CLUSTER_Y);
+
+      // the sphere against each froxel box in range
+      for (int y=y0; y<=y1; y++) {
+        for (int x=x0; x<=x1; x++) {
+          uint32_t cell = (z * EX_CLUSTER_Y + y) * EX_CLUSTER_X + x;
+          ex_rect_t *r = &c->bounds[cell];
+
+          float d2 = 0.0f;
+          for (int j=0; j<3; j++) {
+            float d = fmaxf(r->min[j] - center[j], center[j] - r->max[j]);
+            if (d > 0.0f)
+              d2 += d*d;
+          }
+
+          if (d2 <= r2)
+            ex_cluster_pair(c, cell, i);
+        }
+      }
+    }
+  }
+
+  // counting sort by froxel, keeps the light order
+  for (int i=0; i<EX_CLUSTER_CELLS; i++)
+    c->cells[i][1] = 0;
+  for (size_t i=0; i<c->pairs_len; i++)
+    c->cells[c->pairs[i][0]][1]++;
+
+  uint32_t offset = 0;
+  for (int i=0; i<EX_CLUSTER_CELLS; i++) {
+    c->cells[i][0] = offset;
+    offset += c->cells[i][1];
+    c->cells[i][1] = 0;
+  }
+
+  if (c->pairs_len > c->indices_cap) {
+    c->indices_cap = c->pairs_len;
+    c->indices     = realloc(c->indices, sizeof(uint32_t) * c->indices_cap);
+  }
+
+  for (size_t i=0; i<c->pairs_len; i++) {
+    uint32_t *cell = c->cells[c->pairs[i][0]];
+    c->indices[cell[0] + cell[1]++] = c->pairs[i][1];
+  }
+  c->indices_len = c->pairs_len;
+}
+
+uint32_t ex_cluster_cell(ex_cluster_t *c, vec3 position)
+{
+  vec4 clip, view = {position[0], position[1], position[2], 1.0f};
+  mat4x4_mul_vec4(clip, c->projection, view);
+
+  int x = ex_cluster_tile(clip[0] / clip[3], EX_CLUSTER_X);
+  int y = ex_cluster_tile(clip[1] / clip[3], EX_CLUSTER_Y);
+  int z = ex_cluster_slice(c, fmaxf(-position[2], 1e-4f));
+
+  return (z * EX_CLUSTER_Y + y) * EX_CLUSTER_X + x;
+}
+
+void ex_cluster_upload(ex_cluster_t *c)
+{
+  static const GLenum formats[3] = {GL_RGBA32F, GL_RG32UI, GL_R32UI};
+
+  if (!c->buffers[0]) {
+    glGenBuffers(3, c->buffers);
+    glGenTextures(3, c->textures);
+  }
+
+  const void *data[3] = {c->lights, c->cells, c->indices};
+  size_t size[3] = {
+    c->lights_len * sizeof(ex_cluster_light_t),
+    sizeof(c->cells),
+    c->indices_len * sizeof(uint32_t)
+  };
+
+  for (int i=0; i<3; i++) {
+    // orphan last frames storage, never empty
+    glBindBuffer(GL_TEXTURE_BUFFER, c->buffers[i]);
+    glBufferData(GL_TEXTURE_BUFFER, size[i] ? size[i] : sizeof(ex_cluster_light_t), NULL, GL_STREAM_DRAW);
+    if (size[i])
+      glBufferSubData(GL_TEXTURE_BUFFER, 0, size[i], data[i]);
+
+    glBindTexture(GL_TEXTURE_BUFFER, c->textures[i]);
+    glTexBuffer(GL_TEXTURE_BUFFER, formats[i], c->buffers[i]);
+  }
+
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+  glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+void ex_cluster_bind(ex_cluster_t *c, GLuint shader)
+{
+  static const char *names[3] = {"u_cluster_lights", "u_cluster_cells", "u_cluster_indices"};
+
+  for (int i=0; i<3; i++) {
+    glActiveTexture(GL_TEXTURE0 + EX_CLUSTER_UNIT + i);
+    glBindTexture(GL_TEXTURE_BUFFER, c->textures[i]);
+    glUniform1i(ex_uniform(shader, names[i]), EX_CLUSTER_UNIT + i);
+  }
+
+  glUniform3i(ex_uniform(shader, "u_cluster_size"), EX_CLUSTER_X, EX_CLUSTER_Y, EX_CLUSTER_Z);
+  glUniform2f(ex_uniform(shader, "u_cluster_slice"), c->slice_scale, c->slice_bias);
+}
+
+void ex_cluster_destroy(ex_cluster_t *c)
+{
+  if (c->buffers[0]) {
+    glDeleteTextures(3, c->textures);
+    glDeleteBuffers(3, c->buffers);
+  }
+
+  free(c->lights);
+  free(c->indices);
+  free(c->pairs);
+  free(c);
+}
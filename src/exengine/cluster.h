@@ -0,0 +1,137 @@
+/* cluster
+  Clustered light assignment for the
+  lights that dont cast shadows.
+
+  The view frustum is split into a grid
+  of froxels, tiles on screen and log
+  spaced depth slices.  Every light is
+  binned into the froxels its sphere of
+  influence touches, giving each froxel
+  a range in one compact index list.
+
+  Light data, froxel ranges and indices
+  are uploaded once a frame as texture
+  buffers, the shaders then only loop
+  over the lights of their own froxel.
+
+  Binning doesnt touch gl, only upload
+  and bind do.
+*/
+
+#ifndef EX_CLUSTER_H
+#define EX_CLUSTER_H
+
+#include <stddef.h>
+#include <inttypes.h>
+#include "mathlib.h"
+#include "octree.h"
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#define EX_CLUSTER_X 16
+#define EX_CLUSTER_Y 9
+#define EX_CLUSTER_Z 24
+#define EX_CLUSTER_CELLS (EX_CLUSTER_X*EX_CLUSTER_Y*EX_CLUSTER_Z)
+
+// texture units for the three buffers
+#define EX_CLUSTER_UNIT 9
+
+typedef struct {
+  // view space, two texels per light
+  vec4 position_radius, color;
+} ex_cluster_light_t;
+
+typedef struct {
+  // view setup
+  mat4x4 view, projection;
+  float near, far, slice_scale, slice_bias;
+  float slices[EX_CLUSTER_Z+1];
+  ex_rect_t bounds[EX_CLUSTER_CELLS];
+
+  ex_cluster_light_t *lights;
+  size_t lights_len, lights_cap;
+
+  // offset and count into indices per froxel
+  uint32_t cells[EX_CLUSTER_CELLS][2];
+  uint32_t *indices;
+  size_t indices_len, indices_cap;
+
+  // froxel and light of every overlap, before sorting
+  uint32_t (*pairs)[2];
+  size_t pairs_len, pairs_cap;
+
+  // created on first upload
+  GLuint buffers[3], textures[3];
+} ex_cluster_t;
+
+/**
+ * [ex_cluster_new create an empty light grid]
+ * @return [the new grid]
+ */
+ex_cluster_t* ex_cluster_new();
+
+/**
+ * [ex_cluster_begin start a frame, clears the lights]
+ * @param c          [the grid]
+ * @param view       [the camera view matrix]
+ * @param projection [a symmetric perspective projection]
+ */
+void ex_cluster_begin(ex_cluster_t *c, mat4x4 view, mat4x4 projection);
+
+/**
+ * [ex_cluster_add_light add a light for this frame]
+ * @param c        [the grid]
+ * @param position [world space position]
+ * @param color    [the light color]
+ * @param radius   [how far the light reaches]
+ */
+void ex_cluster_add_light(ex_cluster_t *c, vec3 position, vec3 color, float radius);
+
+/**
+ * [ex_cluster_build bin the lights into froxels]
+ * @param c [the grid]
+ *
+ * Each froxel lists its lights in the order
+ * they were added.
+ */
+void ex_cluster_build(ex_cluster_t *c);
+
+/**
+ * [ex_cluster_cell the froxel a view space position falls in]
+ * @param  c        [the grid]
+ * @param  position [view space position]
+ * @return          [index into cells, same as the shaders]
+ */
+uint32_t ex_cluster_cell(ex_cluster_t *c, vec3 position);
+
+/**
+ * [ex_cluster_rect screen rect a light sphere covers]
+ * @param  c      [the grid]
+ * @param  center [view space center]
+ * @param  radius [the sphere radius]
+ * @param  rect   [ndc min x, min y, max x, max y]
+ * @return        [0 if the sphere is out of the depth range]
+ */
+int ex_cluster_rect(ex_cluster_t *c, vec3 center, float radius, vec4 rect);
+
+/**
+ * [ex_cluster_upload send this frames buffers to the gpu]
+ * @param c [the grid]
+ */
+void ex_cluster_upload(ex_cluster_t *c);
+
+/**
+ * [ex_cluster_bind bind the buffers for a shader]
+ * @param c      [the grid]
+ * @param shader [the shader to use]
+ */
+void ex_cluster_bind(ex_cluster_t *c, GLuint shader);
+
+/**
+ * [ex_cluster_destroy cleanup the grid]
+ * @param c [the grid to destroy]
+ */
+void ex_cluster_destroy(ex_cluster_t *c);
+
+#endif // EX_CLUSTER_H
@@ -3,6 +3,15 @@
 #include <string.h>
 #include <inttypes.h>
 #include <stdio.h>
+#include <stdlib.h>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define EX_COLL_WIDTH 8
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define EX_COLL_WIDTH 4
+#endif
 
 ex_plane_t ex_plane_new(const vec3 a, const vec3 b)
 {
@@ -386,6 +395,948 @@ void ex_collision_check_triangle(ex_coll_packet_t *packet, const vec3 p1, const
       memcpy(packet->a, p1, sizeof(vec3));
       memcpy(packet->b, p2, sizeof(vec3));
       memcpy(packet->c, p3, sizeof(vec3));
+      packet->hit_tri = -1;
     }
   }
-}
\ No newline at end of file
+}
+
+void ex_coll_cache_build(ex_coll_cache_t *cache, vec3 *vertices, size_t len)
+{
+  ex_coll_cache_destroy(cache);
+  if (len == 0)
+    return;
+
+  // one block, normals then d
+  float *mem = malloc(sizeof(float) * 4 * len);
+  for (int i=0; i<3; i++)
+    cache->normal[i] = &mem[len * i];
+  cache->d   = &mem[len * 3];
+  cache->len = len;
+
+  for (size_t t=0; t<len; t++) {
+    ex_plane_t plane = ex_triangle_to_plane(vertices[t*3+0], vertices[t*3+1], vertices[t*3+2]);
+    for (int i=0; i<3; i++)
+      cache->normal[i][t] = plane.normal[i];
+    cache->d[t] = plane.equation[3];
+  }
+}
+
+void ex_coll_cache_destroy(ex_coll_cache_t *cache)
+{
+  if (cache->len > 0)
+    free(cache->normal[0]);
+
+  memset(cache, 0, sizeof(ex_coll_cache_t));
+}
+
+#ifdef EX_COLL_WIDTH
+/*
+  Width independent wrappers for the batched
+  sweep below, 8 lanes with AVX, 4 with SSE.
+
+  The double ops mirror the double math in the
+  scalar path, each float vector is split into
+  two double vectors for those.
+*/
+#if EX_COLL_WIDTH == 8
+typedef __m256  ex_vf_t;
+typedef __m256d ex_vd_t;
+
+static inline ex_vf_t ex_vf_set1(float f)                 { return _mm256_set1_ps(f); }
+static inline ex_vf_t ex_vf_load(const float *p)          { return _mm256_loadu_ps(p); }
+static inline void    ex_vf_store(float *p, ex_vf_t a)    { _mm256_storeu_ps(p, a); }
+static inline ex_vf_t ex_vf_add(ex_vf_t a, ex_vf_t b)     { return _mm256_add_ps(a, b); }
+static inline ex_vf_t ex_vf_sub(ex_vf_t a, ex_vf_t b)     { return _mm256_sub_ps(a, b); }
+static inline ex_vf_t ex_vf_mul(ex_vf_t a, ex_vf_t b)     { return _mm256_mul_ps(a, b); }
+static inline ex_vf_t ex_vf_div(ex_vf_t a, ex_vf_t b)     { return _mm256_div_ps(a, b); }
+static inline ex_vf_t ex_vf_sqrt(ex_vf_t a)               { return _mm256_sqrt_ps(a); }
+static inline ex_vf_t ex_vf_and(ex_vf_t a, ex_vf_t b)     { return _mm256_and_ps(a, b); }
+static inline ex_vf_t ex_vf_or(ex_vf_t a, ex_vf_t b)      { return _mm256_or_ps(a, b); }
+static inline ex_vf_t ex_vf_xor(ex_vf_t a, ex_vf_t b)     { return _mm256_xor_ps(a, b); }
+static inline ex_vf_t ex_vf_andnot(ex_vf_t a, ex_vf_t b)  { return _mm256_andnot_ps(a, b); }
+static inline ex_vf_t ex_vf_lt(ex_vf_t a, ex_vf_t b)      { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+static inline ex_vf_t ex_vf_le(ex_vf_t a, ex_vf_t b)      { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+static inline ex_vf_t ex_vf_gt(ex_vf_t a, ex_vf_t b)      { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+static inline ex_vf_t ex_vf_ge(ex_vf_t a, ex_vf_t b)      { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+static inline ex_vf_t ex_vf_eq(ex_vf_t a, ex_vf_t b)      { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+static inline ex_vf_t ex_vf_select(ex_vf_t m, ex_vf_t a, ex_vf_t b) { return _mm256_blendv_ps(b, a, m); }
+static inline int     ex_vf_mask(ex_vf_t m)               { return _mm256_movemask_ps(m); }
+
+static inline ex_vd_t ex_vd_set1(double d)                { return _mm256_set1_pd(d); }
+static inline void    ex_vd_store(double *p, ex_vd_t a)   { _mm256_storeu_pd(p, a); }
+static inline ex_vd_t ex_vd_sub(ex_vd_t a, ex_vd_t b)     { return _mm256_sub_pd(a, b); }
+static inline ex_vd_t ex_vd_div(ex_vd_t a, ex_vd_t b)     { return _mm256_div_pd(a, b); }
+static inline ex_vd_t ex_vd_lt(ex_vd_t a, ex_vd_t b)      { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+static inline ex_vd_t ex_vd_gt(ex_vd_t a, ex_vd_t b)      { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+static inline ex_vd_t ex_vd_or(ex_vd_t a, ex_vd_t b)      { return _mm256_or_pd(a, b); }
+static inline ex_vd_t ex_vd_select(ex_vd_t m, ex_vd_t a, ex_vd_t b) { return _mm256_blendv_pd(b, a, m); }
+
+static inline void ex_vf_split(ex_vf_t a, ex_vd_t *lo, ex_vd_t *hi)
+{
+  *lo = _mm256_cvtps_pd(_mm256_castps256_ps128(a));
+  *hi = _mm256_cvtps_pd(_mm256_extractf128_ps(a, 1));
+}
+
+static inline ex_vf_t ex_vd_join(ex_vd_t lo, ex_vd_t hi)
+{
+  return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(lo)), _mm256_cvtpd_ps(hi), 1);
+}
+
+static inline ex_vf_t ex_vd_join_mask(ex_vd_t lo, ex_vd_t hi)
+{
+  __m256 l = _mm256_castpd_ps(lo), h = _mm256_castpd_ps(hi);
+  __m128 a = _mm_shuffle_ps(_mm256_castps256_ps128(l), _mm256_extractf128_ps(l, 1), _MM_SHUFFLE(2,0,2,0));
+  __m128 b = _mm_shuffle_ps(_mm256_castps256_ps128(h), _mm256_extractf128_ps(h, 1), _MM_SHUFFLE(2,0,2,0));
+  return _mm256_insertf128_ps(_mm256_castps128_ps256(a), b, 1);
+}
+#else
+typedef __m128  ex_vf_t;
+typedef __m128d ex_vd_t;
+
+static inline ex_vf_t ex_vf_set1(float f)                 { return _mm_set1_ps(f); }
+static inline ex_vf_t ex_vf_load(const float *p)          { return _mm_loadu_ps(p); }
+static inline void    ex_vf_store(float *p, ex_vf_t a)    { _mm_storeu_ps(p, a); }
+static inline ex_vf_t ex_vf_add(ex_vf_t a, ex_vf_t b)     { return _mm_add_ps(a, b); }
+static inline ex_vf_t ex_vf_sub(ex_vf_t a, ex_vf_t b)     { return _mm_sub_ps(a, b); }
+static inline ex_vf_t ex_vf_mul(ex_vf_t a, ex_vf_t b)     { return _mm_mul_ps(a, b); }
+static inline ex_vf_t ex_vf_div(ex_vf_t a, ex_vf_t b)     { return _mm_div_ps(a, b); }
+static inline ex_vf_t ex_vf_sqrt(ex_vf_t a)               { return _mm_sqrt_ps(a); }
+static inline ex_vf_t ex_vf_and(ex_vf_t a, ex_vf_t b)     { return _mm_and_ps(a, b); }
+static inline ex_vf_t ex_vf_or(ex_vf_t a, ex_vf_t b)      { return _mm_or_ps(a, b); }
+static inline ex_vf_t ex_vf_xor(ex_vf_t a, ex_vf_t b)     { return _mm_xor_ps(a, b); }
+static inline ex_vf_t ex_vf_andnot(ex_vf_t a, ex_vf_t b)  { return _mm_andnot_ps(a, b); }
+static inline ex_vf_t ex_vf_lt(ex_vf_t a, ex_vf_t b)      { return _mm_cmplt_ps(a, b); }
+static inline ex_vf_t ex_vf_le(ex_vf_t a, ex_vf_t b)      { return _mm_cmple_ps(a, b); }
+static inline ex_vf_t ex_vf_gt(ex_vf_t a, ex_vf_t b)      { return _mm_cmpgt_ps(a, b); }
+static inline ex_vf_t ex_vf_ge(ex_vf_t a, ex_vf_t b)      { return _mm_cmpge_ps(a, b); }
+static inline ex_vf_t ex_vf_eq(ex_vf_t a, ex_vf_t b)      { return _mm_cmpeq_ps(a, b); }
+static inline ex_vf_t ex_vf_select(ex_vf_t m, ex_vf_t a, ex_vf_t b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+static inline int     ex_vf_mask(ex_vf_t m)               { return _mm_movemask_ps(m); }
+
+static inline ex_vd_t ex_vd_set1(double d)                { return _mm_set1_pd(d); }
+static inline void    ex_vd_store(double *p, ex_vd_t a)   { _mm_storeu_pd(p, a); }
+static inline ex_vd_t ex_vd_sub(ex_vd_t a, ex_vd_t b)     { return _mm_sub_pd(a, b); }
+static inline ex_vd_t ex_vd_div(ex_vd_t a, ex_vd_t b)     { return _mm_div_pd(a, b); }
+static inline ex_vd_t ex_vd_lt(ex_vd_t a, ex_vd_t b)      { return _mm_cmplt_pd(a, b); }
+static inline ex_vd_t ex_vd_gt(ex_vd_t a, ex_vd_t b)      { return _mm_cmpgt_pd(a, b); }
+static inline ex_vd_t ex_vd_or(ex_vd_t a, ex_vd_t b)      { return _mm_or_pd(a, b); }
+static inline ex_vd_t ex_vd_select(ex_vd_t m, ex_vd_t a, ex_vd_t b) { return _mm_or_pd(_mm_and_pd(m, a), _mm_andnot_pd(m, b)); }
+
+static inline void ex_vf_split(ex_vf_t a, ex_vd_t *lo, ex_vd_t *hi)
+{
+  *lo = _mm_cvtps_pd(a);
+  *hi = _mm_cvtps_pd(_mm_movehl_ps(a, a));
+}
+
+static inline ex_vf_t ex_vd_join(ex_vd_t lo, ex_vd_t hi)
+{
+  return _mm_movelh_ps(_mm_cvtpd_ps(lo), _mm_cvtpd_ps(hi));
+}
+
+static inline ex_vf_t ex_vd_join_mask(ex_vd_t lo, ex_vd_t hi)
+{
+  return _mm_shuffle_ps(_mm_castpd_ps(lo), _mm_castpd_ps(hi), _MM_SHUFFLE(2,0,2,0));
+}
+#endif
+
+#define EX_VD_WIDTH (EX_COLL_WIDTH / 2)
+
+typedef struct {
+  ex_vf_t x, y, z;
+} ex_vf3_t;
+
+static inline ex_vf3_t ex_vf3_sub(ex_vf3_t a, ex_vf3_t b)
+{
+  ex_vf3_t r = {ex_vf_sub(a.x, b.x), ex_vf_sub(a.y, b.y), ex_vf_sub(a.z, b.z)};
+  return r;
+}
+
+static inline ex_vf3_t ex_vf3_add(ex_vf3_t a, ex_vf3_t b)
+{
+  ex_vf3_t r = {ex_vf_add(a.x, b.x), ex_vf_add(a.y, b.y), ex_vf_add(a.z, b.z)};
+  return r;
+}
+
+static inline ex_vf3_t ex_vf3_scale(ex_vf3_t a, ex_vf_t s)
+{
+  ex_vf3_t r = {ex_vf_mul(a.x, s), ex_vf_mul(a.y, s), ex_vf_mul(a.z, s)};
+  return r;
+}
+
+// same operand order as vec3_mul_cross and vec3_mul_inner,
+// so every lane rounds exactly like the scalar path
+static inline ex_vf3_t ex_vf3_cross(ex_vf3_t a, ex_vf3_t b)
+{
+  ex_vf3_t r = {
+    ex_vf_sub(ex_vf_mul(a.y, b.z), ex_vf_mul(a.z, b.y)),
+    ex_vf_sub(ex_vf_mul(a.z, b.x), ex_vf_mul(a.x, b.z)),
+    ex_vf_sub(ex_vf_mul(a.x, b.y), ex_vf_mul(a.y, b.x))
+  };
+  return r;
+}
+
+static inline ex_vf_t ex_vf3_dot(ex_vf3_t a, ex_vf3_t b)
+{
+  return ex_vf_add(ex_vf_add(ex_vf_mul(a.x, b.x), ex_vf_mul(a.y, b.y)), ex_vf_mul(a.z, b.z));
+}
+
+static inline ex_vf3_t ex_vf3_select(ex_vf_t m, ex_vf3_t a, ex_vf3_t b)
+{
+  ex_vf3_t r = {ex_vf_select(m, a.x, b.x), ex_vf_select(m, a.y, b.y), ex_vf_select(m, a.z, b.z)};
+  return r;
+}
+
+static inline ex_vf3_t ex_vf3_set1(const vec3 v)
+{
+  ex_vf3_t r = {ex_vf_set1(v[0]), ex_vf_set1(v[1]), ex_vf_set1(v[2])};
+  return r;
+}
+
+// ex_get_lowest_root across lanes, returns the lanes with a root
+static inline ex_vf_t ex_vf_lowest_root(ex_vf_t a, ex_vf_t b, ex_vf_t c, ex_vf_t max, ex_vf_t *root)
+{
+  ex_vf_t zero = ex_vf_set1(0.0f);
+  ex_vf_t det  = ex_vf_sub(ex_vf_mul(b, b), ex_vf_mul(ex_vf_mul(ex_vf_set1(4.0f), a), c));
+  ex_vf_t sq   = ex_vf_sqrt(det);
+  ex_vf_t nb   = ex_vf_xor(b, ex_vf_set1(-0.0f));
+  ex_vf_t a2   = ex_vf_mul(ex_vf_set1(2.0f), a);
+  ex_vf_t r1   = ex_vf_div(ex_vf_sub(nb, sq), a2);
+  ex_vf_t r2   = ex_vf_div(ex_vf_add(nb, sq), a2);
+
+  ex_vf_t swap = ex_vf_gt(r1, r2);
+  ex_vf_t lo   = ex_vf_select(swap, r2, r1);
+  ex_vf_t hi   = ex_vf_select(swap, r1, r2);
+
+  ex_vf_t lo_ok = ex_vf_and(ex_vf_gt(lo, zero), ex_vf_lt(lo, max));
+  ex_vf_t hi_ok = ex_vf_and(ex_vf_gt(hi, zero), ex_vf_lt(hi, max));
+
+  *root = ex_vf_select(lo_ok, lo, hi);
+  return ex_vf_andnot(ex_vf_lt(det, zero), ex_vf_or(lo_ok, hi_ok));
+}
+
+typedef struct {
+  float p[9][EX_COLL_WIDTH];   // triangle points, SoA
+  uint32_t tri[EX_COLL_WIDTH];  // cache index
+  float n[4][EX_COLL_WIDTH];   // plane normal and d
+  float point[3][EX_COLL_WIDTH];
+  float t[EX_COLL_WIDTH];
+  double t0[EX_COLL_WIDTH];
+  int found, inside;
+} ex_coll_batch_t;
+
+static void ex_collision_check_batch(ex_coll_packet_t *packet, ex_coll_batch_t *batch)
+{
+  ex_vf_t zero = ex_vf_set1(0.0f);
+  ex_vf_t one  = ex_vf_set1(1.0f);
+
+  // into ellipsoid space, kept for the packet
+  ex_vf_t e[9];
+  for (int i=0; i<9; i++) {
+    e[i] = ex_vf_div(ex_vf_load(batch->p[i]), ex_vf_set1(packet->e_radius[i%3]));
+    ex_vf_store(batch->p[i], e[i]);
+  }
+
+  ex_vf3_t p1 = {e[0], e[1], e[2]};
+  ex_vf3_t p2 = {e[3], e[4], e[5]};
+  ex_vf3_t p3 = {e[6], e[7], e[8]};
+
+  ex_vf3_t base     = ex_vf3_set1(packet->e_base_point);
+  ex_vf3_t velocity = ex_vf3_set1(packet->e_velocity);
+  ex_vf3_t norm_vel = ex_vf3_set1(packet->e_norm_velocity);
+
+  // plane, as in ex_triangle_to_plane
+  ex_vf3_t u = ex_vf3_sub(p2, p1);
+  ex_vf3_t v = ex_vf3_sub(p3, p1);
+  ex_vf3_t normal = ex_vf3_cross(u, v);
+  ex_vf_t k = ex_vf_div(one, ex_vf_sqrt(ex_vf3_dot(normal, normal)));
+  normal = ex_vf3_scale(normal, k);
+  ex_vf_t d = ex_vf_xor(ex_vf3_dot(normal, p1), ex_vf_set1(-0.0f));
+
+  // only front facing triangles
+  ex_vf_t alive = ex_vf_le(ex_vf3_dot(normal, norm_vel), zero);
+
+  ex_vf_t dist_to_plane  = ex_vf_add(ex_vf3_dot(base, normal), d);
+  ex_vf_t normal_dot_vel = ex_vf3_dot(normal, velocity);
+
+  // moving parallel, embedded for the whole sweep or never touching
+  ex_vf_t embedded = ex_vf_eq(normal_dot_vel, zero);
+  ex_vf_t abs_dist = ex_vf_andnot(ex_vf_set1(-0.0f), dist_to_plane);
+  alive = ex_vf_andnot(ex_vf_and(embedded, ex_vf_ge(abs_dist, one)), alive);
+
+  // the plane interval is computed in double, like the scalar path
+  ex_vd_t t0[2], dist_d[2], ndv_d[2];
+  ex_vf_split(dist_to_plane,  &dist_d[0], &dist_d[1]);
+  ex_vf_split(normal_dot_vel, &ndv_d[0],  &ndv_d[1]);
+  ex_vd_t miss[2];
+  for (int h=0; h<2; h++) {
+    ex_vd_t a = ex_vd_div(ex_vd_sub(ex_vd_set1(-1.0), dist_d[h]), ndv_d[h]);
+    ex_vd_t b = ex_vd_div(ex_vd_sub(ex_vd_set1( 1.0), dist_d[h]), ndv_d[h]);
+    ex_vd_t swap = ex_vd_gt(a, b);
+    ex_vd_t lo = ex_vd_select(swap, b, a);
+    ex_vd_t hi = ex_vd_select(swap, a, b);
+    miss[h]  = ex_vd_or(ex_vd_gt(lo, ex_vd_set1(1.0)), ex_vd_lt(hi, ex_vd_set1(0.0)));
+    t0[h]    = ex_vd_select(ex_vd_lt(lo, ex_vd_set1(0.0)), ex_vd_set1(0.0), lo);
+    ex_vd_store(&batch->t0[h * EX_VD_WIDTH], t0[h]);
+  }
+  alive = ex_vf_andnot(ex_vf_andnot(embedded, ex_vd_join_mask(miss[0], miss[1])), alive);
+
+  batch->found = batch->inside = 0;
+  if (!ex_vf_mask(alive))
+    return;
+
+  ex_vf_t t0f = ex_vd_join(t0[0], t0[1]);
+
+  // inside of the triangle, as in ex_check_point_in_triangle
+  ex_vf3_t plane_intersect = ex_vf3_add(ex_vf3_sub(base, normal), ex_vf3_scale(velocity, t0f));
+  ex_vf3_t w  = ex_vf3_sub(plane_intersect, p1);
+  ex_vf3_t vw = ex_vf3_cross(v, w);
+  ex_vf3_t vu = ex_vf3_cross(v, u);
+  ex_vf3_t uw = ex_vf3_cross(u, w);
+  ex_vf3_t uv = ex_vf3_cross(u, v);
+  ex_vf_t len_uv = ex_vf_sqrt(ex_vf3_dot(uv, uv));
+  ex_vf_t r = ex_vf_div(ex_vf_sqrt(ex_vf3_dot(vw, vw)), len_uv);
+  ex_vf_t s = ex_vf_div(ex_vf_sqrt(ex_vf3_dot(uw, uw)), len_uv);
+  ex_vf_t inside = ex_vf_le(ex_vf_add(r, s), one);
+  inside = ex_vf_andnot(ex_vf_lt(ex_vf3_dot(vw, vu), zero), inside);
+  inside = ex_vf_andnot(ex_vf_lt(ex_vf3_dot(uw, uv), zero), inside);
+  inside = ex_vf_and(ex_vf_andnot(embedded, alive), inside);
+
+  ex_vf3_t point = plane_intersect;
+  ex_vf_t t      = one;
+  ex_vf_t found  = ex_vf_set1(0.0f);
+
+  // the rest sweep against points then edges
+  ex_vf_t rest = ex_vf_andnot(inside, alive);
+  if (ex_vf_mask(rest)) {
+    ex_vf_t vel_len2 = ex_vf_set1(vec3_len2(packet->e_velocity));
+    ex_vf3_t *points[3] = {&p1, &p2, &p3};
+    ex_vf_t root;
+
+    for (int i=0; i<3; i++) {
+      ex_vf3_t to_base = ex_vf3_sub(base, *points[i]);
+      ex_vf3_t to_vert = ex_vf3_sub(*points[i], base);
+      ex_vf_t b = ex_vf_mul(ex_vf_set1(2.0f), ex_vf3_dot(to_base, velocity));
+      ex_vf_t c = ex_vf_sub(ex_vf3_dot(to_vert, to_vert), one);
+
+      // later points are only checked until one hits
+      ex_vf_t hit = ex_vf_lowest_root(vel_len2, b, c, t, &root);
+      hit   = ex_vf_and(hit, ex_vf_andnot(found, rest));
+      t     = ex_vf_select(hit, root, t);
+      point = ex_vf3_select(hit, *points[i], point);
+      found = ex_vf_or(found, hit);
+    }
+
+    for (int i=0; i<3; i++) {
+      ex_vf3_t edge    = ex_vf3_sub(*points[(i+1)%3], *points[i]);
+      ex_vf3_t to_vert = ex_vf3_sub(*points[i], base);
+      ex_vf_t edge_len2     = ex_vf3_dot(edge, edge);
+      ex_vf_t edge_dot_vel  = ex_vf3_dot(edge, velocity);
+      ex_vf_t edge_dot_vert = ex_vf3_dot(edge, to_vert);
+
+      ex_vf_t a = ex_vf_add(ex_vf_mul(edge_len2, ex_vf_xor(vel_len2, ex_vf_set1(-0.0f))),
+                            ex_vf_mul(edge_dot_vel, edge_dot_vel));
+      ex_vf_t b = ex_vf_sub(ex_vf_mul(edge_len2, ex_vf_mul(ex_vf_set1(2.0f), ex_vf3_dot(velocity, to_vert))),
+                            ex_vf_mul(ex_vf_mul(ex_vf_set1(2.0f), edge_dot_vel), edge_dot_vert));
+      ex_vf_t c = ex_vf_add(ex_vf_mul(edge_len2, ex_vf_sub(one, ex_vf3_dot(to_vert, to_vert))),
+                            ex_vf_mul(edge_dot_vert, edge_dot_vert));
+
+      // hit the infinite edge within the segment
+      ex_vf_t hit = ex_vf_and(ex_vf_lowest_root(a, b, c, t, &root), rest);
+      ex_vf_t f = ex_vf_div(ex_vf_sub(ex_vf_mul(edge_dot_vel, root), edge_dot_vert), edge_len2);
+      hit = ex_vf_and(hit, ex_vf_and(ex_vf_ge(f, zero), ex_vf_le(f, one)));
+
+      t     = ex_vf_select(hit, root, t);
+      point = ex_vf3_select(hit, ex_vf3_add(*points[i], ex_vf3_scale(edge, f)), point);
+      found = ex_vf_or(found, hit);
+    }
+  }
+
+  batch->inside = ex_vf_mask(inside);
+  batch->found  = ex_vf_mask(ex_vf_or(found, inside));
+  ex_vf_store(batch->t, t);
+  ex_vf_store(batch->point[0], point.x);
+  ex_vf_store(batch->point[1], point.y);
+  ex_vf_store(batch->point[2], point.z);
+  ex_vf_store(batch->n[0], normal.x);
+  ex_vf_store(batch->n[1], normal.y);
+  ex_vf_store(batch->n[2], normal.z);
+  ex_vf_store(batch->n[3], d);
+}
+#endif
+
+// the facing test only needs the sign of n.v, which
+// scaling both into ellipsoid space doesn't change, so
+// world space normals can reject back faces up front
+static inline int ex_coll_cache_back_facing(ex_coll_cache_t *cache, size_t tri, vec3 velocity, float bias)
+{
+  float f = cache->normal[0][tri] * velocity[0] +
+            cache->normal[1][tri] * velocity[1] +
+            cache->normal[2][tri] * velocity[2];
+  return f > bias;
+}
+
+#ifdef EX_COLL_WIDTH
+static void ex_collision_apply_batch(ex_coll_packet_t *packet, ex_coll_batch_t *batch, int lanes, float vel_len, int cached)
+{
+  ex_collision_check_batch(packet, batch);
+  batch->found &= (1 << lanes) - 1;
+  if (!batch->found)
+    return;
+
+  // hits are applied in triangle order, exactly
+  // like a run of ex_collision_check_triangle
+  for (int i=0; i<lanes; i++) {
+    if (!(batch->found & (1 << i)))
+      continue;
+
+    double t = batch->inside & (1 << i) ? batch->t0[i] : batch->t[i];
+    double dist_to_coll = t*vel_len;
+    if (packet->found_collision != 0 && !(dist_to_coll < packet->nearest_distance))
+      continue;
+
+    packet->nearest_distance = dist_to_coll;
+    packet->found_collision  = 1;
+    packet->t = t;
+    for (int j=0; j<3; j++) {
+      packet->intersect_point[j] = batch->point[j][i];
+      packet->a[j] = batch->p[j+0][i];
+      packet->b[j] = batch->p[j+3][i];
+      packet->c[j] = batch->p[j+6][i];
+      packet->plane.origin[j]   = batch->p[j][i];
+      packet->plane.normal[j]   = batch->n[j][i];
+      packet->plane.equation[j] = batch->n[j][i];
+    }
+    packet->plane.equation[3] = batch->n[3][i];
+    packet->hit_tri = cached ? (int)batch->tri[i] : -1;
+  }
+}
+#endif
+
+void ex_collision_check_triangles(ex_coll_packet_t *packet, vec3 *vertices, uint32_t *indices, size_t count, ex_coll_cache_t *cache)
+{
+  // r3 space velocity, and a margin so only clearly
+  // back facing triangles skip the exact test
+  vec3 velocity;
+  vec3_mul(velocity, packet->e_velocity, packet->e_radius);
+  float bias = EX_COLL_CACHE_BIAS * vec3_len(velocity);
+
+#ifdef EX_COLL_WIDTH
+  ex_coll_batch_t batch;
+  float vel_len = vec3_len(packet->e_velocity);
+  int lanes = 0;
+
+  for (size_t i=0; i<count; i++) {
+    size_t vert = indices ? indices[i] : i*3;
+    if (cache != NULL && ex_coll_cache_back_facing(cache, vert/3, velocity, bias))
+      continue;
+
+    // gather to SoA
+    batch.tri[lanes] = vert / 3;
+    for (int j=0; j<9; j++)
+      batch.p[j][lanes] = vertices[vert + j/3][j%3];
+
+    if (++lanes == EX_COLL_WIDTH) {
+      ex_collision_apply_batch(packet, &batch, lanes, vel_len, cache != NULL);
+      lanes = 0;
+    }
+  }
+
+  if (lanes > 0) {
+    // padding lanes repeat the first and
+    // get masked off afterwards
+    for (int i=lanes; i<EX_COLL_WIDTH; i++)
+      for (int j=0; j<9; j++)
+        batch.p[j][i] = batch.p[j][0];
+
+    ex_collision_apply_batch(packet, &batch, lanes, vel_len, cache != NULL);
+  }
+#else
+  for (size_t i=0; i<count; i++) {
+    size_t vert = indices ? indices[i] : i*3;
+    if (cache != NULL && ex_coll_cache_back_facing(cache, vert/3, velocity, bias))
+      continue;
+
+    vec3 a,b,c;
+    vec3_div(a, vertices[vert+0], packet->e_radius);
+    vec3_div(b, vertices[vert+1], packet->e_radius);
+    vec3_div(c, vertices[vert+2], packet->e_radius);
+
+    int hit = packet->found_collision;
+    float nearest = packet->nearest_distance;
+    ex_collision_check_triangle(packet, a, b, c);
+    if (cache != NULL && packet->found_collision && (!hit || packet->nearest_distance != nearest))
+      packet->hit_tri = vert / 3;
+  }
+#endif
+}
+
+#ifndef EX_COLL_WIDTH
+// ray_in_tri without the normalize, the simd
+// path below follows the same float sequence
+static inline int ex_ray_check_triangle(const vec3 from, const vec3 dir, const vec3 v0, const vec3 v1, const vec3 v2, float *t)
+{
+  vec3 edge1, edge2, h, s, q;
+  vec3_sub(edge1, v1, v0);
+  vec3_sub(edge2, v2, v0);
+
+  vec3_mul_cross(h, dir, edge2);
+  float a = vec3_mul_inner(edge1, h);
+  if (a > -FLT_EPSILON && a < FLT_EPSILON)
+    return 0;
+
+  float f = 1.0f / a;
+  vec3_sub(s, from, v0);
+  float u = f * vec3_mul_inner(s, h);
+  if (u < 0.0f || u > 1.0f)
+    return 0;
+
+  vec3_mul_cross(q, s, edge1);
+  float v = f * vec3_mul_inner(dir, q);
+  if (v < 0.0f || u + v > 1.0f)
+    return 0;
+
+  *t = f * vec3_mul_inner(edge2, q);
+  return *t > FLT_EPSILON;
+}
+#endif
+
+int ex_ray_check_triangles(const vec3 from, const vec3 dir, vec3 *vertices, uint32_t *indices, size_t count, float *dist)
+{
+  int nearest = -1;
+
+#ifdef EX_COLL_WIDTH
+  float p[9][EX_COLL_WIDTH], t[EX_COLL_WIDTH];
+  ex_vf_t zero = ex_vf_set1(0.0f), one = ex_vf_set1(1.0f);
+  ex_vf3_t origin    = ex_vf3_set1(from);
+  ex_vf3_t direction = ex_vf3_set1(dir);
+
+  for (size_t first=0; first<count; first+=EX_COLL_WIDTH) {
+    int lanes = MIN(count - first, EX_COLL_WIDTH);
+
+    // gather to SoA, padding lanes repeat the
+    // first and get masked off afterwards
+    for (int i=0; i<EX_COLL_WIDTH; i++) {
+      size_t tri  = first + (i < lanes ? i : 0);
+      size_t vert = indices ? indices[tri] : tri*3;
+      for (int j=0; j<9; j++)
+        p[j][i] = vertices[vert + j/3][j%3];
+    }
+
+    ex_vf3_t v0 = {ex_vf_load(p[0]), ex_vf_load(p[1]), ex_vf_load(p[2])};
+    ex_vf3_t v1 = {ex_vf_load(p[3]), ex_vf_load(p[4]), ex_vf_load(p[5])};
+    ex_vf3_t v2 = {ex_vf_load(p[6]), ex_vf_load(p[7]), ex_vf_load(p[8])};
+
+    ex_vf3_t edge1 = ex_vf3_sub(v1, v0);
+    ex_vf3_t edge2 = ex_vf3_sub(v2, v0);
+    ex_vf3_t h = ex_vf3_cross(direction, edge2);
+    ex_vf_t a = ex_vf3_dot(edge1, h);
+    ex_vf_t alive = ex_vf_or(ex_vf_le(a, ex_vf_set1(-FLT_EPSILON)), ex_vf_ge(a, ex_vf_set1(FLT_EPSILON)));
+
+    ex_vf_t f = ex_vf_div(one, a);
+    ex_vf3_t s = ex_vf3_sub(origin, v0);
+    ex_vf_t u = ex_vf_mul(f, ex_vf3_dot(s, h));
+    alive = ex_vf_andnot(ex_vf_or(ex_vf_lt(u, zero), ex_vf_gt(u, one)), alive);
+
+    ex_vf3_t q = ex_vf3_cross(s, edge1);
+    ex_vf_t v = ex_vf_mul(f, ex_vf3_dot(direction, q));
+    alive = ex_vf_andnot(ex_vf_or(ex_vf_lt(v, zero), ex_vf_gt(ex_vf_add(u, v), one)), alive);
+
+    ex_vf_t d = ex_vf_mul(f, ex_vf3_dot(edge2, q));
+    alive = ex_vf_and(alive, ex_vf_gt(d, ex_vf_set1(FLT_EPSILON)));
+    alive = ex_vf_and(alive, ex_vf_lt(d, ex_vf_set1(*dist)));
+
+    int mask = ex_vf_mask(alive) & ((1 << lanes) - 1);
+    if (!mask)
+      continue;
+
+    // earliest triangle wins ties, like the scalar loop
+    ex_vf_store(t, d);
+    for (int i=0; i<lanes; i++) {
+      if ((mask & (1 << i)) && t[i] < *dist) {
+        *dist   = t[i];
+        nearest = first + i;
+      }
+    }
+  }
+#else
+  for (size_t i=0; i<count; i++) {
+    size_t vert = indices ? indices[i] : i*3;
+    float t;
+    if (ex_ray_check_triangle(from, dir, vertices[vert+0], vertices[vert+1], vertices[vert+2], &t) && t < *dist) {
+      *dist   = t;
+      nearest = i;
+    }
+  }
+#endif
+
+  return nearest;
+}
+
+// closest point on ab to p, returns the squared distance
+static float ex_closest_point_segment(vec3 out, const vec3 p, const vec3 a, const vec3 b)
+{
+  vec3 ab, ap, d;
+  vec3_sub(ab, b, a);
+  vec3_sub(ap, p, a);
+
+  float len = vec3_mul_inner(ab, ab);
+  float t = len > 0.0f ? vec3_mul_inner(ap, ab) / len : 0.0f;
+  t = MAX(0.0f, MIN(t, 1.0f));
+  for (int i=0; i<3; i++)
+    out[i] = a[i] + ab[i] * t;
+
+  vec3_sub(d, p, out);
+  return vec3_mul_inner(d, d);
+}
+
+void ex_closest_point_triangle(vec3 out, const vec3 p, const vec3 a, const vec3 b, const vec3 c)
+{
+  // voronoi regions, Real-Time Collision Detection 5.1.5
+  vec3 ab, ac, ap, bp, cp;
+  vec3_sub(ab, b, a);
+  vec3_sub(ac, c, a);
+
+  // a degenerate triangle has no face and its
+  // regions fall apart, take the closest edge
+  float abab = vec3_mul_inner(ab, ab);
+  float acac = vec3_mul_inner(ac, ac);
+  float abac = vec3_mul_inner(ab, ac);
+  if (!(abab*acac - abac*abac > 1e-6f * abab*acac)) {
+    vec3 edge;
+    float best = ex_closest_point_segment(out, p, a, b);
+    float dist = ex_closest_point_segment(edge, p, b, c);
+    if (dist < best) {
+      best = dist;
+      memcpy(out, edge, sizeof(vec3));
+    }
+    dist = ex_closest_point_segment(edge, p, c, a);
+    if (dist < best)
+      memcpy(out, edge, sizeof(vec3));
+    return;
+  }
+
+  vec3_sub(ap, p, a);
+  float d1 = vec3_mul_inner(ab, ap);
+  float d2 = vec3_mul_inner(ac, ap);
+  if (d1 <= 0.0f && d2 <= 0.0f) {
+    memcpy(out, a, sizeof(vec3));
+    return;
+  }
+
+  vec3_sub(bp, p, b);
+  float d3 = vec3_mul_inner(ab, bp);
+  float d4 = vec3_mul_inner(ac, bp);
+  if (d3 >= 0.0f && d4 <= d3) {
+    memcpy(out, b, sizeof(vec3));
+    return;
+  }
+
+  float vc = d1*d4 - d3*d2;
+  if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+    float v = d1 / (d1 - d3);
+    for (int i=0; i<3; i++)
+      out[i] = a[i] + ab[i] * v;
+    return;
+  }
+
+  vec3_sub(cp, p, c);
+  float d5 = vec3_mul_inner(ab, cp);
+  float d6 = vec3_mul_inner(ac, cp);
+  if (d6 >= 0.0f && d5 <= d6) {
+    memcpy(out, c, sizeof(vec3));
+    return;
+  }
+
+  float vb = d5*d2 - d1*d6;
+  if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+    float w = d2 / (d2 - d6);
+    for (int i=0; i<3; i++)
+      out[i] = a[i] + ac[i] * w;
+    return;
+  }
+
+  float va = d3*d6 - d5*d4;
+  if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+    float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+    for (int i=0; i<3; i++)
+      out[i] = b[i] + (c[i] - b[i]) * w;
+    return;
+  }
+
+  // inside the face
+  float denom = 1.0f / (va + vb + vc);
+  float v = vb * denom;
+  float w = vc * denom;
+  for (int i=0; i<3; i++)
+    out[i] = a[i] + ab[i] * v + ac[i] * w;
+}
+
+static inline float ex_clamp01(float f)
+{
+  return MAX(0.0f, MIN(f, 1.0f));
+}
+
+float ex_closest_segment_segment(vec3 c1, vec3 c2, const vec3 p1, const vec3 q1, const vec3 p2, const vec3 q2)
+{
+  // Real-Time Collision Detection 5.1.9
+  vec3 d1, d2, r;
+  vec3_sub(d1, q1, p1);
+  vec3_sub(d2, q2, p2);
+  vec3_sub(r, p1, p2);
+  float a = vec3_mul_inner(d1, d1);
+  float e = vec3_mul_inner(d2, d2);
+  float f = vec3_mul_inner(d2, r);
+  float s, t;
+
+  if (a <= FLT_EPSILON && e <= FLT_EPSILON) {
+    s = t = 0.0f;
+  } else if (a <= FLT_EPSILON) {
+    s = 0.0f;
+    t = ex_clamp01(f / e);
+  } else {
+    float c = vec3_mul_inner(d1, r);
+    if (e <= FLT_EPSILON) {
+      t = 0.0f;
+      s = ex_clamp01(-c / a);
+    } else {
+      float b = vec3_mul_inner(d1, d2);
+      float denom = a*e - b*b;
+      s = denom != 0.0f ? ex_clamp01((b*f - c*e) / denom) : 0.0f;
+      t = (b*s + f) / e;
+      if (t < 0.0f) {
+        t = 0.0f;
+        s = ex_clamp01(-c / a);
+      } else if (t > 1.0f) {
+        t = 1.0f;
+        s = ex_clamp01((b - c) / a);
+      }
+    }
+  }
+
+  vec3 diff;
+  for (int i=0; i<3; i++) {
+    c1[i] = p1[i] + d1[i] * s;
+    c2[i] = p2[i] + d2[i] * t;
+  }
+  vec3_sub(diff, c1, c2);
+  return vec3_mul_inner(diff, diff);
+}
+
+float ex_closest_segment_triangle(vec3 cs, vec3 ct, const vec3 p, const vec3 q, const vec3 a, const vec3 b, const vec3 c)
+{
+  // segment passing through the face
+  vec3 dir, edge1, edge2, h, s, r;
+  vec3_sub(dir, q, p);
+  vec3_sub(edge1, b, a);
+  vec3_sub(edge2, c, a);
+  vec3_mul_cross(h, dir, edge2);
+  float det = vec3_mul_inner(edge1, h);
+  if (det > FLT_EPSILON || det < -FLT_EPSILON) {
+    float f = 1.0f / det;
+    vec3_sub(s, p, a);
+    float u = f * vec3_mul_inner(s, h);
+    vec3_mul_cross(r, s, edge1);
+    float v = f * vec3_mul_inner(dir, r);
+    float t = f * vec3_mul_inner(edge2, r);
+    if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t >= 0.0f && t <= 1.0f) {
+      for (int i=0; i<3; i++)
+        cs[i] = ct[i] = p[i] + dir[i] * t;
+      return 0.0f;
+    }
+  }
+
+  // otherwise the closest pair involves an
+  // end point or one of the triangle edges
+  vec3 tmp_s, tmp_t, diff;
+  float best;
+  memcpy(cs, p, sizeof(vec3));
+  ex_closest_point_triangle(ct, p, a, b, c);
+  vec3_sub(diff, cs, ct);
+  best = vec3_mul_inner(diff, diff);
+
+  ex_closest_point_triangle(tmp_t, q, a, b, c);
+  vec3_sub(diff, q, tmp_t);
+  float d = vec3_mul_inner(diff, diff);
+  if (d < best) {
+    best = d;
+    memcpy(cs, q, sizeof(vec3));
+    memcpy(ct, tmp_t, sizeof(vec3));
+  }
+
+  const float *points[3] = {a, b, c};
+  for (int i=0; i<3; i++) {
+    d = ex_closest_segment_segment(tmp_s, tmp_t, p, q, points[i], points[(i+1)%3]);
+    if (d < best) {
+      best = d;
+      memcpy(cs, tmp_s, sizeof(vec3));
+      memcpy(ct, tmp_t, sizeof(vec3));
+    }
+  }
+
+  return best;
+}
+
+// separating axes of a box and a triangle, the
+// box faces, the triangle face, and the crosses
+// of their edges, parallel edges are skipped
+static int ex_aabb_triangle_axes(vec3 axes[13], const vec3 a, const vec3 b, const vec3 c)
+{
+  vec3 edges[3];
+  vec3_sub(edges[0], b, a);
+  vec3_sub(edges[1], c, b);
+  vec3_sub(edges[2], a, c);
+
+  int count = 0;
+  for (int i=0; i<3; i++) {
+    vec3 e = {0.0f, 0.0f, 0.0f};
+    e[i] = 1.0f;
+    memcpy(axes[count++], e, sizeof(vec3));
+
+    for (int j=0; j<3; j++) {
+      vec3_mul_cross(axes[count], e, edges[j]);
+      if (vec3_mul_inner(axes[count], axes[count]) > FLT_EPSILON)
+        count++;
+    }
+  }
+
+  vec3_mul_cross(axes[count], edges[0], edges[1]);
+  if (vec3_mul_inner(axes[count], axes[count]) > FLT_EPSILON)
+    count++;
+
+  return count;
+}
+
+// projects the triangle relative to the box
+// center, and the boxes radius, onto an axis
+static inline void ex_aabb_triangle_project(const vec3 axis, const vec3 center, const vec3 half, const vec3 a, const vec3 b, const vec3 c, float *min, float *max, float *radius)
+{
+  vec3 d;
+  vec3_sub(d, a, center);
+  float pa = vec3_mul_inner(axis, d);
+  vec3_sub(d, b, center);
+  float pb = vec3_mul_inner(axis, d);
+  vec3_sub(d, c, center);
+  float pc = vec3_mul_inner(axis, d);
+
+  *min = MIN(pa, MIN(pb, pc));
+  *max = MAX(pa, MAX(pb, pc));
+  *radius = half[0] * fabsf(axis[0]) + half[1] * fabsf(axis[1]) + half[2] * fabsf(axis[2]);
+}
+
+int ex_aabb_triangle(const vec3 center, const vec3 half, const vec3 a, const vec3 b, const vec3 c, vec3 normal, float *depth)
+{
+  vec3 axes[13];
+  int count = ex_aabb_triangle_axes(axes, a, b, c);
+
+  // least penetration gives the push out
+  *depth = FLT_MAX;
+  for (int i=0; i<count; i++) {
+    float min, max, r;
+    ex_aabb_triangle_project(axes[i], center, half, a, b, c, &min, &max, &r);
+    if (min > r || max < -r)
+      return 0;
+
+    float len = vec3_len(axes[i]);
+    float up   = (max + r) / len;
+    float down = (r - min) / len;
+    float d = MIN(up, down);
+    if (d < *depth) {
+      *depth = d;
+      vec3_scale(normal, axes[i], (up < down ? 1.0f : -1.0f) / len);
+    }
+  }
+
+  return 1;
+}
+
+int ex_aabb_triangle_sweep(const vec3 center, const vec3 half, const vec3 motion, const vec3 a, const vec3 b, const vec3 c, float *t, vec3 normal)
+{
+  vec3 axes[13];
+  int count = ex_aabb_triangle_axes(axes, a, b, c);
+
+  // the box touches the triangle while the moving
+  // intervals overlap on every axis at once
+  float enter = -FLT_MAX, leave = FLT_MAX;
+  int enter_axis = -1;
+  float enter_sign = 1.0f;
+  for (int i=0; i<count; i++) {
+    float min, max, r;
+    ex_aabb_triangle_project(axes[i], center, half, a, b, c, &min, &max, &r);
+    float speed = vec3_mul_inner(axes[i], motion);
+
+    float t0, t1;
+    if (speed == 0.0f) {
+      if (min > r || max < -r)
+        return 0;
+      continue;
+    } else if (speed > 0.0f) {
+      t0 = (min - r) / speed;
+      t1 = (max + r) / speed;
+    } else {
+      t0 = (max + r) / speed;
+      t1 = (min - r) / speed;
+    }
+
+    if (t0 > enter) {
+      enter = t0;
+      enter_axis = i;
+      enter_sign = speed > 0.0f ? -1.0f : 1.0f;
+    }
+    leave = MIN(leave, t1);
+    if (enter > leave || enter > 1.0f || leave < 0.0f)
+      return 0;
+  }
+
+  if (enter <= 0.0f) {
+    // already touching
+    float depth;
+    *t = 0.0f;
+    if (!ex_aabb_triangle(center, half, a, b, c, normal, &depth))
+      vec3_scale(normal, motion, -1.0f / vec3_len(motion));
+    return 1;
+  }
+
+  *t = enter;
+  vec3_scale(normal, axes[enter_axis], enter_sign / vec3_len(axes[enter_axis]));
+  return 1;
+}
+
+int ex_capsule_triangle_sweep(const vec3 a, const vec3 b, float radius, const vec3 motion, const vec3 v0, const vec3 v1, const vec3 v2, float *t, vec3 normal)
+{
+  float len = vec3_len(motion);
+  float time = 0.0f;
+
+  // conservative advancement, the capsule can
+  // always move its distance to the triangle
+  for (int i=0; i<EX_COLL_SWEEP_ITERATIONS; i++) {
+    vec3 pa, pb, move, cs, ct;
+    vec3_scale(move, motion, time);
+    vec3_add(pa, a, move);
+    vec3_add(pb, b, move);
+
+    float dist = sqrtf(ex_closest_segment_triangle(cs, ct, pa, pb, v0, v1, v2)) - radius;
+    if (dist <= EX_COLL_SWEEP_EPSILON) {
+      *t = time;
+      vec3_sub(normal, cs, ct);
+      float n = vec3_len(normal);
+      if (n > 0.0f) {
+        vec3_scale(normal, normal, 1.0f / n);
+      } else {
+        ex_plane_t plane = ex_triangle_to_plane(v0, v1, v2);
+        memcpy(normal, plane.normal, sizeof(vec3));
+      }
+      return 1;
+    }
+
+    if (len <= 0.0f)
+      return 0;
+
+    time += dist / len;
+    if (time > 1.0f)
+      return 0;
+  }
+
+  // still creeping along a grazing pass,
+  // it never got close enough to count
+  return 0;
+}
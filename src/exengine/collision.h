@@ -9,8 +9,19 @@
 #ifndef EX_COLLISION_H
 #define EX_COLLISION_H
 
+#include <stddef.h>
+#include <inttypes.h>
 #include "mathlib.h"
 
+// cos of the angle past which a cached normal
+// counts as back facing without the exact test
+#define EX_COLL_CACHE_BIAS 0.001f
+
+// capsule sweeps step until this close, a
+// pass still further after this many misses
+#define EX_COLL_SWEEP_EPSILON 0.001f
+#define EX_COLL_SWEEP_ITERATIONS 64
+
 typedef struct {
   vec3 origin;
   vec3 normal;
@@ -39,8 +50,22 @@ typedef struct {
 
   // iteration depth
   int depth;
+
+  // cache index of the triangle hit, -1 if none
+  int hit_tri;
 } ex_coll_packet_t;
 
+/*
+  Per triangle world space planes, built
+  with the collision tree.  The sweep uses
+  them to skip back faces before gathering
+  vertices, grounding reads the hit normal.
+*/
+typedef struct {
+  float *normal[3], *d;
+  size_t len;
+} ex_coll_cache_t;
+
 /**
  * [ex_plane_new defines a plane from a origin and normal]
  * @param  a [plane origin]
@@ -116,4 +141,132 @@ int ray_in_tri(vec3 from, vec3 to, vec3 v0, vec3 v1, vec3 v2, vec3 intersect);
  */
 void ex_collision_check_triangle(ex_coll_packet_t *packet, const vec3 p1, const vec3 p2, const vec3 p3);
 
+/**
+ * [ex_collision_check_triangles batched ex_collision_check_triangle]
+ * @param packet   [the collision packet]
+ * @param vertices [the triangle vertices in r3 space]
+ * @param indices  [first vertex of each triangle, NULL if sequential]
+ * @param count    [the triangle count]
+ * @param cache    [planes for vertices, or NULL]
+ *
+ * Moves triangles into ellipsoid space itself and
+ * tests 8 at a time with AVX, 4 with SSE, falling
+ * back to the scalar path otherwise.  Gives the same
+ * nearest hit as checking each triangle in order,
+ * with a cache clearly back facing triangles are
+ * skipped without being gathered.
+ */
+void ex_collision_check_triangles(ex_coll_packet_t *packet, vec3 *vertices, uint32_t *indices, size_t count, ex_coll_cache_t *cache);
+
+/**
+ * [ex_ray_check_triangles find the nearest triangle along a ray]
+ * @param  from     [the ray origin]
+ * @param  dir      [the ray direction, distances are in its length]
+ * @param  vertices [the triangle vertices]
+ * @param  indices  [first vertex of each triangle, NULL if sequential]
+ * @param  count    [the triangle count]
+ * @param  dist     [hits must be closer than this, updated on a hit]
+ * @return          [the position of the nearest hit in the list, -1 if none]
+ *
+ * Möller–Trumbore against 8 triangles at a
+ * time with AVX, 4 with SSE, scalar otherwise.
+ */
+int ex_ray_check_triangles(const vec3 from, const vec3 dir, vec3 *vertices, uint32_t *indices, size_t count, float *dist);
+
+/**
+ * [ex_closest_point_triangle closest point on a triangle to p]
+ * @param out [the closest point]
+ * @param p   [the point]
+ * @param a   [tri p1]
+ * @param b   [tri p2]
+ * @param c   [tri p3]
+ */
+void ex_closest_point_triangle(vec3 out, const vec3 p, const vec3 a, const vec3 b, const vec3 c);
+
+/**
+ * [ex_closest_segment_segment closest points between two segments]
+ * @param  c1 [the closest point on p1 q1]
+ * @param  c2 [the closest point on p2 q2]
+ * @param  p1 [segment 1 start]
+ * @param  q1 [segment 1 end]
+ * @param  p2 [segment 2 start]
+ * @param  q2 [segment 2 end]
+ * @return    [the squared distance between c1 and c2]
+ */
+float ex_closest_segment_segment(vec3 c1, vec3 c2, const vec3 p1, const vec3 q1, const vec3 p2, const vec3 q2);
+
+/**
+ * [ex_closest_segment_triangle closest points between a segment and a triangle]
+ * @param  cs [the closest point on the segment]
+ * @param  ct [the closest point on the triangle]
+ * @param  p  [segment start]
+ * @param  q  [segment end]
+ * @param  a  [tri p1]
+ * @param  b  [tri p2]
+ * @param  c  [tri p3]
+ * @return    [the squared distance between cs and ct]
+ */
+float ex_closest_segment_triangle(vec3 cs, vec3 ct, const vec3 p, const vec3 q, const vec3 a, const vec3 b, const vec3 c);
+
+/**
+ * [ex_aabb_triangle separating axis test of a box and a triangle]
+ * @param  center [the box center]
+ * @param  half   [the box half extents]
+ * @param  a      [tri p1]
+ * @param  b      [tri p2]
+ * @param  c      [tri p3]
+ * @param  normal [returned direction to push the box out]
+ * @param  depth  [returned distance to push the box out]
+ * @return        [1 if they overlap]
+ */
+int ex_aabb_triangle(const vec3 center, const vec3 half, const vec3 a, const vec3 b, const vec3 c, vec3 normal, float *depth);
+
+/**
+ * [ex_aabb_triangle_sweep first contact of a moving box and a triangle]
+ * @param  center [the box center]
+ * @param  half   [the box half extents]
+ * @param  motion [the boxes movement]
+ * @param  a      [tri p1]
+ * @param  b      [tri p2]
+ * @param  c      [tri p3]
+ * @param  t      [returned fraction of motion at first contact]
+ * @param  normal [returned contact normal, facing against motion]
+ * @return        [1 if they touch within motion]
+ */
+int ex_aabb_triangle_sweep(const vec3 center, const vec3 half, const vec3 motion, const vec3 a, const vec3 b, const vec3 c, float *t, vec3 normal);
+
+/**
+ * [ex_capsule_triangle_sweep first contact of a moving capsule and a triangle]
+ * @param  a      [capsule segment start]
+ * @param  b      [capsule segment end]
+ * @param  radius [capsule radius]
+ * @param  motion [the capsules movement]
+ * @param  v0     [tri p1]
+ * @param  v1     [tri p2]
+ * @param  v2     [tri p3]
+ * @param  t      [returned fraction of motion at first contact]
+ * @param  normal [returned contact normal, from the triangle to the capsule]
+ * @return        [1 if they touch within motion]
+ *
+ * Stops within EX_COLL_SWEEP_EPSILON of the
+ * triangle, never past it.  A grazing pass that
+ * doesn't get that close within the iterations
+ * is a miss.
+ */
+int ex_capsule_triangle_sweep(const vec3 a, const vec3 b, float radius, const vec3 motion, const vec3 v0, const vec3 v1, const vec3 v2, float *t, vec3 normal);
+
+/**
+ * [ex_coll_cache_build precompute triangle planes]
+ * @param cache    [the cache to rebuild, zeroed before first use]
+ * @param vertices [the triangle vertices in r3 space]
+ * @param len      [the triangle count]
+ */
+void ex_coll_cache_build(ex_coll_cache_t *cache, vec3 *vertices, size_t len);
+
+/**
+ * [ex_coll_cache_destroy cleanup cache data]
+ * @param cache [the cache to clear]
+ */
+void ex_coll_cache_destroy(ex_coll_cache_t *cache);
+
 #endif // EX_COLLISION_H
\ No newline at end of file
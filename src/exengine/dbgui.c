@@ -95,6 +95,10 @@ void ex_dbgui_render_profiler()
   if (build)
     scene->collision_built = 0;
   igText("Render Time %i FPS (%.2fms)", (int)(1.0/ex_frame_time), 1000.0/(1.0/ex_frame_time));
+  ex_render_stats_t *rs = &scene->queue->stats;
+  igText("Last Pass %u draws, binds %u/%u skipped, textures %u/%u skipped, uniforms %u/%u skipped",
+    rs->draws, rs->programs_skipped + rs->vaos_skipped, rs->programs + rs->vaos + rs->programs_skipped + rs->vaos_skipped,
+    rs->textures_skipped, rs->textures + rs->textures_skipped, rs->uniforms_skipped, rs->uniforms + rs->uniforms_skipped);
   igNewLine();
 
   float last_offset = 0.0f;
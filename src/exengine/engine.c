@@ -14,6 +14,7 @@
 #include "text.h"
 #include "cache.h"
 #include "dbgui.h"
+#include "jobs.h"
 
 // renderer feature toggles
 int ex_enable_ssao = 1;
@@ -43,6 +44,9 @@ void exengine(char **argv, uint8_t flags)
   // init engine file data cache
   ex_cache_init();
 
+  // init worker threads, one per core
+  ex_jobs_init(0);
+
   // init subsystems
   if (flags & EX_ENGINE_SOUND)
     ex_sound_init();
@@ -121,6 +125,7 @@ void exengine(char **argv, uint8_t flags)
   PHYSFS_deinit();
   ex_cache_flush();
   ex_framebuffer_cleanup();
+  ex_jobs_shutdown();
   if (flags & EX_ENGINE_SOUND)
     ex_sound_exit();
 
@@ -1,6 +1,7 @@
 #include "entity.h"
 #include "exe_list.h"
 #include "model.h"
+#include "jobs.h"
 #include <stdlib.h>
 #include <string.h>
 
@@ -18,9 +19,22 @@ ex_entity_t* ex_entity_new(ex_scene_t *scene, vec3 radius)
   memset(e->velocity, 0,      sizeof(vec3));
   e->scene = scene;
   e->grounded = 0;
+  e->sleeping = 0;
+  e->resting  = 0;
+  e->rest_speed = 0.0f;
+  memset(&e->stats, 0, sizeof(ex_entity_stats_t));
+  ex_query_buffer_init(&e->query);
+  ex_query_buffer_init(&e->dyn_query);
   return e;
 }
 
+void ex_entity_destroy(ex_entity_t *entity)
+{
+  ex_query_buffer_destroy(&entity->query);
+  ex_query_buffer_destroy(&entity->dyn_query);
+  free(entity);
+}
+
 void ex_entity_collide_and_slide(ex_entity_t *entity)
 {
   memcpy(entity->packet.r3_position, entity->position, sizeof(vec3));
@@ -69,6 +83,7 @@ void ex_entity_collide_with_world(ex_entity_t *entity, vec3 e_position, vec3 e_v
     entity->packet.found_collision = 0;
     entity->packet.nearest_distance = FLT_MAX;
     entity->packet.t = 0.0f;
+    entity->packet.hit_tri = -1;
     
     // check for collision
     ex_entity_check_collision(entity);
@@ -140,39 +155,21 @@ void ex_entity_check_collision(ex_entity_t *entity)
   vec3_sub(r.min, r.min, entity->radius);
   vec3_add(r.max, entity->position, entity->radius);
   vec3_add(r.max, r.max, entity->radius);
- 
-  int count = 0;
-  ex_octree_get_colliding_count(entity->scene->coll_tree, &r, &count);
-
-  if (count <= 0)
-    return;
 
-  ex_octree_data_t *data = malloc(sizeof(ex_octree_data_t) * count);
-  for (int i=0; i<count; i++) {
-    data[i].data = NULL;
-    data[i].len  = 0;
-  }
-
-  int index = 0;
-  ex_octree_get_colliding(entity->scene->coll_tree, &r, data, &index);
-
-  vec3 *vertices = entity->scene->coll_vertices;
-  for (int i=0; i<count; i++) {
-    uint32_t *indices = (uint32_t*)data[i].data;
-
-    if (indices == NULL)
-      continue;
+  ex_scene_query_collision(entity->scene, &r, &entity->query);
+  ex_collision_check_triangles(&entity->packet, entity->scene->coll_vertices, entity->query.data, entity->query.len, &entity->scene->coll_cache);
 
-    for (int k=0; k<data[i].len; k++) {
-      vec3 a,b,c;
-      vec3_div(a, vertices[indices[k]+0], entity->packet.e_radius);
-      vec3_div(b, vertices[indices[k]+1], entity->packet.e_radius);
-      vec3_div(c, vertices[indices[k]+2], entity->packet.e_radius);
-      ex_collision_check_triangle(&entity->packet, a, b, c);
-    }
+  // dynamic colliders
+  ex_loose_octree_query(entity->scene->dyn_tree, &r, &entity->dyn_query);
+  for (size_t i=0; i<entity->dyn_query.len; i++) {
+    ex_collider_t *collider = entity->scene->colliders.items[entity->dyn_query.data[i]];
+    ex_collision_check_triangles(&entity->packet, collider->world, NULL, collider->len / 3, NULL);
+    entity->stats.tris += collider->len / 3;
   }
 
-  free(data);
+  entity->stats.sweeps++;
+  entity->stats.tris  += entity->query.len;
+  entity->stats.nodes += entity->query.nodes + entity->dyn_query.nodes;
 }
 
 void ex_entity_check_grounded(ex_entity_t *entity)
@@ -180,20 +177,55 @@ void ex_entity_check_grounded(ex_entity_t *entity)
   if (!entity->packet.found_collision)
     return;
 
-  vec3 axis = {0.0f};
-  axis[DOWN_AXIS] = 1.0f;
-
-  vec3 a, b, c;
-  vec3_mul(a, entity->packet.a, entity->radius);
-  vec3_mul(b, entity->packet.b, entity->radius);
-  vec3_mul(c, entity->packet.c, entity->radius);
-  ex_plane_t plane = ex_triangle_to_plane(a, b, c);
-  float f = vec3_mul_inner(plane.normal, axis);
+  float f;
+  if (entity->packet.hit_tri >= 0) {
+    // static geometry, the world normal is cached
+    f = entity->scene->coll_cache.normal[DOWN_AXIS][entity->packet.hit_tri];
+  } else {
+    vec3 axis = {0.0f};
+    axis[DOWN_AXIS] = 1.0f;
+
+    vec3 a, b, c;
+    vec3_mul(a, entity->packet.a, entity->radius);
+    vec3_mul(b, entity->packet.b, entity->radius);
+    vec3_mul(c, entity->packet.c, entity->radius);
+    ex_plane_t plane = ex_triangle_to_plane(a, b, c);
+    f = vec3_mul_inner(plane.normal, axis);
+  }
 
   if (f >= SLOPE_WALK_ANGLE)
     entity->grounded = 1;
 }
 
+static int ex_entity_can_sleep(ex_entity_t *entity)
+{
+  if (!entity->grounded || !entity->resting)
+    return 0;
+
+  // only slowing down sends it to sleep, anything
+  // speeding it up wakes it however small, so
+  // gentle pushes build up instead of being lost
+  float speed = vec3_len(entity->velocity);
+  if (speed > 0.0f && speed >= entity->rest_speed)
+    return 0;
+
+  // moved by hand, or the ground under it changed
+  if (memcmp(entity->position, entity->rest_position, sizeof(vec3)) != 0)
+    return 0;
+  if (entity->rest_version != entity->scene->coll_version)
+    return 0;
+
+  // dynamic colliders can move without telling us
+  ex_rect_t r;
+  vec3_sub(r.min, entity->position, entity->radius);
+  vec3_sub(r.min, r.min, entity->radius);
+  vec3_add(r.max, entity->position, entity->radius);
+  vec3_add(r.max, r.max, entity->radius);
+  ex_loose_octree_query(entity->scene->dyn_tree, &r, &entity->dyn_query);
+
+  return entity->dyn_query.len == 0;
+}
+
 void ex_entity_update(ex_entity_t *entity, double dt)
 {
   vec3 xz = {0.0f};
@@ -206,74 +238,229 @@ void ex_entity_update(ex_entity_t *entity, double dt)
     entity->velocity[1] = 0.0f;
   else
     entity->grounded = 0;
+
+  if (ex_entity_can_sleep(entity)) {
+    memset(entity->velocity, 0, sizeof(vec3));
+    entity->rest_speed = 0.0f;
+    entity->sleeping   = 1;
+    return;
+  }
+  entity->sleeping = 0;
+
+  // enough substeps that none moves further
+  // than a fraction of the smallest radius
+  float radius = MIN(entity->radius[0], MIN(entity->radius[1], entity->radius[2]));
+  float dist   = vec3_len(entity->velocity) * dt;
+  int steps    = (int)ceilf(dist / (radius * EX_ENTITY_SUBSTEP_SCALE));
+  steps = MAX(1, MIN(steps, EX_ENTITY_MAX_SUBSTEPS));
   
-  dt = dt / 5.0;
+  dt = dt / (double)steps;
   
   vec3_scale(entity->velocity, entity->velocity, dt);
-  for (int i=0; i<5; i++)
+  for (int i=0; i<steps; i++)
     ex_entity_collide_and_slide(entity);
   vec3_sub(entity->velocity, entity->position, entity->packet.r3_position);
   vec3_scale(entity->velocity, entity->velocity, 1.0 / dt);
+
+  // came to rest, sleep from the next update
+  entity->rest_speed = vec3_len(entity->velocity);
+  entity->resting    = entity->grounded && entity->rest_speed < EX_ENTITY_SLEEP_VELOCITY;
+  memcpy(entity->rest_position, entity->position, sizeof(vec3));
+  entity->rest_version = entity->scene->coll_version;
 }
 
-float raycast(ex_entity_t *entity, vec3 from, vec3 to, ex_plane_t *plane)
+typedef struct {
+  ex_entity_t **entities;
+  double dt;
+} ex_entity_batch_t;
+
+static void ex_entity_update_job(void *data, size_t index)
 {
-  vec3 a,b;
-  memcpy(a, from, sizeof(vec3));
-  vec3_add(b, from, to);
+  ex_entity_batch_t *batch = data;
+  ex_entity_update(batch->entities[index], batch->dt);
+}
 
-  ex_rect_t r;
-  vec3_min(r.min, a, b);
-  vec3_max(r.max, a, b);
-  
-  int count = 0;
-  ex_octree_get_colliding_count(entity->scene->coll_tree, &r, &count);
+void ex_entity_update_batch(ex_entity_t **entities, size_t count, double dt)
+{
+  ex_entity_batch_t batch = {entities, dt};
+  ex_jobs_run(ex_entity_update_job, &batch, count);
+}
 
-  if (count <= 0)
-    return 0.0f;
+void ex_entity_snapshot(ex_entity_t **entities, size_t count, ex_entity_state_t *out)
+{
+  for (size_t i=0; i<count; i++) {
+    ex_entity_t *e = entities[i];
+    ex_entity_state_t *state = &out[i];
+    memset(state, 0, sizeof(ex_entity_state_t));
+    memcpy(state->position,      e->position,      sizeof(vec3));
+    memcpy(state->velocity,      e->velocity,      sizeof(vec3));
+    memcpy(state->rest_position, e->rest_position, sizeof(vec3));
+    state->rest_speed   = e->rest_speed;
+    state->rest_version = e->rest_version;
+    state->grounded     = e->grounded;
+    state->sleeping     = e->sleeping;
+    state->resting      = e->resting;
+  }
+}
 
-  ex_octree_data_t *data = malloc(sizeof(ex_octree_data_t) * count);
-  for (int i=0; i<count; i++) {
-    data[i].data = NULL; 
-    data[i].len  = 0;
+void ex_entity_restore(ex_entity_t **entities, size_t count, const ex_entity_state_t *in)
+{
+  for (size_t i=0; i<count; i++) {
+    ex_entity_t *e = entities[i];
+    const ex_entity_state_t *state = &in[i];
+    memcpy(e->position,      state->position,      sizeof(vec3));
+    memcpy(e->velocity,      state->velocity,      sizeof(vec3));
+    memcpy(e->rest_position, state->rest_position, sizeof(vec3));
+    e->rest_speed   = state->rest_speed;
+    e->rest_version = state->rest_version;
+    e->grounded     = state->grounded;
+    e->sleeping     = state->sleeping;
+    e->resting      = state->resting;
   }
+}
+
+float raycast(ex_entity_t *entity, vec3 from, vec3 to, ex_plane_t *plane)
+{
+  ex_ray_t ray;
+  memcpy(ray.from, from, sizeof(vec3));
+  memcpy(ray.to,   to,   sizeof(vec3));
+
+  ex_ray_hit_t hit;
+  ex_scene_raycast(entity->scene, &ray, &hit, 1);
+  if (!hit.hit)
+    return 0;
+
+  memcpy(plane, &hit.plane, sizeof(ex_plane_t));
+  return hit.dist;
+}
+
+ex_entity_broadphase_t* ex_entity_broadphase_new()
+{
+  ex_entity_broadphase_t *b = malloc(sizeof(ex_entity_broadphase_t));
+  b->size       = 64;
+  b->len        = 0;
+  b->proxies    = malloc(sizeof(ex_entity_proxy_t) * b->size);
+  b->axis       = 0;
+  b->pairs_size = 64;
+  b->pairs_len  = 0;
+  b->pairs      = malloc(sizeof(ex_entity_pair_t) * b->pairs_size);
+  return b;
+}
+
+static inline void ex_entity_bounds(ex_entity_t *entity, ex_rect_t *r)
+{
+  vec3_sub(r->min, entity->position, entity->radius);
+  vec3_add(r->max, entity->position, entity->radius);
+}
 
-  int index = 0;
-  ex_octree_get_colliding(entity->scene->coll_tree, &r, data, &index);
+void ex_entity_broadphase_add(ex_entity_broadphase_t *b, ex_entity_t *entity)
+{
+  if (b->len >= b->size) {
+    b->size   *= 2;
+    b->proxies = realloc(b->proxies, sizeof(ex_entity_proxy_t) * b->size);
+  }
 
-  size_t tri;
-  vec3 *vertices = entity->scene->coll_vertices;
-  float dist = FLT_MAX;
-  vec3 intersect, nearest;
-  for (int i=0; i<count; i++) {
-    uint32_t *indices = (uint32_t*)data[i].data;
+  // the next update sorts it into place
+  b->proxies[b->len].entity = entity;
+  ex_entity_bounds(entity, &b->proxies[b->len].box);
+  b->len++;
+}
 
-    if (indices == NULL)
+void ex_entity_broadphase_remove(ex_entity_broadphase_t *b, ex_entity_t *entity)
+{
+  for (size_t i=0; i<b->len; i++) {
+    if (b->proxies[i].entity != entity)
       continue;
 
-    for (int k=0; k<data[i].len; k++) {
-      if (ray_in_tri(from, to, vertices[indices[k]+0], vertices[indices[k]+1], vertices[indices[k]+2], intersect)) {
-
-        vec3 len;
-        vec3_sub(len, from, intersect);
-        float d = vec3_len(len);
-        if (d < dist) {
-          memcpy(nearest, intersect, sizeof(vec3));
-          dist = d;
-          tri = indices[k];
-        }
-      }
+    // keep the rest sorted
+    memmove(&b->proxies[i], &b->proxies[i+1], sizeof(ex_entity_proxy_t) * (b->len - i - 1));
+    b->len--;
+    return;
+  }
+}
+
+static inline int ex_entity_proxy_cmp(const void *a, const void *b, int axis)
+{
+  float fa = ((ex_entity_proxy_t*)a)->box.min[axis];
+  float fb = ((ex_entity_proxy_t*)b)->box.min[axis];
+  return (fa > fb) - (fa < fb);
+}
+
+static int ex_entity_proxy_cmp_x(const void *a, const void *b) { return ex_entity_proxy_cmp(a, b, 0); }
+static int ex_entity_proxy_cmp_y(const void *a, const void *b) { return ex_entity_proxy_cmp(a, b, 1); }
+static int ex_entity_proxy_cmp_z(const void *a, const void *b) { return ex_entity_proxy_cmp(a, b, 2); }
+
+void ex_entity_broadphase_update(ex_entity_broadphase_t *b)
+{
+  b->pairs_len = 0;
+  if (b->len < 2)
+    return;
+
+  // refresh bounds, sweep along the axis
+  // the entities are most spread out on
+  vec3 sum = {0.0f}, sum2 = {0.0f};
+  for (size_t i=0; i<b->len; i++) {
+    ex_entity_t *entity = b->proxies[i].entity;
+    ex_entity_bounds(entity, &b->proxies[i].box);
+    for (int j=0; j<3; j++) {
+      sum[j]  += entity->position[j];
+      sum2[j] += entity->position[j] * entity->position[j];
     }
   }
 
-  if (dist < FLT_MAX && dist <= vec3_len(to)) {
-    ex_plane_t p = ex_triangle_to_plane(vertices[tri], vertices[tri+1], vertices[tri+2]);
-    memcpy(plane, &p, sizeof(ex_plane_t));
-    
-    free(data);
-    return dist;
+  int axis = 0;
+  float best = -1.0f;
+  for (int j=0; j<3; j++) {
+    float var = sum2[j] - sum[j]*sum[j] / b->len;
+    if (var > best) {
+      best = var;
+      axis = j;
+    }
   }
 
-  free(data);
-  return 0;
-}
\ No newline at end of file
+  if (axis != b->axis) {
+    // order along the old axis is no help
+    int (*cmp[3])(const void*, const void*) = {
+      ex_entity_proxy_cmp_x, ex_entity_proxy_cmp_y, ex_entity_proxy_cmp_z
+    };
+    qsort(b->proxies, b->len, sizeof(ex_entity_proxy_t), cmp[axis]);
+    b->axis = axis;
+  } else {
+    // nearly sorted from last time
+    for (size_t i=1; i<b->len; i++) {
+      ex_entity_proxy_t p = b->proxies[i];
+      size_t j = i;
+      for (; j>0 && b->proxies[j-1].box.min[axis] > p.box.min[axis]; j--)
+        b->proxies[j] = b->proxies[j-1];
+      b->proxies[j] = p;
+    }
+  }
+
+  // sweep, only boxes starting before this
+  // one ends can overlap it on the axis
+  int a1 = (axis + 1) % 3, a2 = (axis + 2) % 3;
+  for (size_t i=0; i<b->len; i++) {
+    ex_rect_t *r = &b->proxies[i].box;
+    for (size_t j=i+1; j<b->len && b->proxies[j].box.min[axis] <= r->max[axis]; j++) {
+      ex_rect_t *o = &b->proxies[j].box;
+      if (o->min[a1] > r->max[a1] || o->max[a1] < r->min[a1] ||
+          o->min[a2] > r->max[a2] || o->max[a2] < r->min[a2])
+        continue;
+
+      if (b->pairs_len >= b->pairs_size) {
+        b->pairs_size *= 2;
+        b->pairs = realloc(b->pairs, sizeof(ex_entity_pair_t) * b->pairs_size);
+      }
+      b->pairs[b->pairs_len].a = b->proxies[i].entity;
+      b->pairs[b->pairs_len].b = b->proxies[j].entity;
+      b->pairs_len++;
+    }
+  }
+}
+
+void ex_entity_broadphase_destroy(ex_entity_broadphase_t *b)
+{
+  free(b->proxies);
+  free(b->pairs);
+  free(b);
+}
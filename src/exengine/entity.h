@@ -21,13 +21,92 @@
 #include "octree.h"
 #include "scene.h"
 
+// at most this many substeps per update, each
+// moving no further than this much of the radius
+#define EX_ENTITY_MAX_SUBSTEPS 5
+#define EX_ENTITY_SUBSTEP_SCALE 0.5f
+
+// grounded entities slower than this go to
+// sleep after one update without moving
+#define EX_ENTITY_SLEEP_VELOCITY 0.05f
+
+/*
+  Entity updates are deterministic as long as
+  floats are evaluated at their own precision
+  and never fused or reordered, the SIMD sweep
+  and ex_entity_update_batch give the same bits
+  as the scalar path on one thread.  Build with
+  DETERMINISTIC=1 to enforce that for lockstep
+  and replays.
+*/
+#ifdef EX_DETERMINISTIC
+#include <float.h>
+#if FLT_EVAL_METHOD != 0
+#error "EX_DETERMINISTIC needs SSE2 float math, x87 keeps excess precision"
+#endif
+#ifdef __FAST_MATH__
+#error "EX_DETERMINISTIC can't be built with -ffast-math"
+#endif
+#endif
+
+/*
+  Work done by an entities sweeps since it was
+  made, zero it to start measuring.
+*/
+typedef struct {
+  uint64_t sweeps, tris, nodes;
+} ex_entity_stats_t;
+
 typedef struct {
   vec3 position, velocity, radius;
   ex_coll_packet_t packet;
   ex_scene_t *scene;
   int grounded;
+  ex_query_buffer_t query, dyn_query;
+
+  // sleeping entities skip their sweeps
+  int sleeping, resting;
+  vec3 rest_position;
+  float rest_speed;
+  uint32_t rest_version;
+
+  ex_entity_stats_t stats;
 } ex_entity_t;
 
+/*
+  Everything an update carries over to the
+  next, restoring it rewinds the entity.
+*/
+typedef struct {
+  vec3 position, velocity, rest_position;
+  float rest_speed;
+  uint32_t rest_version;
+  uint8_t grounded, sleeping, resting;
+} ex_entity_state_t;
+
+typedef struct {
+  ex_entity_t *a, *b;
+} ex_entity_pair_t;
+
+/*
+  Sweep and prune over entity bounds, the
+  boxes stay sorted along one axis between
+  updates so re-sorting after entities move
+  a little is close to linear.
+*/
+typedef struct {
+  ex_rect_t box;
+  ex_entity_t *entity;
+} ex_entity_proxy_t;
+
+typedef struct {
+  ex_entity_proxy_t *proxies;
+  size_t len, size;
+  int axis;
+  ex_entity_pair_t *pairs;
+  size_t pairs_len, pairs_size;
+} ex_entity_broadphase_t;
+
 /**
  * [ex_entity_new defines a new entity]
  * @param  scene  [the scene the entity will reside in]
@@ -36,6 +115,12 @@ typedef struct {
  */
 ex_entity_t* ex_entity_new(ex_scene_t *scene, vec3 radius);
 
+/**
+ * [ex_entity_destroy cleanup entity data]
+ * @param entity [the entity to destroy]
+ */
+void ex_entity_destroy(ex_entity_t *entity);
+
 /**
  * [ex_entity_collide_and_slide]
  * @param entity [entity to update]
@@ -51,7 +136,7 @@ void ex_entity_collide_and_slide(ex_entity_t *entity);
 void ex_entity_collide_with_world(ex_entity_t *entity, vec3 e_position, vec3 e_velocity);
 
 /**
- * [ex_entity_check_collision check collision against scene quadtree]
+ * [ex_entity_check_collision check collision against the scene trees]
  * @param entity [entity to check against]
  */
 void ex_entity_check_collision(ex_entity_t *entity);
@@ -66,7 +151,98 @@ void ex_entity_check_grounded(ex_entity_t *entity);
  * [ex_entity_update updates an entity, calling the above functions]
  * @param entity [entity to update]
  * @param dt     [delta time]
+ *
+ * Splits dt into up to EX_ENTITY_MAX_SUBSTEPS
+ * depending on how far the entity moves.  A
+ * grounded entity that came to rest sleeps,
+ * skipping the sweeps until anything speeds
+ * it up, it is moved, the static collision is
+ * rebuilt or a dynamic collider comes near it.
  */
 void ex_entity_update(ex_entity_t *entity, double dt);
 
+/**
+ * [ex_entity_update_batch ex_entity_update across the job pool]
+ * @param entities [the entities to update]
+ * @param count    [the entity count]
+ * @param dt       [delta time]
+ *
+ * Entities only read the scenes collision data,
+ * so they can be updated in parallel, giving the
+ * same results as updating them one by one.  The
+ * scene must not be changed until this returns.
+ */
+void ex_entity_update_batch(ex_entity_t **entities, size_t count, double dt);
+
+/**
+ * [ex_entity_snapshot save entity states]
+ * @param entities [the entities to save]
+ * @param count    [the entity count]
+ * @param out      [count states to fill]
+ *
+ * Padding is zeroed, so snapshots can be
+ * hashed or compared byte for byte.
+ */
+void ex_entity_snapshot(ex_entity_t **entities, size_t count, ex_entity_state_t *out);
+
+/**
+ * [ex_entity_restore load entity states]
+ * @param entities [the entities to rewind]
+ * @param count    [the entity count]
+ * @param in       [count states from ex_entity_snapshot]
+ *
+ * Updating with the same velocities and dt
+ * afterwards repeats the same ticks exactly,
+ * as long as the scene collision is the same.
+ */
+void ex_entity_restore(ex_entity_t **entities, size_t count, const ex_entity_state_t *in);
+
+/**
+ * [raycast nearest hit along a ray through the entities scene]
+ * @param  entity [the entity whos scene to use]
+ * @param  from   [the ray origin]
+ * @param  to     [the ray vector]
+ * @param  plane  [returned plane of the triangle hit]
+ * @return        [the distance to the hit, 0 if nothing was hit]
+ *
+ * A single ray ex_scene_raycast, use that
+ * directly to cast many rays at once.
+ */
+float raycast(ex_entity_t *entity, vec3 from, vec3 to, ex_plane_t *plane);
+
+/**
+ * [ex_entity_broadphase_new defines a new entity broadphase]
+ * @return [the new broadphase]
+ */
+ex_entity_broadphase_t* ex_entity_broadphase_new();
+
+/**
+ * [ex_entity_broadphase_add start tracking an entity]
+ * @param b      [the broadphase]
+ * @param entity [the entity to add]
+ */
+void ex_entity_broadphase_add(ex_entity_broadphase_t *b, ex_entity_t *entity);
+
+/**
+ * [ex_entity_broadphase_remove stop tracking an entity]
+ * @param b      [the broadphase]
+ * @param entity [the entity to remove]
+ */
+void ex_entity_broadphase_remove(ex_entity_broadphase_t *b, ex_entity_t *entity);
+
+/**
+ * [ex_entity_broadphase_update find overlapping entities]
+ * @param b [the broadphase]
+ *
+ * Call after moving entities, fills b->pairs
+ * with every pair whose ellipsoid bounds overlap.
+ */
+void ex_entity_broadphase_update(ex_entity_broadphase_t *b);
+
+/**
+ * [ex_entity_broadphase_destroy cleanup broadphase data]
+ * @param b [the broadphase to destroy]
+ */
+void ex_entity_broadphase_destroy(ex_entity_broadphase_t *b);
+
 #endif // EX_ENTITY_H
\ No newline at end of file
@@ -0,0 +1,181 @@
+#include "frustum.h"
+#include <math.h>
+#include <string.h>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define EX_FRUSTUM_WIDTH 8
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define EX_FRUSTUM_WIDTH 4
+#endif
+
+void ex_frustum_from_matrix(ex_frustum_t *f, mat4x4 m)
+{
+  // rows of the column major matrix added to or
+  // taken from the w row, gribb & hartmann
+  for (int i=0; i<3; i++) {
+    for (int j=0; j<4; j++) {
+      f->planes[i*2+0][j] = m[j][3] + m[j][i];
+      f->planes[i*2+1][j] = m[j][3] - m[j][i];
+    }
+  }
+
+  for (int i=0; i<EX_FRUSTUM_PLANES; i++) {
+    float *p = f->planes[i];
+    float len = sqrtf(p[0]*p[0] + p[1]*p[1] + p[2]*p[2]);
+    if (len > 0.0f) {
+      p[0] /= len;
+      p[1] /= len;
+      p[2] /= len;
+      p[3] /= len;
+    }
+  }
+}
+
+int ex_frustum_aabb(const ex_frustum_t *f, const vec3 center, const vec3 half)
+{
+  for (int i=0; i<EX_FRUSTUM_PLANES; i++) {
+    const float *p = f->planes[i];
+    float d = p[0]*center[0] + p[1]*center[1] + p[2]*center[2] + p[3];
+    float r = fabsf(p[0])*half[0] + fabsf(p[1])*half[1] + fabsf(p[2])*half[2];
+    if (d + r < 0.0f)
+      return 0;
+  }
+
+  return 1;
+}
+
+int ex_frustum_sphere(const ex_frustum_t *f, const vec3 center, float radius)
+{
+  for (int i=0; i<EX_FRUSTUM_PLANES; i++) {
+    const float *p = f->planes[i];
+    float d = p[0]*center[0] + p[1]*center[1] + p[2]*center[2] + p[3];
+    if (d + radius < 0.0f)
+      return 0;
+  }
+
+  return 1;
+}
+
+#ifdef EX_FRUSTUM_WIDTH
+#if EX_FRUSTUM_WIDTH == 8
+typedef __m256 ex_vf_t;
+
+static inline ex_vf_t ex_vf_set1(float f)             { return _mm256_set1_ps(f); }
+static inline ex_vf_t ex_vf_load(const float *p)      { return _mm256_loadu_ps(p); }
+static inline ex_vf_t ex_vf_add(ex_vf_t a, ex_vf_t b) { return _mm256_add_ps(a, b); }
+static inline ex_vf_t ex_vf_mul(ex_vf_t a, ex_vf_t b) { return _mm256_mul_ps(a, b); }
+static inline ex_vf_t ex_vf_or(ex_vf_t a, ex_vf_t b)  { return _mm256_or_ps(a, b); }
+static inline ex_vf_t ex_vf_lt(ex_vf_t a, ex_vf_t b)  { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+static inline int     ex_vf_mask(ex_vf_t m)           { return _mm256_movemask_ps(m); }
+#else
+typedef __m128 ex_vf_t;
+
+static inline ex_vf_t ex_vf_set1(float f)             { return _mm_set1_ps(f); }
+static inline ex_vf_t ex_vf_load(const float *p)      { return _mm_loadu_ps(p); }
+static inline ex_vf_t ex_vf_add(ex_vf_t a, ex_vf_t b) { return _mm_add_ps(a, b); }
+static inline ex_vf_t ex_vf_mul(ex_vf_t a, ex_vf_t b) { return _mm_mul_ps(a, b); }
+static inline ex_vf_t ex_vf_or(ex_vf_t a, ex_vf_t b)  { return _mm_or_ps(a, b); }
+static inline ex_vf_t ex_vf_lt(ex_vf_t a, ex_vf_t b)  { return _mm_cmplt_ps(a, b); }
+static inline int     ex_vf_mask(ex_vf_t m)           { return _mm_movemask_ps(m); }
+#endif
+
+// the lanes outside of any plane, same sums as the scalar tests
+static inline int ex_frustum_outside(const ex_frustum_t *f, ex_vf_t x, ex_vf_t y, ex_vf_t z, ex_vf_t hx, ex_vf_t hy, ex_vf_t hz)
+{
+  ex_vf_t zero = ex_vf_set1(0.0f);
+  ex_vf_t out  = ex_vf_lt(zero, zero);
+
+  for (int i=0; i<EX_FRUSTUM_PLANES; i++) {
+    const float *p = f->planes[i];
+    ex_vf_t d = ex_vf_add(ex_vf_add(ex_vf_add(ex_vf_mul(ex_vf_set1(p[0]), x), ex_vf_mul(ex_vf_set1(p[1]), y)), ex_vf_mul(ex_vf_set1(p[2]), z)), ex_vf_set1(p[3]));
+    ex_vf_t r = ex_vf_add(ex_vf_add(ex_vf_mul(ex_vf_set1(fabsf(p[0])), hx), ex_vf_mul(ex_vf_set1(fabsf(p[1])), hy)), ex_vf_mul(ex_vf_set1(fabsf(p[2])), hz));
+    out = ex_vf_or(out, ex_vf_lt(ex_vf_add(d, r), zero));
+  }
+
+  return ex_vf_mask(out);
+}
+
+static inline int ex_frustum_outside_spheres(const ex_frustum_t *f, ex_vf_t x, ex_vf_t y, ex_vf_t z, ex_vf_t radius)
+{
+  ex_vf_t zero = ex_vf_set1(0.0f);
+  ex_vf_t out  = ex_vf_lt(zero, zero);
+
+  for (int i=0; i<EX_FRUSTUM_PLANES; i++) {
+    const float *p = f->planes[i];
+    ex_vf_t d = ex_vf_add(ex_vf_add(ex_vf_add(ex_vf_mul(ex_vf_set1(p[0]), x), ex_vf_mul(ex_vf_set1(p[1]), y)), ex_vf_mul(ex_vf_set1(p[2]), z)), ex_vf_set1(p[3]));
+    out = ex_vf_or(out, ex_vf_lt(ex_vf_add(d, radius), zero));
+  }
+
+  return ex_vf_mask(out);
+}
+#endif
+
+size_t ex_frustum_cull_aabbs(const ex_frustum_t *f, float *const center[3], float *const half[3], size_t count, uint32_t *visible)
+{
+  size_t len = 0, i = 0;
+
+#ifdef EX_FRUSTUM_WIDTH
+  for (; i+EX_FRUSTUM_WIDTH<=count; i+=EX_FRUSTUM_WIDTH) {
+    int out = ex_frustum_outside(f,
+      ex_vf_load(&center[0][i]), ex_vf_load(&center[1][i]), ex_vf_load(&center[2][i]),
+      ex_vf_load(&half[0][i]), ex_vf_load(&half[1][i]), ex_vf_load(&half[2][i]));
+
+    for (int j=0; j<EX_FRUSTUM_WIDTH; j++)
+      if (!(out & (1 << j)))
+        visible[len++] = i + j;
+  }
+#endif
+
+  for (; i<count; i++) {
+    vec3 c = {center[0][i], center[1][i], center[2][i]};
+    vec3 h = {half[0][i], half[1][i], half[2][i]};
+    if (ex_frustum_aabb(f, c, h))
+      visible[len++] = i;
+  }
+
+  return len;
+}
+
+size_t ex_frustum_cull_spheres(const ex_frustum_t *f, float *const center[3], const float *radius, size_t count, uint32_t *visible)
+{
+  size_t len = 0, i = 0;
+
+#ifdef EX_FRUSTUM_WIDTH
+  for (; i+EX_FRUSTUM_WIDTH<=count; i+=EX_FRUSTUM_WIDTH) {
+    int out = ex_frustum_outside_spheres(f,
+      ex_vf_load(&center[0][i]), ex_vf_load(&center[1][i]), ex_vf_load(&center[2][i]),
+      ex_vf_load(&radius[i]));
+
+    for (int j=0; j<EX_FRUSTUM_WIDTH; j++)
+      if (!(out & (1 << j)))
+        visible[len++] = i + j;
+  }
+#endif
+
+  for (; i<count; i++) {
+    vec3 c = {center[0][i], center[1][i], center[2][i]};
+    if (ex_frustum_sphere(f, c, radius[i]))
+      visible[len++] = i;
+  }
+
+  return len;
+}
+
+void ex_aabb_transform(vec3 center_out, vec3 half_out, mat4x4 m, const vec3 center, const vec3 half)
+{
+  // arvo, the extents through the absolute rotation
+  vec3 c, h;
+  for (int i=0; i<3; i++) {
+    c[i] = m[3][i];
+    h[i] = 0.0f;
+    for (int j=0; j<3; j++) {
+      c[i] += m[j][i] * center[j];
+      h[i] += fabsf(m[j][i]) * half[j];
+    }
+  }
+
+  memcpy(center_out, c, sizeof(vec3));
+  memcpy(half_out,   h, sizeof(vec3));
+}
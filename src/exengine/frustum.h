@@ -0,0 +1,87 @@
+/* frustum
+  View frustum culling for boxes and spheres.
+
+  Bounds are passed as structure of arrays,
+  one array per component, so the batched
+  tests run 8 at a time with AVX, 4 with SSE.
+  Nothing here touches gl, it can be used and
+  tested without a window.
+
+  Tests are conservative, a box or sphere is
+  only culled when it is fully outside one of
+  the planes.
+*/
+
+#ifndef EX_FRUSTUM_H
+#define EX_FRUSTUM_H
+
+#include <stddef.h>
+#include <inttypes.h>
+#include "mathlib.h"
+
+// left, right, bottom, top, near, far
+#define EX_FRUSTUM_PLANES 6
+
+typedef struct {
+  // normals point inwards, xyz normalized
+  vec4 planes[EX_FRUSTUM_PLANES];
+} ex_frustum_t;
+
+/**
+ * [ex_frustum_from_matrix extract the planes of a view projection]
+ * @param f [the frustum to fill]
+ * @param m [projection * view, or just a projection for view space]
+ */
+void ex_frustum_from_matrix(ex_frustum_t *f, mat4x4 m);
+
+/**
+ * [ex_frustum_aabb test a single box]
+ * @param  f      [the frustum]
+ * @param  center [the box center]
+ * @param  half   [the box half extents]
+ * @return        [1 if the box might be visible]
+ */
+int ex_frustum_aabb(const ex_frustum_t *f, const vec3 center, const vec3 half);
+
+/**
+ * [ex_frustum_sphere test a single sphere]
+ * @param  f      [the frustum]
+ * @param  center [the sphere center]
+ * @param  radius [the sphere radius]
+ * @return        [1 if the sphere might be visible]
+ */
+int ex_frustum_sphere(const ex_frustum_t *f, const vec3 center, float radius);
+
+/**
+ * [ex_frustum_cull_aabbs find the visible boxes]
+ * @param  f       [the frustum]
+ * @param  center  [x, y and z center arrays]
+ * @param  half    [x, y and z half extent arrays]
+ * @param  count   [the box count]
+ * @param  visible [filled with the index of every visible box, in order]
+ * @return         [the number of visible boxes]
+ */
+size_t ex_frustum_cull_aabbs(const ex_frustum_t *f, float *const center[3], float *const half[3], size_t count, uint32_t *visible);
+
+/**
+ * [ex_frustum_cull_spheres find the visible spheres]
+ * @param  f       [the frustum]
+ * @param  center  [x, y and z center arrays]
+ * @param  radius  [the radius array]
+ * @param  count   [the sphere count]
+ * @param  visible [filled with the index of every visible sphere, in order]
+ * @return         [the number of visible spheres]
+ */
+size_t ex_frustum_cull_spheres(const ex_frustum_t *f, float *const center[3], const float *radius, size_t count, uint32_t *visible);
+
+/**
+ * [ex_aabb_transform world bounds of a transformed box]
+ * @param center_out [the new center]
+ * @param half_out   [the new half extents]
+ * @param m          [the transform]
+ * @param center     [the box center]
+ * @param half       [the box half extents]
+ */
+void ex_aabb_transform(vec3 center_out, vec3 half_out, mat4x4 m, const vec3 center, const vec3 half);
+
+#endif // EX_FRUSTUM_H
@@ -0,0 +1,99 @@
+#include "instancering.h"
+#include <stdlib.h>
+#include <string.h>
+
+// keeps every mat4x4 attribute offset aligned
+#define EX_INSTANCE_ALIGN 64
+
+ex_instance_ring_t *ex_instance_ring = NULL;
+
+ex_instance_ring_t* ex_instance_ring_new(size_t region_size)
+{
+  ex_instance_ring_t *r = calloc(1, sizeof(ex_instance_ring_t));
+  r->region_size = region_size;
+
+  glGenBuffers(1, &r->vbo);
+  glBindBuffer(GL_ARRAY_BUFFER, r->vbo);
+
+  size_t size = region_size * EX_INSTANCE_FRAMES;
+  if (GLEW_ARB_buffer_storage) {
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBufferStorage(GL_ARRAY_BUFFER, size, NULL, flags);
+    r->mapped = glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+  } else {
+    glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STREAM_DRAW);
+  }
+
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  return r;
+}
+
+void ex_instance_ring_begin(ex_instance_ring_t *r)
+{
+  r->frame    = (r->frame + 1) % EX_INSTANCE_FRAMES;
+  r->frames++;
+  r->offset   = 0;
+  r->uploaded = 0;
+  r->active   = 1;
+
+  GLsync fence = r->fences[r->frame];
+  if (fence == NULL)
+    return;
+
+  // only stalls when the gpu is frames behind
+  GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+  for (;;) {
+    GLenum status = glClientWaitSync(fence, flags, 1000000);
+    if (status != GL_TIMEOUT_EXPIRED)
+      break;
+    flags = 0;
+  }
+
+  glDeleteSync(fence);
+  r->fences[r->frame] = NULL;
+}
+
+int ex_instance_ring_write(ex_instance_ring_t *r, const void *data, size_t size, size_t *offset)
+{
+  size_t start = (r->offset + EX_INSTANCE_ALIGN - 1) & ~(size_t)(EX_INSTANCE_ALIGN - 1);
+  if (!r->active || start + size > r->region_size)
+    return 0;
+
+  *offset   = r->frame * r->region_size + start;
+  r->offset = start + size;
+  r->uploaded += size;
+
+  if (r->mapped != NULL) {
+    memcpy(r->mapped + *offset, data, size);
+  } else {
+    glBindBuffer(GL_ARRAY_BUFFER, r->vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, *offset, size, data);
+  }
+
+  return 1;
+}
+
+void ex_instance_ring_end(ex_instance_ring_t *r)
+{
+  if (!r->active)
+    return;
+
+  r->fences[r->frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  r->active = 0;
+}
+
+void ex_instance_ring_destroy(ex_instance_ring_t *r)
+{
+  for (int i=0; i<EX_INSTANCE_FRAMES; i++)
+    if (r->fences[i] != NULL)
+      glDeleteSync(r->fences[i]);
+
+  if (r->mapped != NULL) {
+    glBindBuffer(GL_ARRAY_BUFFER, r->vbo);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+  }
+
+  glDeleteBuffers(1, &r->vbo);
+  free(r);
+}
@@ -0,0 +1,88 @@
+/* instancering
+  Streams instance transforms for models
+  that move, without mapping a buffer per
+  model per frame.
+
+  One buffer is split into a region per
+  frame in flight.  Each frame writes into
+  the next region, after waiting on the
+  fence placed when that region was last
+  used, so the gpu is never written under.
+
+  With ARB_buffer_storage the buffer is
+  mapped once, persistent and coherent,
+  and writes are plain copies.  Otherwise
+  each write is a glBufferSubData into
+  the free region.
+*/
+
+#ifndef EX_INSTANCERING_H
+#define EX_INSTANCERING_H
+
+#include <stddef.h>
+#include <inttypes.h>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#define EX_INSTANCE_FRAMES 3
+
+// bytes per frame, 64k mat4x4
+#define EX_INSTANCE_REGION_SIZE (4*1024*1024)
+
+typedef struct {
+  GLuint vbo;
+  uint8_t *mapped; // NULL without persistent mapping
+  size_t region_size, offset;
+  int frame, active;
+  uint32_t frames; // counts every begin
+  GLsync fences[EX_INSTANCE_FRAMES];
+
+  // bytes written this frame
+  size_t uploaded;
+} ex_instance_ring_t;
+
+// the ring models stream into, set by the
+// scene while it draws, NULL otherwise
+extern ex_instance_ring_t *ex_instance_ring;
+
+/**
+ * [ex_instance_ring_new create the ring buffer]
+ * @param  region_size [bytes per frame]
+ * @return             [the new ring]
+ */
+ex_instance_ring_t* ex_instance_ring_new(size_t region_size);
+
+/**
+ * [ex_instance_ring_begin move to the next frames region]
+ * @param r [the ring]
+ *
+ * Blocks if the gpu still reads that region.
+ */
+void ex_instance_ring_begin(ex_instance_ring_t *r);
+
+/**
+ * [ex_instance_ring_write copy data into this frames region]
+ * @param  r      [the ring]
+ * @param  data   [the data to copy]
+ * @param  size   [bytes to copy]
+ * @param  offset [set to the byte offset in r->vbo]
+ * @return        [0 if outside a frame or the region is full]
+ */
+int ex_instance_ring_write(ex_instance_ring_t *r, const void *data, size_t size, size_t *offset);
+
+/**
+ * [ex_instance_ring_end fence this frames region]
+ * @param r [the ring]
+ *
+ * Call after the last draw using the region.
+ */
+void ex_instance_ring_end(ex_instance_ring_t *r);
+
+/**
+ * [ex_instance_ring_destroy cleanup the ring]
+ * @param r [the ring to destroy]
+ */
+void ex_instance_ring_destroy(ex_instance_ring_t *r);
+
+#endif // EX_INSTANCERING_H
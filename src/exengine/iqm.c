@@ -196,6 +196,18 @@ ex_model_t *ex_iqm_load_model(ex_scene_t *scene, const char *path, uint8_t flags
   model->vertices    = NULL;
   model->octree_data = NULL;
 
+  // local bounds for culling, animated models
+  // also cover the bounds of every frame
+  for (int i=0; i<header.num_vertexes; i++) {
+    vec3_min(model->bounds.min, model->bounds.min, vertices[i].position);
+    vec3_max(model->bounds.max, model->bounds.max, vertices[i].position);
+  }
+  ex_iqmbounds_t *frame_bounds = (ex_iqmbounds_t *)&data[header.ofs_bounds];
+  for (int i=0; header.ofs_bounds > 0 && i<header.num_frames; i++) {
+    vec3_min(model->bounds.min, model->bounds.min, frame_bounds[i].bbmin);
+    vec3_max(model->bounds.max, model->bounds.max, frame_bounds[i].bbmax);
+  }
+
   // calc inverse base pose
   model->inverse_base = NULL;
   model->skeleton     = NULL;
@@ -224,6 +236,15 @@ ex_model_t *ex_iqm_load_model(ex_scene_t *scene, const char *path, uint8_t flags
       ex_model_update_matrices(model);
   }
 
+  // sampled as simd tracks, shared with copies
+  if (model->inverse_base != NULL && frames != NULL) {
+    int parents[header.num_joints];
+    for (int i=0; i<header.num_joints; i++)
+      parents[i] = bones[i].parent;
+
+    model->animation = ex_animation_new(parents, header.num_joints, frames, header.num_frames, model->inverse_base);
+  }
+
   // backup vertices of visible meshes
   vec3 *vis_vertices = malloc(sizeof(vec3)*header.num_triangles*3);
   size_t vis_len = 0;
@@ -307,4 +328,52 @@ ex_model_t *ex_iqm_load_model(ex_scene_t *scene, const char *path, uint8_t flags
   // store the model in the cache and return an instance of it
   ex_cache_model(model);
   return ex_cache_get_model(path);
-}
\ No newline at end of file
+}
+
+size_t ex_iqm_load_collision(ex_scene_t *scene, const char *path)
+{
+  // read in the file data
+  uint8_t *data = (uint8_t*)io_read_file(path, "rb", NULL);
+  if (data == NULL) {
+    printf("Failed to load IQM collision file %s\n", path);
+    return 0;
+  }
+
+  // check magic string and version
+  ex_iqm_header_t header;
+  memcpy(&header, data, sizeof(ex_iqm_header_t));
+  header.magic[15] = '\0';
+  if (strcmp(header.magic, EX_IQM_MAGIC) != 0 || header.version != EX_IQM_VERSION) {
+    printf("Loaded IQM model version is not 2.0\nFailed loading %s\n", path);
+    free(data);
+    return 0;
+  }
+
+  float *position = NULL;
+  ex_iqmvertexarray_t *vas = (ex_iqmvertexarray_t *)&data[header.ofs_vertexarrays];
+  for (int i=0; i<header.num_vertexarrays; i++)
+    if (vas[i].type == IQM_POSITION && vas[i].format == IQM_FLOAT && vas[i].size == 3)
+      position = (float *)&data[vas[i].offset];
+
+  if (position == NULL) {
+    printf("No IQM vertex positions in %s\n", path);
+    free(data);
+    return 0;
+  }
+
+  // flip the winding like ex_iqm_load_model
+  size_t len = header.num_triangles*3;
+  uint *indices = (uint *)&data[header.ofs_triangles];
+  vec3 *vertices = malloc(sizeof(vec3)*len);
+  for (size_t i=0; i<len; i+=3) {
+    memcpy(vertices[i+0], &position[indices[i+2]*3], sizeof(vec3));
+    memcpy(vertices[i+1], &position[indices[i+1]*3], sizeof(vec3));
+    memcpy(vertices[i+2], &position[indices[i+0]*3], sizeof(vec3));
+  }
+
+  ex_scene_add_collision_vertices(scene, vertices, len);
+
+  free(vertices);
+  free(data);
+  return len;
+}
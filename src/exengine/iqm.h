@@ -124,6 +124,18 @@ typedef struct {
  */
 ex_model_t *ex_iqm_load_model(ex_scene_t *scene, const char *path, uint8_t flags);
 
+/**
+ * [ex_iqm_load_collision add a iqm files triangles to the coll tree]
+ * @param  scene [the scene to add them to]
+ * @param  path  [path to the model file]
+ * @return       [the vertex count added, 0 on failure]
+ *
+ * The same vertices EX_KEEP_VERTICES would give,
+ * without making any meshes or textures, so it
+ * works without a gl context.
+ */
+size_t ex_iqm_load_collision(ex_scene_t *scene, const char *path);
+
 static inline uint ex_get_uint(uint8_t *data) { 
   return (data[0] | (data[1] << 8) | (data[2] << 16) | (data[3] << 24));
 }
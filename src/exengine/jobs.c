@@ -0,0 +1,153 @@
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <pthread.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+#include "jobs.h"
+
+typedef struct {
+  pthread_t threads[EX_JOBS_MAX_THREADS];
+  int threads_len, quit, active, busy;
+  pthread_mutex_t lock;
+  pthread_cond_t wake, done;
+  uint32_t generation;
+
+  // current run
+  ex_job_func_t func;
+  void *data;
+  size_t count;
+  volatile size_t next;
+} ex_jobs_t;
+
+static ex_jobs_t ex_jobs;
+
+static int ex_jobs_cores()
+{
+#ifdef _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return (int)info.dwNumberOfProcessors;
+#else
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? (int)n : 1;
+#endif
+}
+
+static void ex_jobs_work()
+{
+  size_t i;
+  while ((i = __sync_fetch_and_add(&ex_jobs.next, 1)) < ex_jobs.count)
+    ex_jobs.func(ex_jobs.data, i);
+}
+
+static void* ex_jobs_worker(void *arg)
+{
+  uint32_t seen = 0;
+
+  pthread_mutex_lock(&ex_jobs.lock);
+  for (;;) {
+    while (!ex_jobs.quit && ex_jobs.generation == seen)
+      pthread_cond_wait(&ex_jobs.wake, &ex_jobs.lock);
+
+    if (ex_jobs.quit)
+      break;
+
+    seen = ex_jobs.generation;
+    pthread_mutex_unlock(&ex_jobs.lock);
+
+    ex_jobs_work();
+
+    pthread_mutex_lock(&ex_jobs.lock);
+    if (--ex_jobs.busy == 0)
+      pthread_cond_signal(&ex_jobs.done);
+  }
+  pthread_mutex_unlock(&ex_jobs.lock);
+
+  return NULL;
+}
+
+void ex_jobs_init(int threads)
+{
+  if (ex_jobs.threads_len)
+    ex_jobs_shutdown();
+
+  if (threads <= 0)
+    threads = ex_jobs_cores();
+  if (threads > EX_JOBS_MAX_THREADS)
+    threads = EX_JOBS_MAX_THREADS;
+
+  ex_jobs.quit       = 0;
+  ex_jobs.active     = 0;
+  ex_jobs.busy       = 0;
+  ex_jobs.generation = 0;
+  pthread_mutex_init(&ex_jobs.lock, NULL);
+  pthread_cond_init(&ex_jobs.wake, NULL);
+  pthread_cond_init(&ex_jobs.done, NULL);
+
+  // the calling thread counts as one
+  for (int i=0; i<threads-1; i++) {
+    if (pthread_create(&ex_jobs.threads[i], NULL, ex_jobs_worker, NULL)) {
+      printf("Failed creating job thread %i\n", i);
+      break;
+    }
+    ex_jobs.threads_len++;
+  }
+}
+
+int ex_jobs_threads()
+{
+  return ex_jobs.threads_len + 1;
+}
+
+void ex_jobs_run(ex_job_func_t func, void *data, size_t count)
+{
+  // no pool, nothing worth splitting, or
+  // called from inside a job
+  if (!ex_jobs.threads_len || count < 2 || ex_jobs.active) {
+    for (size_t i=0; i<count; i++)
+      func(data, i);
+    return;
+  }
+
+  pthread_mutex_lock(&ex_jobs.lock);
+  ex_jobs.func   = func;
+  ex_jobs.data   = data;
+  ex_jobs.count  = count;
+  ex_jobs.next   = 0;
+  ex_jobs.busy   = ex_jobs.threads_len;
+  ex_jobs.active = 1;
+  ex_jobs.generation++;
+  pthread_cond_broadcast(&ex_jobs.wake);
+  pthread_mutex_unlock(&ex_jobs.lock);
+
+  ex_jobs_work();
+
+  // wait for workers to finish their last item
+  pthread_mutex_lock(&ex_jobs.lock);
+  while (ex_jobs.busy)
+    pthread_cond_wait(&ex_jobs.done, &ex_jobs.lock);
+  ex_jobs.active = 0;
+  pthread_mutex_unlock(&ex_jobs.lock);
+}
+
+void ex_jobs_shutdown()
+{
+  if (!ex_jobs.threads_len)
+    return;
+
+  pthread_mutex_lock(&ex_jobs.lock);
+  ex_jobs.quit = 1;
+  pthread_cond_broadcast(&ex_jobs.wake);
+  pthread_mutex_unlock(&ex_jobs.lock);
+
+  for (int i=0; i<ex_jobs.threads_len; i++)
+    pthread_join(ex_jobs.threads[i], NULL);
+  ex_jobs.threads_len = 0;
+
+  pthread_cond_destroy(&ex_jobs.done);
+  pthread_cond_destroy(&ex_jobs.wake);
+  pthread_mutex_destroy(&ex_jobs.lock);
+}
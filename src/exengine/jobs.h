@@ -0,0 +1,52 @@
+/* jobs
+  A small worker thread pool for splitting
+  independent work across cpu cores.
+
+  Work is submitted as a parallel-for, a
+  function is called once per index in
+  [0, count), from whichever thread picks
+  it up first.  The calling thread helps
+  out and ex_jobs_run only returns once
+  every index has been processed.
+
+  Calls made from inside a running job,
+  or before ex_jobs_init, simply run on
+  the calling thread.
+*/
+
+#ifndef EX_JOBS_H
+#define EX_JOBS_H
+
+#include <inttypes.h>
+#include <stddef.h>
+
+#define EX_JOBS_MAX_THREADS 64
+
+typedef void (*ex_job_func_t)(void *data, size_t index);
+
+/**
+ * [ex_jobs_init starts the worker threads]
+ * @param threads [total threads including the caller, 0 to use every core]
+ */
+void ex_jobs_init(int threads);
+
+/**
+ * [ex_jobs_threads the number of threads work is split across]
+ * @return [1 when the pool isnt running]
+ */
+int ex_jobs_threads();
+
+/**
+ * [ex_jobs_run call func for every index, blocks until all are done]
+ * @param func  [called as func(data, index)]
+ * @param data  [user pointer passed to func]
+ * @param count [number of indices]
+ */
+void ex_jobs_run(ex_job_func_t func, void *data, size_t count);
+
+/**
+ * [ex_jobs_shutdown joins and frees the worker threads]
+ */
+void ex_jobs_shutdown();
+
+#endif // EX_JOBS_H
@@ -0,0 +1,399 @@
+#include <stdlib.h>
+#include <string.h>
+#include "looseoctree.h"
+
+#define EX_LOOSE_PENDING 1
+#define EX_LOOSE_FREED   2
+
+static uint32_t ex_loose_node_alloc(ex_loose_octree_t *t, uint32_t parent, uint8_t octant)
+{
+  uint32_t index;
+  if (t->free_nodes != EX_LOOSE_OCTREE_NONE) {
+    index = t->free_nodes;
+    t->free_nodes = t->nodes[index].parent;
+  } else {
+    if (t->nodes_len >= t->nodes_size) {
+      t->nodes_size *= 2;
+      t->nodes = realloc(t->nodes, sizeof(ex_loose_node_t) * t->nodes_size);
+    }
+    index = t->nodes_len++;
+  }
+
+  ex_loose_node_t *node = &t->nodes[index];
+  node->parent    = parent;
+  node->first_obj = EX_LOOSE_OCTREE_NONE;
+  node->total     = 0;
+  node->octant    = octant;
+  node->flags     = 0;
+  for (int i=0; i<8; i++)
+    node->children[i] = EX_LOOSE_OCTREE_NONE;
+
+  if (parent != EX_LOOSE_OCTREE_NONE) {
+    ex_loose_node_t *p = &t->nodes[parent];
+    node->half  = p->half * 0.5f;
+    node->depth = p->depth + 1;
+    for (int i=0; i<3; i++)
+      node->center[i] = p->center[i] + (octant & (1 << i) ? node->half : -node->half);
+    p->children[octant] = index;
+  }
+
+  return index;
+}
+
+static void ex_loose_node_free(ex_loose_octree_t *t, uint32_t index)
+{
+  ex_loose_node_t *node = &t->nodes[index];
+  for (int i=0; i<8; i++)
+    if (node->children[i] != EX_LOOSE_OCTREE_NONE)
+      ex_loose_node_free(t, node->children[i]);
+
+  node->flags  = EX_LOOSE_FREED;
+  node->parent = t->free_nodes;
+  t->free_nodes = index;
+}
+
+static inline int ex_loose_node_contains(ex_loose_node_t *node, vec3 p)
+{
+  for (int i=0; i<3; i++)
+    if (p[i] < node->center[i] - node->half || p[i] >= node->center[i] + node->half)
+      return 0;
+
+  return 1;
+}
+
+static inline float ex_loose_box_center(vec3 center, ex_rect_t *box)
+{
+  float extent = 0.0f;
+  for (int i=0; i<3; i++) {
+    center[i] = (box->min[i] + box->max[i]) * 0.5f;
+    extent    = MAX(extent, (box->max[i] - box->min[i]) * 0.5f);
+  }
+
+  return extent;
+}
+
+// the node a box belongs in, created on the way down
+static uint32_t ex_loose_octree_find(ex_loose_octree_t *t, ex_rect_t *box)
+{
+  vec3 center;
+  float extent = ex_loose_box_center(center, box);
+
+  uint32_t index = 0;
+  if (!ex_loose_node_contains(&t->nodes[0], center))
+    return index;
+
+  while (t->nodes[index].depth < EX_LOOSE_OCTREE_MAX_DEPTH) {
+    ex_loose_node_t *node = &t->nodes[index];
+    if (extent > node->half * 0.5f)
+      break;
+
+    uint8_t octant = (center[0] >= node->center[0])
+                   | (center[1] >= node->center[1]) << 1
+                   | (center[2] >= node->center[2]) << 2;
+
+    uint32_t child = node->children[octant];
+    if (child == EX_LOOSE_OCTREE_NONE)
+      child = ex_loose_node_alloc(t, index, octant);
+
+    index = child;
+  }
+
+  return index;
+}
+
+// whether find would still pick this node
+static int ex_loose_octree_fits(ex_loose_octree_t *t, uint32_t index, ex_rect_t *box)
+{
+  vec3 center;
+  float extent = ex_loose_box_center(center, box);
+  ex_loose_node_t *node = &t->nodes[index];
+
+  int deeper = node->depth < EX_LOOSE_OCTREE_MAX_DEPTH && extent <= node->half * 0.5f;
+  if (index == 0)
+    return !ex_loose_node_contains(node, center) || !deeper;
+
+  return ex_loose_node_contains(node, center) && extent <= node->half && !deeper;
+}
+
+static void ex_loose_octree_link(ex_loose_octree_t *t, uint32_t handle, uint32_t index)
+{
+  ex_loose_obj_t *obj = &t->objs[handle];
+  ex_loose_node_t *node = &t->nodes[index];
+  obj->node = index;
+  obj->prev = EX_LOOSE_OCTREE_NONE;
+  obj->next = node->first_obj;
+  if (obj->next != EX_LOOSE_OCTREE_NONE)
+    t->objs[obj->next].prev = handle;
+  node->first_obj = handle;
+
+  for (uint32_t i=index; i!=EX_LOOSE_OCTREE_NONE; i=t->nodes[i].parent)
+    t->nodes[i].total++;
+}
+
+static void ex_loose_octree_unlink(ex_loose_octree_t *t, uint32_t handle)
+{
+  ex_loose_obj_t *obj = &t->objs[handle];
+  if (obj->prev != EX_LOOSE_OCTREE_NONE)
+    t->objs[obj->prev].next = obj->next;
+  else
+    t->nodes[obj->node].first_obj = obj->next;
+  if (obj->next != EX_LOOSE_OCTREE_NONE)
+    t->objs[obj->next].prev = obj->prev;
+
+  for (uint32_t i=obj->node; i!=EX_LOOSE_OCTREE_NONE; i=t->nodes[i].parent) {
+    ex_loose_node_t *node = &t->nodes[i];
+    if (--node->total > 0 || i == 0 || node->flags & EX_LOOSE_PENDING)
+      continue;
+
+    // merged away on the next prune
+    if (t->pending_len >= t->pending_size) {
+      t->pending_size = t->pending_size ? t->pending_size * 2 : 64;
+      t->pending = realloc(t->pending, sizeof(uint32_t) * t->pending_size);
+    }
+    t->pending[t->pending_len++] = i;
+    node->flags |= EX_LOOSE_PENDING;
+  }
+}
+
+ex_loose_octree_t* ex_loose_octree_new(vec3 center, float half)
+{
+  ex_loose_octree_t *t = malloc(sizeof(ex_loose_octree_t));
+
+  t->nodes_size = 64;
+  t->nodes_len  = 0;
+  t->nodes      = malloc(sizeof(ex_loose_node_t) * t->nodes_size);
+  t->free_nodes = EX_LOOSE_OCTREE_NONE;
+
+  t->objs_size = 64;
+  t->objs_len  = 0;
+  t->objs      = malloc(sizeof(ex_loose_obj_t) * t->objs_size);
+  t->free_objs = EX_LOOSE_OCTREE_NONE;
+
+  t->pending      = NULL;
+  t->pending_len  = 0;
+  t->pending_size = 0;
+
+  uint32_t root = ex_loose_node_alloc(t, EX_LOOSE_OCTREE_NONE, 0);
+  memcpy(t->nodes[root].center, center, sizeof(vec3));
+  t->nodes[root].half  = half;
+  t->nodes[root].depth = 0;
+
+  return t;
+}
+
+uint32_t ex_loose_octree_insert(ex_loose_octree_t *t, ex_rect_t box, uint32_t data)
+{
+  uint32_t handle;
+  if (t->free_objs != EX_LOOSE_OCTREE_NONE) {
+    handle = t->free_objs;
+    t->free_objs = t->objs[handle].next;
+  } else {
+    if (t->objs_len >= t->objs_size) {
+      t->objs_size *= 2;
+      t->objs = realloc(t->objs, sizeof(ex_loose_obj_t) * t->objs_size);
+    }
+    handle = t->objs_len++;
+  }
+
+  t->objs[handle].box  = box;
+  t->objs[handle].data = data;
+  ex_loose_octree_link(t, handle, ex_loose_octree_find(t, &box));
+
+  return handle;
+}
+
+void ex_loose_octree_remove(ex_loose_octree_t *t, uint32_t handle)
+{
+  ex_loose_octree_unlink(t, handle);
+
+  t->objs[handle].node = EX_LOOSE_OCTREE_NONE;
+  t->objs[handle].next = t->free_objs;
+  t->free_objs = handle;
+}
+
+void ex_loose_octree_move(ex_loose_octree_t *t, uint32_t handle, ex_rect_t box)
+{
+  ex_loose_obj_t *obj = &t->objs[handle];
+  obj->box = box;
+
+  // still in the right cell, nothing to relink
+  if (ex_loose_octree_fits(t, obj->node, &box))
+    return;
+
+  ex_loose_octree_unlink(t, handle);
+  ex_loose_octree_link(t, handle, ex_loose_octree_find(t, &box));
+}
+
+void ex_loose_octree_set_data(ex_loose_octree_t *t, uint32_t handle, uint32_t data)
+{
+  t->objs[handle].data = data;
+}
+
+void ex_loose_octree_query(ex_loose_octree_t *t, ex_rect_t *bounds, ex_query_buffer_t *out)
+{
+  out->len   = 0;
+  out->nodes = 0;
+
+  // at most 7 pending siblings per level
+  uint32_t stack[8 * (EX_LOOSE_OCTREE_MAX_DEPTH + 1)];
+  size_t top = 0;
+  stack[top++] = 0;
+
+  while (top > 0) {
+    uint32_t index = stack[--top];
+    ex_loose_node_t *node = &t->nodes[index];
+    out->nodes++;
+    if (node->total == 0)
+      continue;
+
+    // the root also holds everything outside of it
+    if (index != 0) {
+      ex_rect_t loose;
+      for (int i=0; i<3; i++) {
+        loose.min[i] = node->center[i] - node->half * 2.0f;
+        loose.max[i] = node->center[i] + node->half * 2.0f;
+      }
+
+      if (!ex_aabb_aabb(loose, *bounds))
+        continue;
+    }
+
+    for (uint32_t i=node->first_obj; i!=EX_LOOSE_OCTREE_NONE; i=t->objs[i].next) {
+      if (ex_aabb_aabb(t->objs[i].box, *bounds)) {
+        ex_query_buffer_reserve(out, 1);
+        out->data[out->len++] = t->objs[i].data;
+      }
+    }
+
+    for (int i=7; i>=0; i--)
+      if (node->children[i] != EX_LOOSE_OCTREE_NONE)
+        stack[top++] = node->children[i];
+  }
+}
+
+// objects in one node near to far, picking the next nearest
+// each time, nodes hold few objects so this stays cheap
+static float ex_loose_node_raycast(ex_loose_octree_t *t, ex_loose_node_t *node, vec3 from, vec3 inv_dir, float max, ex_ray_func_t func, void *data)
+{
+  float last = -1.0f;
+  uint32_t last_obj = EX_LOOSE_OCTREE_NONE;
+  for (;;) {
+    uint32_t best = EX_LOOSE_OCTREE_NONE;
+    float best_near = 0.0f, near;
+    for (uint32_t i=node->first_obj; i!=EX_LOOSE_OCTREE_NONE; i=t->objs[i].next) {
+      if (!ex_ray_aabb(&t->objs[i].box, from, inv_dir, max, &near))
+        continue;
+
+      // ordered by distance then handle, skip visited ones
+      if (near < last || (near == last && i <= last_obj))
+        continue;
+
+      if (best == EX_LOOSE_OCTREE_NONE || near < best_near || (near == best_near && i < best)) {
+        best      = i;
+        best_near = near;
+      }
+    }
+
+    if (best == EX_LOOSE_OCTREE_NONE)
+      return max;
+
+    max      = func(data, &t->objs[best].data, 1, max);
+    last     = best_near;
+    last_obj = best;
+  }
+}
+
+void ex_loose_octree_raycast(ex_loose_octree_t *t, vec3 from, vec3 dir, float max, ex_ray_func_t func, void *data)
+{
+  vec3 inv_dir;
+  for (int i=0; i<3; i++)
+    inv_dir[i] = 1.0f / dir[i];
+
+  // at most 8 pending children per level
+  struct {
+    uint32_t index;
+    float near;
+  } stack[8 * (EX_LOOSE_OCTREE_MAX_DEPTH + 1)];
+  int top = 0;
+
+  // the root also holds everything outside of it
+  stack[top].index  = 0;
+  stack[top++].near = 0.0f;
+
+  while (top > 0) {
+    top--;
+    // something closer was hit since this was pushed
+    if (stack[top].near > max)
+      continue;
+
+    ex_loose_node_t *node = &t->nodes[stack[top].index];
+    if (node->total == 0)
+      continue;
+
+    if (node->first_obj != EX_LOOSE_OCTREE_NONE)
+      max = ex_loose_node_raycast(t, node, from, inv_dir, max, func, data);
+
+    // sort the hit children far to near, so
+    // the nearest is popped first
+    uint32_t children[8];
+    float nears[8], near;
+    int count = 0;
+    for (int i=0; i<8; i++) {
+      uint32_t child = node->children[i];
+      if (child == EX_LOOSE_OCTREE_NONE || t->nodes[child].total == 0)
+        continue;
+
+      ex_loose_node_t *c = &t->nodes[child];
+      ex_rect_t loose;
+      for (int j=0; j<3; j++) {
+        loose.min[j] = c->center[j] - c->half * 2.0f;
+        loose.max[j] = c->center[j] + c->half * 2.0f;
+      }
+      if (!ex_ray_aabb(&loose, from, inv_dir, max, &near))
+        continue;
+
+      int j = count++;
+      for (; j>0 && nears[j-1] < near; j--) {
+        children[j] = children[j-1];
+        nears[j]    = nears[j-1];
+      }
+      children[j] = child;
+      nears[j]    = near;
+    }
+
+    for (int i=0; i<count; i++) {
+      stack[top].index  = children[i];
+      stack[top++].near = nears[i];
+    }
+  }
+}
+
+void ex_loose_octree_prune(ex_loose_octree_t *t)
+{
+  for (size_t i=0; i<t->pending_len; i++) {
+    uint32_t index = t->pending[i];
+    ex_loose_node_t *node = &t->nodes[index];
+    if (node->flags & EX_LOOSE_FREED)
+      continue;
+
+    node->flags &= ~EX_LOOSE_PENDING;
+    if (node->total > 0)
+      continue;
+
+    t->nodes[node->parent].children[node->octant] = EX_LOOSE_OCTREE_NONE;
+    ex_loose_node_free(t, index);
+  }
+
+  t->pending_len = 0;
+}
+
+void ex_loose_octree_destroy(ex_loose_octree_t *t)
+{
+  if (t == NULL)
+    return;
+
+  free(t->nodes);
+  free(t->objs);
+  free(t->pending);
+  free(t);
+}
@@ -0,0 +1,137 @@
+/* looseoctree
+  A loose octree for dynamic objects that
+  get inserted, moved and removed often.
+
+  Each node's bounds are twice the size of
+  its cell, so an object always fits in the
+  node whose cell holds its center at the
+  depth matching its size.  Inserting is a
+  walk down from the root, moving an object
+  that stays in its cell is O(1).
+
+  Objects are addressed by the handle that
+  insert returns.  Nodes that empty out are
+  only merged away by ex_loose_octree_prune,
+  so nothing gets freed while queries run.
+
+  Objects outside the root cell simply
+  live in the root node.
+*/
+
+#ifndef EX_LOOSE_OCTREE_H
+#define EX_LOOSE_OCTREE_H
+
+#include <inttypes.h>
+#include "octree.h"
+
+#define EX_LOOSE_OCTREE_MAX_DEPTH 12
+#define EX_LOOSE_OCTREE_NONE 0xFFFFFFFF
+
+typedef struct {
+  vec3 center;
+  float half;
+  uint32_t parent, children[8];
+  uint32_t first_obj;  // objects stored here
+  uint32_t total;      // objects in this whole subtree
+  uint8_t depth, octant, flags;
+} ex_loose_node_t;
+
+typedef struct {
+  ex_rect_t box;
+  uint32_t data;
+  uint32_t node, prev, next;
+} ex_loose_obj_t;
+
+typedef struct {
+  ex_loose_node_t *nodes;
+  size_t nodes_len, nodes_size;
+  uint32_t free_nodes;
+
+  ex_loose_obj_t *objs;
+  size_t objs_len, objs_size;
+  uint32_t free_objs;
+
+  // emptied nodes waiting for ex_loose_octree_prune
+  uint32_t *pending;
+  size_t pending_len, pending_size;
+} ex_loose_octree_t;
+
+/**
+ * [ex_loose_octree_new creates a new loose octree]
+ * @param  center [the center of the root cell]
+ * @param  half   [half the width of the root cell]
+ * @return        [the new tree]
+ */
+ex_loose_octree_t* ex_loose_octree_new(vec3 center, float half);
+
+/**
+ * [ex_loose_octree_insert add an object to the tree]
+ * @param  t    [the tree]
+ * @param  box  [the object bounds]
+ * @param  data [returned by queries]
+ * @return      [the object handle]
+ */
+uint32_t ex_loose_octree_insert(ex_loose_octree_t *t, ex_rect_t box, uint32_t data);
+
+/**
+ * [ex_loose_octree_remove remove an object, its handle becomes invalid]
+ * @param t      [the tree]
+ * @param handle [the object handle]
+ */
+void ex_loose_octree_remove(ex_loose_octree_t *t, uint32_t handle);
+
+/**
+ * [ex_loose_octree_move update an objects bounds]
+ * @param t      [the tree]
+ * @param handle [the object handle, stays valid]
+ * @param box    [the new bounds]
+ */
+void ex_loose_octree_move(ex_loose_octree_t *t, uint32_t handle, ex_rect_t box);
+
+/**
+ * [ex_loose_octree_set_data change the data queries return for an object]
+ * @param t      [the tree]
+ * @param handle [the object handle]
+ * @param data   [the new data]
+ */
+void ex_loose_octree_set_data(ex_loose_octree_t *t, uint32_t handle, uint32_t data);
+
+/**
+ * [ex_loose_octree_query gather the data of all objects overlapping bounds]
+ * @param t      [the tree]
+ * @param bounds [the bounds to test]
+ * @param out    [reset, then filled with object data]
+ */
+void ex_loose_octree_query(ex_loose_octree_t *t, ex_rect_t *bounds, ex_query_buffer_t *out);
+
+/**
+ * [ex_loose_octree_raycast visit objects along a ray front to back]
+ * @param t    [the tree]
+ * @param from [the ray origin]
+ * @param dir  [the ray direction]
+ * @param max  [how far along dir to look]
+ * @param func [called with the data of each object the ray hits]
+ * @param data [passed to func]
+ *
+ * Nodes and the objects in them are visited
+ * near to far by where the ray enters their
+ * box.  func returns the new max, objects and
+ * nodes past it are skipped.
+ */
+void ex_loose_octree_raycast(ex_loose_octree_t *t, vec3 from, vec3 dir, float max, ex_ray_func_t func, void *data);
+
+/**
+ * [ex_loose_octree_prune merge away nodes that emptied out]
+ * @param t [the tree]
+ *
+ * Call once per update, not while querying.
+ */
+void ex_loose_octree_prune(ex_loose_octree_t *t);
+
+/**
+ * [ex_loose_octree_destroy cleanup tree data]
+ * @param t [the tree to destroy]
+ */
+void ex_loose_octree_destroy(ex_loose_octree_t *t);
+
+#endif // EX_LOOSE_OCTREE_H
@@ -244,6 +244,20 @@ static inline void mat4x4_mul(mat4x4 M, mat4x4 a, mat4x4 b)
   }
   mat4x4_dup(M, temp);
 }
+// mat4x4_mul for matrices whose last column is 0, 0, 0, 1
+static inline void mat4x4_mul_affine(mat4x4 M, mat4x4 a, mat4x4 b)
+{
+  mat4x4 temp;
+  int r, c;
+  for(c=0; c<3; ++c) {
+    for(r=0; r<4; ++r)
+      temp[c][r] = a[0][r] * b[c][0] + a[1][r] * b[c][1] + a[2][r] * b[c][2];
+    temp[c][3] += b[c][3];
+  }
+  temp[3][0] = temp[3][1] = temp[3][2] = 0.f;
+  temp[3][3] = 1.f;
+  mat4x4_dup(M, temp);
+}
 static inline void mat4x4_mul_vec4(vec4 r, mat4x4 M, vec4 v)
 {
   int i, j;
@@ -625,7 +639,7 @@ static inline void quat_slerp(quat q, quat a, quat b, float weight)
 
   quat_scale(a2, a2, cos(theta));
   quat_scale(c, c, sin(theta));
-  quat_add(q, a, c);
+  quat_add(q, a2, c);
 }
 
 #include <float.h>
@@ -145,10 +145,11 @@ void ex_mesh_draw(ex_mesh_t* m, GLuint shader_program, int count)
   // draw mesh
   glDrawElementsInstanced(GL_TRIANGLES, m->icount, GL_UNSIGNED_INT, 0, count);
 
-  // unbind buffers
+  // unbind buffers, the vao first or unbinding
+  // the ebo would detach it from the vao
   glBindTexture(GL_TEXTURE_2D, 0);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
   glBindVertexArray(0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
 void ex_mesh_destroy(ex_mesh_t* m)
@@ -1,6 +1,11 @@
 #include "model.h"
 #include "shader.h"
+#include "frustum.h"
+#include "instancering.h"
+#include "transform.h"
+#include "jobs.h"
 #include <string.h>
+#include <float.h>
 
 ex_model_t* ex_model_new()
 {
@@ -22,9 +27,30 @@ ex_model_t* ex_model_new()
   m->transforms = NULL;
   m->instance_count = 0;
   m->is_static = 0;
-
-  m->bones = NULL;
-  m->current_anim = NULL;
+  m->version = 0;
+  m->transform_dirty    = 1;
+  m->transforms_version = 0;
+  m->world_valid        = 0;
+  m->instance_buffer  = 0;
+  m->instance_offset  = 0;
+  m->instance_version = 0;
+  m->instance_frame   = 0;
+
+  m->bones        = NULL;
+  m->anims        = NULL;
+  m->frames       = NULL;
+  m->bind_pose    = NULL;
+  m->pose         = NULL;
+  m->inverse_base = NULL;
+  m->skeleton     = NULL;
+  m->animation    = NULL;
+  m->vertices     = NULL;
+  m->bones_len = m->anims_len = m->frames_len = 0;
+
+  for (int i=0; i<3; i++) {
+    m->bounds.min[i] =  FLT_MAX;
+    m->bounds.max[i] = -FLT_MAX;
+  }
 
   for (int i=0; i<EX_MODEL_MAX_MESHES; i++)
     m->meshes[i] = NULL;
@@ -38,6 +64,7 @@ ex_model_t* ex_model_copy(ex_model_t *model)
   ex_model_t *m = ex_model_new();
   
   m->shader = model->shader;
+  m->bounds = model->bounds;
 
   // copy meshes
   for (int i=0; i<EX_MODEL_MAX_MESHES; i++) {
@@ -45,12 +72,39 @@ ex_model_t* ex_model_copy(ex_model_t *model)
       ex_model_add_mesh(m, ex_mesh_copy(model->meshes[i]));
   }
 
+  ex_model_copy_animation(m, model);
+
   // init instancing matrix vbos etc 
   ex_model_init_instancing(m, 1);
   
   return m;
 }
 
+void ex_model_copy_animation(ex_model_t *m, ex_model_t *source)
+{
+  if (source->animation == NULL)
+    return;
+
+  // animation data is shared, the pose is per copy
+  m->animation = source->animation;
+  m->animation->users++;
+
+  m->anims        = source->anims;
+  m->frames       = source->frames;
+  m->bind_pose    = source->bind_pose;
+  m->inverse_base = source->inverse_base;
+  m->anims_len    = source->anims_len;
+  m->frames_len   = source->frames_len;
+  m->bones_len    = source->bones_len;
+
+  m->bones    = malloc(sizeof(ex_bone_t) * m->bones_len);
+  m->pose     = malloc(sizeof(ex_pose_t) * m->bones_len);
+  m->skeleton = malloc(sizeof(mat4x4) * m->bones_len);
+  memcpy(m->bones, source->bones, sizeof(ex_bone_t) * m->bones_len);
+  memcpy(m->pose, source->pose, sizeof(ex_pose_t) * m->bones_len);
+  memcpy(m->skeleton, source->skeleton, sizeof(mat4x4) * m->bones_len);
+}
+
 void ex_model_add_mesh(ex_model_t *m, ex_mesh_t *mesh)
 {
   for (int i=0; i<EX_MODEL_MAX_MESHES; i++) {
@@ -63,6 +117,34 @@ void ex_model_add_mesh(ex_model_t *m, ex_mesh_t *mesh)
   printf("Maximum mesh count exceeded for model %s!\n", m->path);
 }
 
+static void ex_model_point_instances(ex_model_t *m, GLuint buffer, size_t offset)
+{
+  if (m->instance_buffer == buffer && m->instance_offset == offset)
+    return;
+
+  m->instance_buffer = buffer;
+  m->instance_offset = offset;
+
+  for (int i=0; i<EX_MODEL_MAX_MESHES; i++) {
+    ex_mesh_t *mesh = m->meshes[i];
+
+    if (mesh == NULL)
+      continue;
+
+    glBindVertexArray(mesh->VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+
+    // one mat4x4 per instance, a vec4 per attribute
+    for (int j=0; j<4; j++) {
+      glEnableVertexAttribArray(7+j);
+      glVertexAttribPointer(7+j, 4, GL_FLOAT, GL_FALSE, sizeof(mat4x4), (GLvoid*)(offset + j * sizeof(vec4)));
+      glVertexAttribDivisor(7+j, 1);
+    }
+  }
+
+  glBindVertexArray(0);
+}
+
 void ex_model_init_instancing(ex_model_t *m, int count)
 {
   // cleanup old if it exists
@@ -83,43 +165,22 @@ void ex_model_init_instancing(ex_model_t *m, int count)
   glBindBuffer(GL_ARRAY_BUFFER, m->instance_vbo);
   glBufferData(GL_ARRAY_BUFFER, count * sizeof(mat4x4), &m->transforms[0], GL_DYNAMIC_DRAW);
 
-  for (int i=0; i<EX_MODEL_MAX_MESHES; i++) {
-    ex_mesh_t *mesh = m->meshes[i];
-
-    if (mesh == NULL)
-      continue;
-
-    glBindVertexArray(mesh->VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, m->instance_vbo);
-
-    glEnableVertexAttribArray(7);
-    glVertexAttribPointer(7, 4, GL_FLOAT, GL_FALSE, sizeof(mat4x4), (GLvoid*)0);
-    glVertexAttribDivisor(7, 1);
-    
-    glEnableVertexAttribArray(8);
-    glVertexAttribPointer(8, 4, GL_FLOAT, GL_FALSE, sizeof(mat4x4), (GLvoid*)(sizeof(vec4)));
-    glVertexAttribDivisor(8, 1);
-
-    glEnableVertexAttribArray(9);
-    glVertexAttribPointer(9, 4, GL_FLOAT, GL_FALSE, sizeof(mat4x4), (GLvoid*)(2 * sizeof(vec4)));
-    glVertexAttribDivisor(9, 1);
-
-    glEnableVertexAttribArray(10);
-    glVertexAttribPointer(10, 4, GL_FLOAT, GL_FALSE, sizeof(mat4x4), (GLvoid*)(3 * sizeof(vec4)));
-    glVertexAttribDivisor(10, 1);
-
-
-    glBindVertexArray(0);
-  }
+  // identity is already uploaded, rebuild the rest
+  m->transform_dirty  = 1;
+  m->instance_version = ++m->transforms_version;
+  m->instance_buffer  = 0;
+  m->world_valid      = 0;
+  ex_model_point_instances(m, m->instance_vbo, 0);
 }
 
-void ex_model_update(ex_model_t *m, float delta_time)
+// moves the clock on, 0 if there is nothing to pose
+static int ex_model_advance(ex_model_t *m, float delta_time, uint32_t *next, float *weight)
 {
   // handle animations
   ex_anim_t *anim = m->current_anim;
 
   if (anim == NULL)
-    return;
+    return 0;
   
   // get current frame
   uint32_t current_frame = m->current_time * anim->rate;
@@ -127,7 +188,7 @@ void ex_model_update(ex_model_t *m, float delta_time)
   float position = m->current_time * anim->rate;
   
   if (current_frame > len && !anim->loop)
-    return;
+    return 0;
 
   // increase frame time
   m->current_time += delta_time;
@@ -149,24 +210,365 @@ void ex_model_update(ex_model_t *m, float delta_time)
     next_frame = anim->first;
   }
 
+  *next   = next_frame;
+  *weight = position - (float)floor(position);
+  return 1;
+}
+
+static void ex_model_set_matrices(ex_model_t *m, mat4x4 *skeleton, mat4x4 *world)
+{
+  if (m->skeleton != skeleton)
+    memcpy(m->skeleton, skeleton, sizeof(mat4x4) * m->bones_len);
+  for (int i=0; i<m->bones_len; i++)
+    mat4x4_dup(m->bones[i].transform, world[i]);
+}
+
+void ex_model_update(ex_model_t *m, float delta_time)
+{
+  uint32_t next_frame;
+  float weight;
+  if (!ex_model_advance(m, delta_time, &next_frame, &weight))
+    return;
+
   // update skeleton matrices
-  ex_mix_pose(m, m->frames[m->current_frame], m->frames[next_frame], position - (float)floor(position));
+  if (m->animation != NULL) {
+    // likely built already by another instance
+    ex_pose_key_t key = ex_animation_key(m->animation, m->current_frame, next_frame, weight);
+    const ex_pose_cache_entry_t *p = ex_animation_sample(m->animation, key);
+    ex_model_set_matrices(m, p->skeleton, p->world);
+  } else {
+    ex_mix_pose(m, m->frames[m->current_frame], m->frames[next_frame], weight);
+    ex_model_update_matrices(m);
+  }
 
-  ex_model_update_matrices(m);
+  m->version++;
 }
 
-void ex_model_draw(ex_model_t *m, GLuint shader)
+typedef struct {
+  ex_model_t **models;
+
+  // per model
+  ex_pose_key_t *keys;
+  uint32_t *next_frames;
+  float *weights;
+
+  // leaders build a pose, followers copy their leaders
+  uint32_t *leaders, *followers, *follows;
+  size_t leaders_len, followers_len;
+} ex_model_anim_batch_t;
+
+static void ex_model_pose_job(void *data, size_t index)
+{
+  ex_model_anim_batch_t *b = data;
+  size_t first = index * EX_MODEL_ANIM_JOB_SIZE;
+  size_t last  = MIN(first + EX_MODEL_ANIM_JOB_SIZE, b->leaders_len);
+  for (size_t i=first; i<last; i++) {
+    uint32_t j = b->leaders[i];
+    ex_model_t *m = b->models[j];
+
+    if (m->animation != NULL) {
+      mat4x4 world[m->bones_len];
+      ex_animation_evaluate(m->animation, b->keys[j], m->skeleton, world);
+      ex_model_set_matrices(m, m->skeleton, world);
+    } else {
+      ex_mix_pose(m, m->frames[m->current_frame], m->frames[b->next_frames[j]], b->weights[j]);
+      ex_model_update_matrices(m);
+    }
+
+    m->version++;
+  }
+}
+
+static void ex_model_share_job(void *data, size_t index)
+{
+  ex_model_anim_batch_t *b = data;
+  size_t first = index * EX_MODEL_ANIM_JOB_SIZE;
+  size_t last  = MIN(first + EX_MODEL_ANIM_JOB_SIZE, b->followers_len);
+  for (size_t i=first; i<last; i++) {
+    ex_model_t *m      = b->models[b->followers[i]];
+    ex_model_t *leader = b->models[b->follows[i]];
+
+    memcpy(m->skeleton, leader->skeleton, sizeof(mat4x4) * m->bones_len);
+    for (int j=0; j<m->bones_len; j++)
+      mat4x4_dup(m->bones[j].transform, leader->bones[j].transform);
+
+    m->version++;
+  }
+}
+
+static inline uint32_t ex_model_pose_hash(ex_animation_t *a, ex_pose_key_t key)
+{
+  uint64_t h = (uint64_t)(uintptr_t)a;
+  h = (h ^ key.frame_a) * 0x9E3779B97F4A7C15ull;
+  h = (h ^ key.frame_b) * 0x9E3779B97F4A7C15ull;
+  h = (h ^ key.step)    * 0x9E3779B97F4A7C15ull;
+  return (uint32_t)(h >> 32);
+}
+
+static void ex_model_anim_scratch_grow(ex_model_anim_scratch_t *s, size_t count)
+{
+  if (count > s->cap) {
+    size_t cap = MAX(count, s->cap * 2);
+    s->keys        = realloc(s->keys, sizeof(ex_pose_key_t) * cap);
+    s->next_frames = realloc(s->next_frames, sizeof(uint32_t) * cap);
+    s->weights     = realloc(s->weights, sizeof(float) * cap);
+    s->leaders     = realloc(s->leaders, sizeof(uint32_t) * cap);
+    s->followers   = realloc(s->followers, sizeof(uint32_t) * cap);
+    s->follows     = realloc(s->follows, sizeof(uint32_t) * cap);
+    s->cap = cap;
+  }
+
+  size_t table_len = 16;
+  while (table_len < count * 2)
+    table_len *= 2;
+  if (table_len > s->table_len) {
+    s->table = realloc(s->table, sizeof(uint32_t) * table_len);
+    s->table_len = table_len;
+  }
+}
+
+void ex_model_update_batch(ex_model_anim_scratch_t *scratch, ex_model_t **models, size_t count, float delta_time)
+{
+  ex_model_anim_scratch_grow(scratch, count);
+
+  // a bigger table than needed only costs the clear
+  size_t table_len = scratch->table_len;
+  uint32_t *table  = scratch->table;
+  memset(table, 0, sizeof(uint32_t) * table_len);
+
+  ex_model_anim_batch_t b;
+  b.models      = models;
+  b.keys        = scratch->keys;
+  b.next_frames = scratch->next_frames;
+  b.weights     = scratch->weights;
+  b.leaders     = scratch->leaders;
+  b.followers   = scratch->followers;
+  b.follows     = scratch->follows;
+  b.leaders_len = b.followers_len = 0;
+
+  // clocks and grouping in order, so the same
+  // models lead no matter the thread count
+  for (size_t i=0; i<count; i++) {
+    ex_model_t *m = models[i];
+    if (m == NULL || !ex_model_advance(m, delta_time, &b.next_frames[i], &b.weights[i]))
+      continue;
+
+    if (m->animation == NULL) {
+      b.leaders[b.leaders_len++] = i;
+      continue;
+    }
+
+    ex_pose_key_t key = ex_animation_key(m->animation, m->current_frame, b.next_frames[i], b.weights[i]);
+    b.keys[i] = key;
+
+    size_t slot = ex_model_pose_hash(m->animation, key) & (table_len - 1);
+    for (;; slot = (slot + 1) & (table_len - 1)) {
+      if (table[slot] == 0) {
+        table[slot] = i + 1;
+        b.leaders[b.leaders_len++] = i;
+        break;
+      }
+
+      uint32_t j = table[slot] - 1;
+      ex_pose_key_t other = b.keys[j];
+      if (models[j]->animation == m->animation && other.frame_a == key.frame_a && other.frame_b == key.frame_b && other.step == key.step) {
+        b.followers[b.followers_len] = i;
+        b.follows[b.followers_len++] = j;
+        break;
+      }
+    }
+  }
+
+  ex_jobs_run(ex_model_pose_job, &b, (b.leaders_len + EX_MODEL_ANIM_JOB_SIZE - 1) / EX_MODEL_ANIM_JOB_SIZE);
+  ex_jobs_run(ex_model_share_job, &b, (b.followers_len + EX_MODEL_ANIM_JOB_SIZE - 1) / EX_MODEL_ANIM_JOB_SIZE);
+}
+
+void ex_model_anim_scratch_destroy(ex_model_anim_scratch_t *s)
+{
+  free(s->keys);
+  free(s->next_frames);
+  free(s->weights);
+  free(s->leaders);
+  free(s->followers);
+  free(s->follows);
+  free(s->table);
+  memset(s, 0, sizeof(ex_model_anim_scratch_t));
+}
+
+void ex_model_mark_transforms_dirty(ex_model_t *m)
+{
+  m->transforms_version++;
+  m->version++;
+}
+
+static inline int ex_model_composed(ex_model_t *m)
+{
+  return !m->use_transform && m->instance_count < 2 && m->transforms != NULL;
+}
+
+static inline int ex_model_transform_dirty(ex_model_t *m)
+{
+  return m->transform_dirty
+    || memcmp(m->built_position, m->position, sizeof(vec3))
+    || memcmp(m->built_rotation, m->rotation, sizeof(vec3))
+    || memcmp(&m->built_scale, &m->scale, sizeof(float));
+}
+
+static void ex_model_transform_built(ex_model_t *m)
+{
+  memcpy(m->built_position, m->position, sizeof(vec3));
+  memcpy(m->built_rotation, m->rotation, sizeof(vec3));
+  m->built_scale     = m->scale;
+  m->transform_dirty = 0;
+  ex_model_mark_transforms_dirty(m);
+}
+
+static void ex_model_update_transform(ex_model_t *m)
+{
+  // set by hand ones are marked by the caller
+  if (!ex_model_composed(m))
+    return;
+
+  // usually done by the batched pass already
+  if (ex_model_transform_dirty(m)) {
+    ex_transform_compose(m->transforms[0], m->position, m->rotation, m->scale);
+    ex_model_transform_built(m);
+  }
+}
+
+// batch size of the SoA gather
+#define EX_MODEL_TRANSFORM_BATCH 256
+
+void ex_model_update_transforms(ex_model_t **models, size_t count)
+{
+  float position[3][EX_MODEL_TRANSFORM_BATCH], rotation[3][EX_MODEL_TRANSFORM_BATCH];
+  float scale[EX_MODEL_TRANSFORM_BATCH];
+  mat4x4 *out[EX_MODEL_TRANSFORM_BATCH];
+  ex_model_t *dirty[EX_MODEL_TRANSFORM_BATCH];
+  float *p[3] = {position[0], position[1], position[2]};
+  float *r[3] = {rotation[0], rotation[1], rotation[2]};
+
+  size_t len = 0;
+  for (size_t i=0; i<count; i++) {
+    ex_model_t *m = models[i];
+    if (m == NULL || !ex_model_composed(m) || !ex_model_transform_dirty(m))
+      continue;
+
+    for (int j=0; j<3; j++) {
+      position[j][len] = m->position[j];
+      rotation[j][len] = m->rotation[j];
+    }
+    scale[len] = m->scale;
+    out[len]   = &m->transforms[0];
+    dirty[len++] = m;
+
+    if (len == EX_MODEL_TRANSFORM_BATCH) {
+      ex_transform_compose_batch(p, r, scale, out, len);
+      for (size_t j=0; j<len; j++)
+        ex_model_transform_built(dirty[j]);
+      len = 0;
+    }
+  }
+
+  if (len) {
+    ex_transform_compose_batch(p, r, scale, out, len);
+    for (size_t j=0; j<len; j++)
+      ex_model_transform_built(dirty[j]);
+  }
+}
+
+void ex_model_world_bounds(ex_model_t *m, vec3 center, vec3 half)
+{
+  ex_model_update_transform(m);
+
+  // never cull what we know nothing about
+  if (m->bounds.min[0] > m->bounds.max[0] || m->transforms == NULL || !m->instance_count) {
+    memset(center, 0, sizeof(vec3));
+    half[0] = half[1] = half[2] = FLT_MAX;
+    return;
+  }
+
+  if (m->world_valid && m->world_version == m->transforms_version) {
+    memcpy(center, m->world_center, sizeof(vec3));
+    memcpy(half, m->world_half, sizeof(vec3));
+    return;
+  }
+
+  vec3 local_center, local_half;
+  vec3_add(local_center, m->bounds.min, m->bounds.max);
+  vec3_scale(local_center, local_center, 0.5f);
+  vec3_sub(local_half, m->bounds.max, m->bounds.min);
+  vec3_scale(local_half, local_half, 0.5f);
+
+  ex_rect_t world;
+  for (size_t i=0; i<m->instance_count; i++) {
+    vec3 c, h;
+    ex_aabb_transform(c, h, m->transforms[i], local_center, local_half);
+
+    vec3 min, max;
+    vec3_sub(min, c, h);
+    vec3_add(max, c, h);
+    if (i == 0) {
+      memcpy(world.min, min, sizeof(vec3));
+      memcpy(world.max, max, sizeof(vec3));
+    } else {
+      vec3_min(world.min, world.min, min);
+      vec3_max(world.max, world.max, max);
+    }
+  }
+
+  vec3_add(center, world.min, world.max);
+  vec3_scale(center, center, 0.5f);
+  vec3_sub(half, world.max, world.min);
+  vec3_scale(half, half, 0.5f);
+
+  memcpy(m->world_center, center, sizeof(vec3));
+  memcpy(m->world_half, half, sizeof(vec3));
+  m->world_version = m->transforms_version;
+  m->world_valid   = 1;
+}
+
+void ex_model_upload(ex_model_t *m)
 {
   // handle transformations
-  if (!m->use_transform && m->instance_count < 2) {
-    mat4x4_identity(m->transforms[0]);
-    mat4x4_translate_in_place(m->transforms[0], m->position[0], m->position[1], m->position[2]);
-    mat4x4_rotate_Y(m->transforms[0], m->transforms[0], rad(m->rotation[1]));
-    mat4x4_rotate_X(m->transforms[0], m->transforms[0], rad(m->rotation[0]));
-    mat4x4_rotate_Z(m->transforms[0], m->transforms[0], rad(m->rotation[2]));
-    mat4x4_scale_aniso(m->transforms[0], m->transforms[0], m->scale, m->scale, m->scale);
+  ex_model_update_transform(m);
+
+  if (m->transforms == NULL || m->is_static == 2)
+    return;
+
+  size_t size = m->instance_count * sizeof(mat4x4);
+  int changed = m->instance_version != m->transforms_version;
+  m->instance_version = m->transforms_version;
+
+  // already in this frames ring region
+  ex_instance_ring_t *r = ex_instance_ring;
+  if (!changed && r != NULL && m->instance_buffer == r->vbo && m->instance_frame == r->frames)
+    return;
+
+  // moving, stream it through the ring
+  size_t offset;
+  if (changed && !m->is_static && r != NULL && ex_instance_ring_write(r, m->transforms, size, &offset)) {
+    m->instance_frame = r->frames;
+    ex_model_point_instances(m, r->vbo, offset);
+    return;
+  }
+
+  // settled, static or no room, keep it in the models own
+  // vbo so the ring region can be reused
+  if (changed || m->instance_buffer != m->instance_vbo) {
+    glBindBuffer(GL_ARRAY_BUFFER, m->instance_vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, size, &m->transforms[0]);
+    ex_model_point_instances(m, m->instance_vbo, 0);
   }
 
+  if (m->is_static)
+    m->is_static = 2;
+}
+
+void ex_model_draw(ex_model_t *m, GLuint shader)
+{
+  ex_model_upload(m);
+
   // pass bone data
   GLuint has_skeleton_loc = ex_uniform(shader, "u_has_skeleton");
   glUniform1i(has_skeleton_loc, 0);
@@ -176,17 +578,6 @@ void ex_model_draw(ex_model_t *m, GLuint shader)
     glUniformMatrix4fv(ex_uniform(shader, "u_bone_matrix"), m->bones_len, GL_TRUE, &m->skeleton[0][0][0]);
   }
 
-  // update instancing matrix vbo
-  if (!m->is_static || m->is_static == 1) {
-    glBindBuffer(GL_ARRAY_BUFFER, m->instance_vbo);
-    GLvoid *ptr = glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
-    memcpy(ptr, &m->transforms[0], m->instance_count * sizeof(mat4x4));
-    glUnmapBuffer(GL_ARRAY_BUFFER);
-    
-    if (m->is_static)
-      m->is_static = 2;
-  }
-
   // render meshes
   for (int i=0; i<EX_MODEL_MAX_MESHES; i++) {
     if (m->meshes[i] == NULL)
@@ -206,28 +597,30 @@ void ex_model_destroy(ex_model_t *m)
     }
   }
 
-  // clean up anim data
-  if (m->bones != NULL)
-    free(m->bones);
+  // clean up anim data, the last copy frees the shared part
+  if (m->animation == NULL || ex_animation_release(m->animation)) {
+    if (m->anims != NULL)
+      free(m->anims);
 
-  if (m->anims != NULL)
-    free(m->anims);
+    if (m->bind_pose != NULL)
+      free(m->bind_pose);
 
-  if (m->bind_pose != NULL)
-    free(m->bind_pose);
+    if (m->frames != NULL) {
+      for (int i=0; i<m->frames_len; i++)
+        free(m->frames[i]);
 
-  if (m->pose != NULL)
-    free(m->pose);
+      free(m->frames);
+    }
 
-  if (m->frames != NULL) {
-    for (int i=0; i<m->frames_len; i++)
-      free(m->frames[i]);
-    
-    free(m->frames);
+    if (m->inverse_base != NULL)
+      free(m->inverse_base);
   }
 
-  if (m->inverse_base != NULL)
-    free(m->inverse_base);
+  if (m->bones != NULL)
+    free(m->bones);
+
+  if (m->pose != NULL)
+    free(m->pose);
 
   if (m->skeleton != NULL)
     free(m->skeleton);
@@ -249,15 +642,13 @@ void ex_model_update_matrices(ex_model_t *m)
 
     mat4x4 mat, result;
     ex_calc_bone_matrix(mat, pose[i].translate, pose[i].rotate, pose[i].scale);
-    mat4x4_identity(result);
 
-    if (b.parent >= 0) {
-      mat4x4_mul(transform[i], mat, transform[b.parent]);
-      mat4x4_mul(result, m->inverse_base[i], transform[i]);
-    } else {
+    if (b.parent >= 0)
+      mat4x4_mul_affine(transform[i], mat, transform[b.parent]);
+    else
       mat4x4_dup(transform[i], mat);
-      mat4x4_mul(result, m->inverse_base[i], mat);
-    }
+
+    mat4x4_mul_affine(result, m->inverse_base[i], transform[i]);
 
     mat4x4_dup(m->bones[i].transform, transform[i]);
     mat4x4_dup(m->skeleton[i], result);
@@ -335,18 +726,26 @@ void ex_model_get_ex_bone_transform(ex_model_t *m, const char *name, mat4x4 tran
 
 void ex_calc_bone_matrix(mat4x4 m, vec3 pos, quat rot, vec3 scale)
 {
-  mat4x4 mat;
-
-  mat4x4_identity(m);
-
-  mat4x4_scale_xyz(mat, scale);
-  mat4x4_mul(m, m, mat);
-
-  mat4x4_rotate_quat(mat, rot);
-  mat4x4_mul(m, m, mat);
-
-  mat4x4_translate(mat, pos);
-  mat4x4_mul(m, m, mat);
+  // scale * rotate * translate, written out
+  float x = rot[0], y = rot[1], z = rot[2], w = rot[3];
+
+  m[0][0] = (1.0f - 2.0f * (y*y + z*z)) * scale[0];
+  m[0][1] = 2.0f * (x*y - w*z) * scale[1];
+  m[0][2] = 2.0f * (x*z + w*y) * scale[2];
+  m[0][3] = pos[0];
+
+  m[1][0] = 2.0f * (x*y + w*z) * scale[0];
+  m[1][1] = (1.0f - 2.0f * (x*x + z*z)) * scale[1];
+  m[1][2] = 2.0f * (y*z - w*x) * scale[2];
+  m[1][3] = pos[1];
+
+  m[2][0] = 2.0f * (x*z - w*y) * scale[0];
+  m[2][1] = 2.0f * (y*z + w*x) * scale[1];
+  m[2][2] = (1.0f - 2.0f * (x*x + y*y)) * scale[2];
+  m[2][3] = pos[2];
+
+  m[3][0] = m[3][1] = m[3][2] = 0.0f;
+  m[3][3] = 1.0f;
 }
 
 void ex_mix_pose(ex_model_t *m, ex_frame_t a, ex_frame_t b, float weight)
@@ -356,8 +755,14 @@ void ex_mix_pose(ex_model_t *m, ex_frame_t a, ex_frame_t b, float weight)
     vec3 t;
     vec3_lerp(t, a[i].translate, b[i].translate, weight);
 
-    quat r;
-    quat_slerp(r, a[i].rotate, b[i].rotate, weight);
+    // nlerp unless the bone turns far
+    quat r, rb;
+    float dot = quat_inner_product(a[i].rotate, b[i].rotate);
+    quat_scale(rb, b[i].rotate, dot < 0.0f ? -1.0f : 1.0f);
+    if (fabsf(dot) >= EX_ANIM_NLERP_DOT)
+      quat_lerp(r, a[i].rotate, rb, weight);
+    else
+      quat_slerp(r, a[i].rotate, b[i].rotate, weight);
     quat_norm(r, r);
 
     vec3 s;
@@ -16,9 +16,13 @@
 #include "exe_list.h"
 #include "octree.h"
 #include "mesh.h"
+#include "animation.h"
 
 #define EX_MODEL_MAX_MESHES 128
 
+// models posed per job by ex_model_update_batch
+#define EX_MODEL_ANIM_JOB_SIZE 4
+
 typedef struct {
   char name[64];
   int parent;
@@ -34,13 +38,6 @@ typedef struct {
   uint8_t loop;
 } ex_anim_t;
 
-typedef struct {
-  vec3 translate, scale;
-  quat rotate;
-} ex_pose_t;
-
-typedef ex_pose_t* ex_frame_t;
-
 typedef struct {
   ex_mesh_t *meshes[EX_MODEL_MAX_MESHES];
 
@@ -59,9 +56,33 @@ typedef struct {
   size_t bones_len, anims_len, frames_len;
   int use_transform;
 
+  // sampled tracks, shared between copies
+  ex_animation_t *animation;
+
   vec3 *vertices;
   size_t num_vertices;
 
+  // local space, min > max when unknown
+  ex_rect_t bounds;
+
+  // bumped when the pose or transforms change
+  uint32_t version;
+
+  // transforms[0] is rebuilt from position, rotation
+  // and scale when they differ from these, or when
+  // transform_dirty is set.  transforms_version bumps
+  // on any change, by hand set transforms have to be
+  // marked with ex_model_mark_transforms_dirty
+  vec3 built_position, built_rotation;
+  float built_scale;
+  uint8_t transform_dirty;
+  uint32_t transforms_version;
+
+  // world box, valid for world_version
+  vec3 world_center, world_half;
+  uint32_t world_version;
+  uint8_t world_valid;
+
   ex_octree_t *octree_data;
 
   mat4x4 *transforms;
@@ -69,11 +90,32 @@ typedef struct {
   size_t instance_count;
   int    is_static;
 
+  // where the meshes read instances from, the
+  // instance_vbo or a ring region while moving
+  GLuint   instance_buffer;
+  size_t   instance_offset;
+  uint32_t instance_version, instance_frame;
+
   GLuint shader;
 
   char path[512];
 } ex_model_t;
 
+// ex_model_update_batch working arrays, kept
+// between frames, zeroed to start and grown
+// to the model count as needed
+typedef struct {
+  ex_pose_key_t *keys;
+  uint32_t *next_frames;
+  float *weights;
+  uint32_t *leaders, *followers, *follows;
+  size_t cap;
+
+  // model index + 1 of the first model per pose
+  uint32_t *table;
+  size_t table_len;
+} ex_model_anim_scratch_t;
+
 /**
  * [ex_model_new define a new model]
  * @return [a new, empty model]
@@ -87,6 +129,17 @@ ex_model_t* ex_model_new();
  */
 ex_model_t* ex_model_copy(ex_model_t *model);
 
+/**
+ * [ex_model_copy_animation share anothers skeleton and animations]
+ * @param m      [the model, without animations of its own]
+ * @param source [model to share with]
+ *
+ * ex_model_copy does this, the pose stays
+ * per model.  Does nothing if source has
+ * no sampled animation.
+ */
+void ex_model_copy_animation(ex_model_t *m, ex_model_t *source);
+
 /**
  * [ex_model_add_mesh add a mesh to the render list]
  * @param m    [the model]
@@ -101,6 +154,16 @@ void ex_model_add_mesh(ex_model_t *m, ex_mesh_t *mesh);
  */
 void ex_model_init_instancing(ex_model_t *m, int count);
 
+/**
+ * [ex_model_mark_transforms_dirty flag transforms written by hand]
+ * @param m [the model]
+ *
+ * Call after changing m->transforms of an
+ * instanced or use_transform model, so its
+ * bounds and instance data get updated.
+ */
+void ex_model_mark_transforms_dirty(ex_model_t *m);
+
 /**
  * [ex_model_update update the model animations, transforms etc]
  * @param m          [the model to update]
@@ -108,6 +171,59 @@ void ex_model_init_instancing(ex_model_t *m, int count);
  */
 void ex_model_update(ex_model_t *m, float delta_time);
 
+/**
+ * [ex_model_update_batch ex_model_update many models over the job threads]
+ * @param scratch    [working arrays, grown when too small]
+ * @param models     [array of models, NULL entries skipped]
+ * @param count      [length of the array]
+ * @param delta_time []
+ *
+ * Models posed the same build it once and
+ * the rest copy it.  Gives the same result
+ * as updating one by one, for any number
+ * of threads.
+ */
+void ex_model_update_batch(ex_model_anim_scratch_t *scratch, ex_model_t **models, size_t count, float delta_time);
+
+/**
+ * [ex_model_anim_scratch_destroy free the batch working arrays]
+ * @param scratch [the scratch, left zeroed]
+ */
+void ex_model_anim_scratch_destroy(ex_model_anim_scratch_t *scratch);
+
+/**
+ * [ex_model_world_bounds world space box around every instance]
+ * @param m      [the model]
+ * @param center [the box center]
+ * @param half   [the box half extents, FLT_MAX without bounds]
+ *
+ * Also bumps m->version if the transforms
+ * changed since the last call.  The box is
+ * cached until they change again.
+ */
+void ex_model_world_bounds(ex_model_t *m, vec3 center, vec3 half);
+
+/**
+ * [ex_model_update_transforms rebuild every dirty model matrix]
+ * @param models [array of models, NULL entries skipped]
+ * @param count  [length of the array]
+ *
+ * Done in simd batches, run once a frame before
+ * culling so unchanged models cost a compare.
+ */
+void ex_model_update_transforms(ex_model_t **models, size_t count);
+
+/**
+ * [ex_model_upload update the instance buffer]
+ * @param m [the model]
+ *
+ * ex_model_draw does this itself, only needed
+ * when drawing through a render queue.  Only
+ * changed transforms are uploaded, into the
+ * instance ring when there is one.
+ */
+void ex_model_upload(ex_model_t *m);
+
 /**
  * [ex_model_draw render the model]
  * @param m      [the model to render]
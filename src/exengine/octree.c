@@ -1,6 +1,7 @@
 #include "octree.h"
 #include "vertices.h"
 #include "dbgui.h"
+#include "jobs.h"
 #include <stdio.h>
 
 int ex_octree_min_size = EX_OCTREE_DEFAULT_MIN_SIZE;
@@ -15,7 +16,6 @@ ex_octree_t* ex_octree_new(uint8_t type)
   memset(o->region.min, 0.0f, sizeof(vec3));
   memset(o->region.max, 1.0f, sizeof(vec3));
 
-  o->rendered = 0;
   o->built    = 0;
   o->first    = 1;
   o->obj_list = list_new();
@@ -39,7 +39,6 @@ void ex_octree_init(ex_octree_t *o, ex_rect_t region, list_t *objects)
     o->children[i] = NULL;
   }
   o->obj_list    = objects;
-  o->rendered    = 0;
   o->built       = 0;
   o->first       = 0;
   o->data_len    = 0;
@@ -51,6 +50,23 @@ void ex_octree_init(ex_octree_t *o, ex_rect_t region, list_t *objects)
   o->data_double = NULL;
 }
 
+static void ex_octree_octants(ex_rect_t octants[8], ex_rect_t *region)
+{
+  vec3 size, half, center;
+  vec3_sub(size, region->max, region->min);
+  vec3_scale(half, size, 0.5f);
+  vec3_add(center, region->min, half);
+
+  octants[0] = ex_rect_new(region->min, center);
+  octants[1] = ex_rect_new((vec3){center[0], region->min[1], region->min[2]}, (vec3){region->max[0], center[1], center[2]});
+  octants[2] = ex_rect_new((vec3){center[0], region->min[1], center[2]}, (vec3){region->max[0], center[1], region->max[2]});
+  octants[3] = ex_rect_new((vec3){region->min[0], region->min[1], center[2]}, (vec3){center[0], center[1], region->max[2]});
+  octants[4] = ex_rect_new((vec3){region->min[0], center[1], region->min[2]}, (vec3){center[0], region->max[1], center[2]});
+  octants[5] = ex_rect_new((vec3){center[0], center[1], region->min[2]}, (vec3){region->max[0], region->max[1], center[2]});
+  octants[6] = ex_rect_new(center, region->max);
+  octants[7] = ex_rect_new((vec3){region->min[0], center[1], center[2]}, (vec3){center[0], region->max[1], region->max[2]});
+}
+
 void ex_octree_build(ex_octree_t *o)
 {
   if (o->obj_list->data == NULL)
@@ -72,20 +88,9 @@ void ex_octree_build(ex_octree_t *o)
     }
   }
 
-  vec3 half, center;
-  vec3_scale(half, region, 0.5f);
-  vec3_add(center, o->region.min, half);
-
   // octant regions
   ex_rect_t octants[8];
-  octants[0] = ex_rect_new(o->region.min, center);
-  octants[1] = ex_rect_new((vec3){center[0], o->region.min[1], o->region.min[2]}, (vec3){o->region.max[0], center[1], center[2]});
-  octants[2] = ex_rect_new((vec3){center[0], o->region.min[1], center[2]}, (vec3){o->region.max[0], center[1], o->region.max[2]});
-  octants[3] = ex_rect_new((vec3){o->region.min[0], o->region.min[1], center[2]}, (vec3){center[0], center[1], o->region.max[2]});
-  octants[4] = ex_rect_new((vec3){o->region.min[0], center[1], o->region.min[2]}, (vec3){center[0], o->region.max[1], center[2]});
-  octants[5] = ex_rect_new((vec3){center[0], center[1], o->region.min[2]}, (vec3){o->region.max[0], o->region.max[1], center[2]});
-  octants[6] = ex_rect_new(center, o->region.max);
-  octants[7] = ex_rect_new((vec3){o->region.min[0], center[1], center[2]}, (vec3){center[0], o->region.max[1], o->region.max[2]});
+  ex_octree_octants(octants, &o->region);
 
   // object lists
   list_t *obj_lists[8];
@@ -241,12 +246,6 @@ ex_octree_t* ex_octree_reset(ex_octree_t *o)
     }
   }
 
-  if (o->rendered) {
-    glDeleteVertexArrays(1, &o->vao);
-    glDeleteBuffers(1, &o->vbo);
-    glDeleteBuffers(1, &o->ebo);
-  }
-
   int data_type = o->data_type;
   if (!o->first) {
     free(o);
@@ -258,19 +257,30 @@ ex_octree_t* ex_octree_reset(ex_octree_t *o)
   return NULL;
 }
 
+void ex_octree_destroy(ex_octree_t *o)
+{
+  if (o == NULL)
+    return;
+
+  // reset would otherwise hand back a fresh root
+  o->first = 0;
+  ex_octree_reset(o);
+}
+
 void ex_octree_get_colliding_count(ex_octree_t *o, ex_rect_t *bounds, int *count)
 {
   if (o == NULL)
     return;
 
+  // children are always inside their parent, so
+  // prune on the region whether we hold data or not
+  if (!ex_aabb_aabb(o->region, *bounds))
+    return;
+
   // add our data to the list
   void *oct_data = ex_octree_data_ptr(o);
-  if (oct_data != NULL) {
-    if (!ex_aabb_aabb(o->region, *bounds))
-      return;
-
+  if (oct_data != NULL)
     (*count)++;
-  }
 
   // recurse adding data to the list
   for (int i=0; i<8; i++)
@@ -283,12 +293,12 @@ void ex_octree_get_colliding(ex_octree_t *o, ex_rect_t *bounds, ex_octree_data_t
   if (o == NULL)
     return;
 
+  if (!ex_aabb_aabb(o->region, *bounds))
+    return;
+
   // add our data to the list
   void *oct_data = ex_octree_data_ptr(o);
   if (oct_data != NULL) {
-    if (!ex_aabb_aabb(o->region, *bounds))
-      return;
-
     data_list[*index].len = o->data_len;
     data_list[*index].data = oct_data;
     (*index)++;
@@ -300,62 +310,567 @@ void ex_octree_get_colliding(ex_octree_t *o, ex_rect_t *bounds, ex_octree_data_t
       ex_octree_get_colliding(o->children[i], bounds, data_list, index);
 }
 
-void ex_octree_render(ex_octree_t *o)
+static size_t ex_octree_count_nodes(ex_octree_t *o)
+{
+  size_t count = 1;
+  for (int i=0; i<8; i++)
+    if (o->children[i] != NULL)
+      count += ex_octree_count_nodes(o->children[i]);
+
+  return count;
+}
+
+static size_t ex_octree_count_data(ex_octree_t *o)
+{
+  size_t count = 0;
+  if (ex_octree_data_ptr(o) != NULL)
+    count += o->data_len;
+
+  for (int i=0; i<8; i++)
+    if (o->children[i] != NULL)
+      count += ex_octree_count_data(o->children[i]);
+
+  return count;
+}
+
+static size_t ex_octree_compact_depth(ex_octree_compact_t *c, uint32_t index)
+{
+  ex_octree_node_t *node = &c->nodes[index];
+
+  size_t depth = 0;
+  for (int i=0; i<node->child_count; i++) {
+    size_t child = ex_octree_compact_depth(c, node->first_child + i);
+    depth = MAX(depth, child);
+  }
+
+  return depth + 1;
+}
+
+static void ex_octree_compact_stack(ex_octree_compact_t *c)
+{
+  c->stack_size = 7 * ex_octree_compact_depth(c, 0) + 1;
+}
+
+typedef struct {
+  uint32_t index;
+  size_t first, len;
+  ex_octree_node_t *nodes;
+  size_t nodes_len;
+} ex_octree_job_t;
+
+typedef struct {
+  ex_rect_t *boxes, *tmp_boxes;
+  uint32_t  *data,  *tmp_data;
+  uint8_t   *codes;
+  ex_octree_node_t *nodes;
+  size_t nodes_len, nodes_size;
+
+  // subtrees this small are deferred to jobs, 0 builds everything
+  size_t job_size;
+  ex_octree_job_t *jobs;
+  size_t jobs_len, jobs_size;
+} ex_octree_builder_t;
+
+static uint32_t ex_octree_builder_alloc(ex_octree_builder_t *b, size_t count)
+{
+  if (b->nodes_len + count > b->nodes_size) {
+    while (b->nodes_len + count > b->nodes_size)
+      b->nodes_size *= 2;
+
+    b->nodes = realloc(b->nodes, sizeof(ex_octree_node_t) * b->nodes_size);
+  }
+
+  uint32_t first = b->nodes_len;
+  b->nodes_len += count;
+  return first;
+}
+
+static void ex_octree_builder_defer(ex_octree_builder_t *b, uint32_t index, size_t first, size_t len)
+{
+  if (b->jobs_len >= b->jobs_size) {
+    b->jobs_size = b->jobs_size ? b->jobs_size * 2 : 64;
+    b->jobs = realloc(b->jobs, sizeof(ex_octree_job_t) * b->jobs_size);
+  }
+
+  ex_octree_job_t *job = &b->jobs[b->jobs_len++];
+  job->index     = index;
+  job->first     = first;
+  job->len       = len;
+  job->nodes     = NULL;
+  job->nodes_len = 0;
+}
+
+static void ex_octree_builder_split(ex_octree_builder_t *b, uint32_t index, size_t first, size_t len, int root)
+{
+  ex_octree_node_t *node = &b->nodes[index];
+  node->first_child = 0;
+  node->child_count = 0;
+  node->data_first  = first;
+  node->data_len    = len;
+
+  if (len <= 1)
+    return;
+
+  if (!root && len <= b->job_size) {
+    ex_octree_builder_defer(b, index, first, len);
+    return;
+  }
+  vec3 size;
+  vec3_sub(size, node->region.max, node->region.min);
+  if (!root && (size[0] <= ex_octree_min_size || size[1] <= ex_octree_min_size || size[2] <= ex_octree_min_size))
+    return;
+
+  ex_rect_t octants[8];
+  ex_octree_octants(octants, &node->region);
+
+  // octant code per object, 8 means it stays here
+  size_t counts[9] = {0};
+  for (size_t i=first; i<first+len; i++) {
+    uint8_t code = 8;
+    for (int j=0; j<8; j++) {
+      if (ex_aabb_inside(octants[j], b->boxes[i])) {
+        code = j;
+        break;
+      }
+    }
+
+    b->codes[i] = code;
+    counts[code]++;
+  }
+
+  if (counts[8] == len)
+    return;
+
+  // stable counting sort, objects that stay first
+  // followed by each octants objects in order
+  size_t offsets[9];
+  offsets[8] = first;
+  size_t offset = first + counts[8];
+  for (int j=0; j<8; j++) {
+    offsets[j] = offset;
+    offset += counts[j];
+  }
+
+  for (size_t i=first; i<first+len; i++) {
+    size_t dest = offsets[b->codes[i]]++;
+    b->tmp_boxes[dest] = b->boxes[i];
+    b->tmp_data[dest]  = b->data[i];
+  }
+  memcpy(&b->boxes[first], &b->tmp_boxes[first], sizeof(ex_rect_t) * len);
+  memcpy(&b->data[first],  &b->tmp_data[first],  sizeof(uint32_t) * len);
+
+  // children are allocated as one contiguous block
+  int child_count = 0;
+  for (int j=0; j<8; j++)
+    if (counts[j] > 0)
+      child_count++;
+
+  uint32_t first_child = ex_octree_builder_alloc(b, child_count);
+  node = &b->nodes[index];
+  node->first_child = first_child;
+  node->child_count = child_count;
+  node->data_len    = counts[8];
+
+  size_t child_first = first + counts[8];
+  uint32_t child = first_child;
+  for (int j=0; j<8; j++) {
+    if (counts[j] == 0)
+      continue;
+
+    memcpy(&b->nodes[child].region, &octants[j], sizeof(ex_rect_t));
+    ex_octree_builder_split(b, child, child_first, counts[j], 0);
+    child_first += counts[j];
+    child++;
+  }
+}
+
+static void ex_octree_builder_job(void *data, size_t i)
+{
+  ex_octree_builder_t *top = data;
+  ex_octree_job_t *job = &top->jobs[i];
+
+  // shares the object arrays, the job owns
+  // the range [first, first+len) of them
+  ex_octree_builder_t b = *top;
+  b.job_size   = 0;
+  b.jobs       = NULL;
+  b.jobs_len   = 0;
+  b.jobs_size  = 0;
+  b.nodes_size = 64;
+  b.nodes_len  = 0;
+  b.nodes      = malloc(sizeof(ex_octree_node_t) * b.nodes_size);
+
+  uint32_t root = ex_octree_builder_alloc(&b, 1);
+  memcpy(&b.nodes[root].region, &top->nodes[job->index].region, sizeof(ex_rect_t));
+  ex_octree_builder_split(&b, root, job->first, job->len, 0);
+
+  job->nodes     = b.nodes;
+  job->nodes_len = b.nodes_len;
+}
+
+static void ex_octree_builder_splice(ex_octree_builder_t *b, ex_octree_builder_t *top, uint32_t src, uint32_t dest, size_t *job)
+{
+  // jobs were deferred in depth first order, so
+  // they come up in the same order here
+  if (*job < top->jobs_len && top->jobs[*job].index == src) {
+    ex_octree_job_t *j = &top->jobs[(*job)++];
+
+    // the jobs root takes the reserved slot, the rest
+    // is appended, exactly where a serial build puts it
+    uint32_t base = ex_octree_builder_alloc(b, j->nodes_len - 1);
+    for (size_t i=0; i<j->nodes_len; i++) {
+      ex_octree_node_t node = j->nodes[i];
+      if (node.child_count)
+        node.first_child = base + node.first_child - 1;
+
+      b->nodes[i ? base + i - 1 : dest] = node;
+    }
+
+    free(j->nodes);
+    return;
+  }
+
+  ex_octree_node_t *node = &top->nodes[src];
+  b->nodes[dest] = *node;
+  if (!node->child_count)
+    return;
+
+  uint32_t first_child = ex_octree_builder_alloc(b, node->child_count);
+  b->nodes[dest].first_child = first_child;
+  for (int i=0; i<node->child_count; i++)
+    ex_octree_builder_splice(b, top, node->first_child + i, first_child + i, job);
+}
+
+static ex_octree_compact_t* ex_octree_compact_build_jobs(ex_rect_t region, ex_rect_t *boxes, uint32_t *data, size_t len, size_t job_size)
+{
+  if (boxes == NULL || data == NULL || len == 0)
+    return NULL;
+
+  ex_octree_builder_t b;
+  b.boxes      = boxes;
+  b.data       = data;
+  b.tmp_boxes  = malloc(sizeof(ex_rect_t) * len);
+  b.tmp_data   = malloc(sizeof(uint32_t) * len);
+  b.codes      = malloc(sizeof(uint8_t) * len);
+  b.nodes_size = 64;
+  b.nodes_len  = 0;
+  b.nodes      = malloc(sizeof(ex_octree_node_t) * b.nodes_size);
+  b.job_size   = job_size;
+  b.jobs       = NULL;
+  b.jobs_len   = 0;
+  b.jobs_size  = 0;
+
+  uint32_t root = ex_octree_builder_alloc(&b, 1);
+  memcpy(&b.nodes[root].region, &region, sizeof(ex_rect_t));
+  ex_octree_builder_split(&b, root, 0, len, 1);
+
+  if (b.jobs_len) {
+    ex_jobs_run(ex_octree_builder_job, &b, b.jobs_len);
+
+    // stitch the top of the tree and the job
+    // subtrees back together in serial order
+    ex_octree_builder_t out = b;
+    out.nodes_size = b.nodes_len * 2;
+    out.nodes_len  = 0;
+    out.nodes      = malloc(sizeof(ex_octree_node_t) * out.nodes_size);
+
+    size_t job = 0;
+    root = ex_octree_builder_alloc(&out, 1);
+    ex_octree_builder_splice(&out, &b, 0, root, &job);
+
+    free(b.nodes);
+    free(b.jobs);
+    b.nodes     = out.nodes;
+    b.nodes_len = out.nodes_len;
+  }
+
+  free(b.tmp_boxes);
+  free(b.codes);
+
+  // the reordered data is already in node order
+  ex_octree_compact_t *c = malloc(sizeof(ex_octree_compact_t));
+  c->nodes     = realloc(b.nodes, sizeof(ex_octree_node_t) * b.nodes_len);
+  c->nodes_len = b.nodes_len;
+  c->data      = b.tmp_data;
+  c->data_len  = len;
+  c->debug     = NULL;
+  memcpy(c->data, data, sizeof(uint32_t) * len);
+  ex_octree_compact_stack(c);
+
+  return c;
+}
+
+ex_octree_compact_t* ex_octree_compact_build(ex_rect_t region, ex_rect_t *boxes, uint32_t *data, size_t len)
+{
+  return ex_octree_compact_build_jobs(region, boxes, data, len, 0);
+}
+
+ex_octree_compact_t* ex_octree_compact_build_parallel(ex_rect_t region, ex_rect_t *boxes, uint32_t *data, size_t len)
+{
+  size_t job_size = ex_jobs_threads() > 1 ? EX_OCTREE_JOB_SIZE : 0;
+  return ex_octree_compact_build_jobs(region, boxes, data, len, job_size);
+}
+
+ex_octree_compact_t* ex_octree_compact(ex_octree_t *o)
 {
   if (o == NULL || !o->built)
+    return NULL;
+
+  if (o->data_type != OBJ_TYPE_UINT) {
+    printf("Only OBJ_TYPE_UINT octrees can be compacted\n");
+    return NULL;
+  }
+
+  ex_octree_compact_t *c = malloc(sizeof(ex_octree_compact_t));
+  c->nodes_len = ex_octree_count_nodes(o);
+  c->data_len  = ex_octree_count_data(o);
+  c->nodes     = malloc(sizeof(ex_octree_node_t) * c->nodes_len);
+  c->data      = malloc(sizeof(uint32_t) * (c->data_len > 0 ? c->data_len : 1));
+  c->debug     = NULL;
+
+  // breadth first, the source node list doubles as our
+  // queue and keeps every nodes children contiguous
+  ex_octree_t **queue = malloc(sizeof(ex_octree_t*) * c->nodes_len);
+  queue[0] = o;
+  size_t len = 1, data_offset = 0;
+  for (size_t i=0; i<c->nodes_len; i++) {
+    ex_octree_t      *src  = queue[i];
+    ex_octree_node_t *node = &c->nodes[i];
+
+    memcpy(&node->region, &src->region, sizeof(ex_rect_t));
+    node->first_child = len;
+    node->child_count = 0;
+    node->data_first  = data_offset;
+    node->data_len    = 0;
+
+    if (src->data_uint != NULL && src->data_len > 0) {
+      memcpy(&c->data[data_offset], src->data_uint, sizeof(uint32_t) * src->data_len);
+      node->data_len = src->data_len;
+      data_offset   += src->data_len;
+    }
+
+    for (int k=0; k<8; k++) {
+      if (src->children[k] != NULL) {
+        queue[len++] = src->children[k];
+        node->child_count++;
+      }
+    }
+  }
+
+  free(queue);
+  ex_octree_compact_stack(c);
+  return c;
+}
+
+void ex_octree_compact_query(ex_octree_compact_t *c, ex_rect_t *bounds, ex_query_buffer_t *out)
+{
+  out->len   = 0;
+  out->nodes = 0;
+
+  if (c == NULL || c->nodes_len == 0)
     return;
 
-  int alive = 0;
-  for (int i=0; i<8; i++) {
-    if (o->children[i] != NULL) {
-      ex_octree_render(o->children[i]);
-      alive++;
+  uint32_t stack[c->stack_size];
+  int top = 0;
+  stack[top++] = 0;
+
+  while (top > 0) {
+    ex_octree_node_t *node = &c->nodes[stack[--top]];
+    out->nodes++;
+
+    // children are always inside their parent
+    if (!ex_aabb_aabb(node->region, *bounds))
+      continue;
+
+    if (node->data_len > 0) {
+      ex_query_buffer_reserve(out, node->data_len);
+      memcpy(&out->data[out->len], &c->data[node->data_first], sizeof(uint32_t) * node->data_len);
+      out->len += node->data_len;
     }
+
+    for (int i=node->child_count-1; i>=0; i--)
+      stack[top++] = node->first_child + i;
   }
+}
 
-  if (alive < 1 && o->data_len == 0)
+void ex_octree_compact_visit(ex_octree_compact_t *c, ex_rect_t *bounds, ex_visit_func_t func, void *data)
+{
+  if (c == NULL || c->nodes_len == 0)
     return;
 
-  if (ex_dbgprofiler.octree_obj_only && o->data_len == 0)
+  uint32_t stack[c->stack_size];
+  int top = 0;
+  stack[top++] = 0;
+
+  while (top > 0) {
+    ex_octree_node_t *node = &c->nodes[stack[--top]];
+    if (!ex_aabb_aabb(node->region, *bounds))
+      continue;
+
+    if (node->data_len > 0 && !func(data, &c->data[node->data_first], node->data_len))
+      return;
+
+    for (int i=node->child_count-1; i>=0; i--)
+      stack[top++] = node->first_child + i;
+  }
+}
+
+void ex_octree_compact_raycast(ex_octree_compact_t *c, vec3 from, vec3 dir, float max, ex_ray_func_t func, void *data)
+{
+  if (c == NULL || c->nodes_len == 0)
     return;
 
-  if (!o->rendered) {
-    float vertices[EX_VERTICES_CUBE_LEN];
-    memcpy(vertices, ex_vertices_cube, sizeof(float)*EX_VERTICES_CUBE_LEN);
+  vec3 inv_dir;
+  for (int i=0; i<3; i++)
+    inv_dir[i] = 1.0f / dir[i];
+
+  float near;
+  if (!ex_ray_aabb(&c->nodes[0].region, from, inv_dir, max, &near))
+    return;
+
+  struct {
+    uint32_t index;
+    float near;
+  } stack[c->stack_size];
+  int top = 0;
+  stack[top].index  = 0;
+  stack[top++].near = near;
+
+  while (top > 0) {
+    top--;
+    // something closer was hit since this was pushed
+    if (stack[top].near > max)
+      continue;
+
+    ex_octree_node_t *node = &c->nodes[stack[top].index];
+    if (node->data_len > 0)
+      max = func(data, &c->data[node->data_first], node->data_len, max);
+
+    // sort the hit children far to near, so
+    // the nearest is popped first
+    uint32_t children[8];
+    float nears[8];
+    int count = 0;
+    for (int i=0; i<node->child_count; i++) {
+      uint32_t child = node->first_child + i;
+      if (!ex_ray_aabb(&c->nodes[child].region, from, inv_dir, max, &near))
+        continue;
+
+      int j = count++;
+      for (; j>0 && nears[j-1] < near; j--) {
+        children[j] = children[j-1];
+        nears[j]    = nears[j-1];
+      }
+      children[j] = child;
+      nears[j]    = near;
+    }
 
-    for (int i=0; i<EX_VERTICES_CUBE_LEN; i+=3) {
-      vertices[i+0] > 0.0f ? (vertices[i+0] = o->region.max[0]) : (vertices[i+0] = o->region.min[0]);
-      vertices[i+1] > 0.0f ? (vertices[i+1] = o->region.max[1]) : (vertices[i+1] = o->region.min[1]);
-      vertices[i+2] > 0.0f ? (vertices[i+2] = o->region.max[2]) : (vertices[i+2] = o->region.min[2]);
+    for (int i=0; i<count; i++) {
+      stack[top].index  = children[i];
+      stack[top++].near = nears[i];
     }
+  }
+}
 
-    glGenVertexArrays(1, &o->vao);
-    glGenBuffers(1, &o->vbo);
-    glGenBuffers(1, &o->ebo);
-    glBindVertexArray(o->vao);
+static void ex_octree_compact_debug_init(ex_octree_compact_t *c)
+{
+  ex_octree_debug_t *d = malloc(sizeof(ex_octree_debug_t));
+  c->debug = d;
+
+  // every node with data or children gets a box,
+  // nodes with data first so we can draw only those
+  size_t count = 0;
+  for (size_t i=0; i<c->nodes_len; i++)
+    if (c->nodes[i].data_len > 0 || c->nodes[i].child_count > 0)
+      count++;
+
+  float  *vertices = malloc(sizeof(float) * EX_VERTICES_CUBE_LEN * (count > 0 ? count : 1));
+  GLuint *indices  = malloc(sizeof(GLuint) * EX_INDICES_CUBE_LEN * (count > 0 ? count : 1));
+
+  size_t box = 0;
+  d->obj_len = 0;
+  for (int pass=0; pass<2; pass++) {
+    for (size_t i=0; i<c->nodes_len; i++) {
+      ex_octree_node_t *n = &c->nodes[i];
+      if ((pass == 0 && n->data_len == 0) || (pass == 1 && (n->data_len > 0 || n->child_count == 0)))
+        continue;
 
-    glBindBuffer(GL_ARRAY_BUFFER, o->vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float)*EX_VERTICES_CUBE_LEN, &vertices[0], GL_STATIC_DRAW);
+      float *v = &vertices[box * EX_VERTICES_CUBE_LEN];
+      for (int k=0; k<EX_VERTICES_CUBE_LEN; k+=3) {
+        v[k+0] = ex_vertices_cube[k+0] > 0.0f ? n->region.max[0] : n->region.min[0];
+        v[k+1] = ex_vertices_cube[k+1] > 0.0f ? n->region.max[1] : n->region.min[1];
+        v[k+2] = ex_vertices_cube[k+2] > 0.0f ? n->region.max[2] : n->region.min[2];
+      }
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, o->ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint)*EX_INDICES_CUBE_LEN, &ex_indices_cube[0], GL_STATIC_DRAW);
+      for (int k=0; k<EX_INDICES_CUBE_LEN; k++)
+        indices[box * EX_INDICES_CUBE_LEN + k] = ex_indices_cube[k] + box * (EX_VERTICES_CUBE_LEN / 3);
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(float)*3, (GLvoid*)0);
-    glEnableVertexAttribArray(0);
-    
-    glBindVertexArray(0);
-    o->rendered = 1;
+      box++;
+    }
+
+    if (pass == 0)
+      d->obj_len = box * EX_INDICES_CUBE_LEN;
   }
+  d->len = box * EX_INDICES_CUBE_LEN;
+
+  glGenVertexArrays(1, &d->vao);
+  glGenBuffers(1, &d->vbo);
+  glGenBuffers(1, &d->ebo);
+  glBindVertexArray(d->vao);
+
+  glBindBuffer(GL_ARRAY_BUFFER, d->vbo);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(float)*EX_VERTICES_CUBE_LEN*box, &vertices[0], GL_STATIC_DRAW);
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, d->ebo);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint)*d->len, &indices[0], GL_STATIC_DRAW);
+
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(float)*3, (GLvoid*)0);
+  glEnableVertexAttribArray(0);
+
+  glBindVertexArray(0);
+
+  free(vertices);
+  free(indices);
+}
+
+void ex_octree_compact_render(ex_octree_compact_t *c)
+{
+  if (c == NULL || c->nodes_len == 0)
+    return;
+
+  if (c->debug == NULL)
+    ex_octree_compact_debug_init(c);
+
+  size_t len = ex_dbgprofiler.octree_obj_only ? c->debug->obj_len : c->debug->len;
+  if (len == 0)
+    return;
 
   glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
   glDisable(GL_DEPTH_TEST);
   glDisable(GL_CULL_FACE);
   glCullFace(GL_NONE);
-  glBindVertexArray(o->vao);
+  glBindVertexArray(c->debug->vao);
   glLineWidth(0.5f);
-  glDrawElements(GL_LINES, EX_INDICES_CUBE_LEN, GL_UNSIGNED_INT, 0); 
+  glDrawElements(GL_LINES, len, GL_UNSIGNED_INT, 0); 
   glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
   glEnable(GL_DEPTH_TEST);
   glEnable(GL_CULL_FACE);
   glBindVertexArray(0);
-}
\ No newline at end of file
+}
+
+void ex_octree_compact_destroy(ex_octree_compact_t *c)
+{
+  if (c == NULL)
+    return;
+
+  if (c->debug != NULL) {
+    glDeleteVertexArrays(1, &c->debug->vao);
+    glDeleteBuffers(1, &c->debug->vbo);
+    glDeleteBuffers(1, &c->debug->ebo);
+    free(c->debug);
+  }
+
+  free(c->nodes);
+  free(c->data);
+  free(c);
+}
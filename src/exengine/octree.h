@@ -21,6 +21,10 @@
 #define EX_OCTREE_DEFAULT_MIN_SIZE 5.0f
 extern int ex_octree_min_size;
 
+// parallel builds hand subtrees of at most this
+// many objects to a worker thread each
+#define EX_OCTREE_JOB_SIZE 4096
+
 enum {
   OBJ_TYPE_UINT,
   OBJ_TYPE_INT,
@@ -57,7 +61,6 @@ struct ex_octree_t {
   int max_life, cur_life;
   list_t *obj_list;
   // flags etc
-  uint8_t rendered  : 1;
   uint8_t built     : 1;
   uint8_t first     : 1;
   uint8_t data_type : 5;
@@ -70,11 +73,65 @@ struct ex_octree_t {
     float    *data_float;
     double   *data_double;
   };
-  // debug render stuffs
-  GLuint vbo, vao, ebo;
-  int player_inside;
 };
 
+/*
+  The compact octree is the finalized, read-only
+  form of a built tree.  All nodes live in a single
+  array with each nodes children stored contiguously,
+  and all node data is packed into one shared index
+  buffer, so queries never chase pointers.
+*/
+typedef struct {
+  ex_rect_t region;
+  uint32_t  first_child, data_first, data_len;
+  uint8_t   child_count;
+} ex_octree_node_t;
+
+typedef struct {
+  // debug render stuffs, kept out of the nodes
+  GLuint vbo, vao, ebo;
+  size_t len, obj_len;
+} ex_octree_debug_t;
+
+/*
+  A growable buffer of data indices filled
+  by tree queries, keep one around per caller
+  and reuse it so queries never allocate.
+*/
+typedef struct {
+  uint32_t *data;
+  size_t len, size;
+  size_t nodes; // visited by the last query
+} ex_query_buffer_t;
+
+typedef struct {
+  ex_octree_node_t *nodes;
+  size_t nodes_len;
+  uint32_t *data;
+  size_t data_len;
+  // traversal stack queries need, 7 pending
+  // siblings per level plus the last 8
+  size_t stack_size;
+  ex_octree_debug_t *debug;
+} ex_octree_compact_t;
+
+/*
+  Ray traversals call this with the data of
+  each node the ray passes through, nearest
+  first.  It returns the distance to the
+  closest hit so far, nodes farther than
+  that are skipped.
+*/
+typedef float (*ex_ray_func_t)(void *data, uint32_t *items, size_t len, float max);
+
+/*
+  Visits call this with the data of each
+  node overlapping the bounds, returning
+  0 stops the traversal early.
+*/
+typedef int (*ex_visit_func_t)(void *data, uint32_t *items, size_t len);
+
 /**
  * [ex_octree_new defines a new octree]
  * @param  type [the data type to store]
@@ -109,6 +166,12 @@ void ex_octree_finalize(ex_octree_t *o);
  */
 ex_octree_t* ex_octree_reset(ex_octree_t *o);
 
+/**
+ * [ex_octree_destroy cleans up the octree, including the root]
+ * @param o [the octree to destroy]
+ */
+void ex_octree_destroy(ex_octree_t *o);
+
 /**
  * [ex_octree_get_colliding_count]
  * @param o      [the octree to check]
@@ -127,10 +190,81 @@ void ex_octree_get_colliding_count(ex_octree_t *o, ex_rect_t *bounds, int *count
 void ex_octree_get_colliding(ex_octree_t *o, ex_rect_t *bounds, ex_octree_data_t *data_list, int *index);
 
 /**
- * [ex_octree_render debug render]
- * @param o [the octree to render]
+ * [ex_octree_compact flattens a built tree into its compact form]
+ * @param  o [the built octree, must store OBJ_TYPE_UINT data]
+ * @return   [the compact octree, NULL on failure]
+ */
+ex_octree_compact_t* ex_octree_compact(ex_octree_t *o);
+
+/**
+ * [ex_octree_compact_build build a compact tree straight from object bounds]
+ * @param  region [the max region]
+ * @param  boxes  [the object bounds, reordered in place]
+ * @param  data   [the object data, reordered alongside boxes]
+ * @param  len    [the object count]
+ * @return        [the compact octree, NULL if there are no objects]
+ *
+ * Objects are partitioned by octant with a stable
+ * counting sort per node, so each level costs O(n)
+ * and nothing is allocated per object.
+ */
+ex_octree_compact_t* ex_octree_compact_build(ex_rect_t region, ex_rect_t *boxes, uint32_t *data, size_t len);
+
+/**
+ * [ex_octree_compact_build_parallel ex_octree_compact_build split across the job threads]
+ * @param  region [the max region]
+ * @param  boxes  [the object bounds, reordered in place]
+ * @param  data   [the object data, reordered alongside boxes]
+ * @param  len    [the object count]
+ * @return        [the compact octree, NULL if there are no objects]
+ *
+ * The top of the tree is split serially until
+ * subtrees are small enough, those are built in
+ * parallel and spliced back in depth first order.
+ * The result is identical to the serial build for
+ * any thread count.
+ */
+ex_octree_compact_t* ex_octree_compact_build_parallel(ex_rect_t region, ex_rect_t *boxes, uint32_t *data, size_t len);
+
+/**
+ * [ex_octree_compact_query gather all colliding entry data in a single pass]
+ * @param c      [the compact octree to check]
+ * @param bounds [the bounds to check]
+ * @param out    [the buffer to fill, emptied first]
  */
-void ex_octree_render(ex_octree_t *o);
+void ex_octree_compact_query(ex_octree_compact_t *c, ex_rect_t *bounds, ex_query_buffer_t *out);
+
+/**
+ * [ex_octree_compact_visit ex_octree_compact_query without the buffer]
+ * @param c      [the compact octree to check]
+ * @param bounds [the bounds to check]
+ * @param func   [called with each overlapping nodes data]
+ * @param data   [user pointer passed to func]
+ */
+void ex_octree_compact_visit(ex_octree_compact_t *c, ex_rect_t *bounds, ex_visit_func_t func, void *data);
+
+/**
+ * [ex_octree_compact_raycast visit nodes along a ray front to back]
+ * @param c    [the compact octree to check]
+ * @param from [the ray origin]
+ * @param dir  [the ray direction, distances are in its length]
+ * @param max  [how far along the ray to look]
+ * @param func [called with each nodes data]
+ * @param data [user pointer passed to func]
+ */
+void ex_octree_compact_raycast(ex_octree_compact_t *c, vec3 from, vec3 dir, float max, ex_ray_func_t func, void *data);
+
+/**
+ * [ex_octree_compact_render debug render]
+ * @param c [the compact octree to render]
+ */
+void ex_octree_compact_render(ex_octree_compact_t *c);
+
+/**
+ * [ex_octree_compact_destroy cleanup compact octree data]
+ * @param c [the compact octree to destroy]
+ */
+void ex_octree_compact_destroy(ex_octree_compact_t *c);
 
 /**
  * [ex_octree_data_ptr]
@@ -166,6 +300,45 @@ static inline void* ex_octree_data_ptr(ex_octree_t *o) {
   return NULL;
 }
 
+/**
+ * [ex_query_buffer_init set up an empty query buffer]
+ * @param q [the buffer to init]
+ */
+static inline void ex_query_buffer_init(ex_query_buffer_t *q) {
+  q->data  = NULL;
+  q->len   = 0;
+  q->size  = 0;
+  q->nodes = 0;
+};
+
+/**
+ * [ex_query_buffer_reserve make room for more entries]
+ * @param q     [the buffer to grow]
+ * @param count [how many entries are about to be appended]
+ */
+static inline void ex_query_buffer_reserve(ex_query_buffer_t *q, size_t count) {
+  if (q->len + count <= q->size)
+    return;
+
+  size_t size = q->size > 0 ? q->size : 64;
+  while (size < q->len + count)
+    size *= 2;
+
+  q->data = realloc(q->data, sizeof(uint32_t) * size);
+  q->size = size;
+};
+
+/**
+ * [ex_query_buffer_destroy free the buffer data]
+ * @param q [the buffer to cleanup]
+ */
+static inline void ex_query_buffer_destroy(ex_query_buffer_t *q) {
+  if (q->data != NULL)
+    free(q->data);
+
+  ex_query_buffer_init(q);
+};
+
 /**
  * [ex_rect_new defines a new 3d rect]
  * @param  min [the min position]
@@ -209,6 +382,30 @@ static inline int ex_aabb_inside(ex_rect_t outer, ex_rect_t inner) {
           outer.max[2] >= inner.max[2]);
 };
 
+/**
+ * [ex_ray_aabb slab test a ray against a box]
+ * @param  r       [the box]
+ * @param  from    [the ray origin]
+ * @param  inv_dir [1 / the ray direction]
+ * @param  max     [how far along the ray to look]
+ * @param  near    [returned entry distance, 0 if inside]
+ * @return         [1 if the ray hits the box within max]
+ */
+static inline int ex_ray_aabb(ex_rect_t *r, vec3 from, vec3 inv_dir, float max, float *near) {
+  float t0 = 0.0f, t1 = max;
+  for (int i=0; i<3; i++) {
+    float a = (r->min[i] - from[i]) * inv_dir[i];
+    float b = (r->max[i] - from[i]) * inv_dir[i];
+    // fmin/fmax drop the nan a parallel ray
+    // starting on a slab plane produces
+    t0 = fmaxf(t0, fminf(a, b));
+    t1 = fminf(t1, fmaxf(a, b));
+  }
+
+  *near = t0;
+  return t0 <= t1;
+};
+
 static inline ex_rect_t ex_rect_from_triangle(vec3 tri[3]) {
   ex_rect_t box;
 
@@ -15,17 +15,11 @@ void ex_point_light_init()
   mat4x4_perspective(point_shadow_projection, rad(90.0f), aspect, 0.1f, EX_POINT_FAR_PLANE); 
 }
 
-ex_point_light_t *ex_point_light_new(vec3 pos, vec3 color, int dynamic)
+static void ex_point_light_cube(GLuint *map, GLuint *fbo)
 {
-  ex_point_light_t *l = malloc(sizeof(ex_point_light_t));
-
-  // set light properties
-  memcpy(l->position, pos, sizeof(vec3));
-  memcpy(l->color, color, sizeof(vec3));
-
   // generate cube map
-  glGenTextures(1, &l->depth_map);
-  glBindTexture(GL_TEXTURE_CUBE_MAP, l->depth_map);
+  glGenTextures(1, map);
+  glBindTexture(GL_TEXTURE_CUBE_MAP, *map);
   for (int i=0; i<6; i++)
     glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT16,
       SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
@@ -39,14 +33,25 @@ ex_point_light_t *ex_point_light_new(vec3 pos, vec3 color, int dynamic)
   glTexParameterfv(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BORDER_COLOR, border);  
 
   // only want the depth buffer
-  glGenFramebuffers(1, &l->depth_map_fbo);
-  glBindFramebuffer(GL_FRAMEBUFFER, l->depth_map_fbo);
-  glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, l->depth_map, 0);
+  glGenFramebuffers(1, fbo);
+  glBindFramebuffer(GL_FRAMEBUFFER, *fbo);
+  glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, *map, 0);
   glDrawBuffer(GL_NONE);
   glReadBuffer(GL_NONE);
   if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
     printf("Error! Point light framebuffer is not complete!\n");
   glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+ex_point_light_t *ex_point_light_new(vec3 pos, vec3 color, int dynamic)
+{
+  ex_point_light_t *l = malloc(sizeof(ex_point_light_t));
+
+  // set light properties
+  memcpy(l->position, pos, sizeof(vec3));
+  memcpy(l->color, color, sizeof(vec3));
+
+  ex_point_light_cube(&l->depth_map, &l->depth_map_fbo);
 
   l->shader     = point_light_shader;
   l->dynamic    = dynamic;
@@ -54,13 +59,24 @@ ex_point_light_t *ex_point_light_new(vec3 pos, vec3 color, int dynamic)
   l->is_shadow  = 1;
   l->is_visible = 1;
 
+  // matches an empty scene, version 0 and no casters
+  for (int i=0; i<2; i++) {
+    l->casters[i]     = NULL;
+    l->casters_len[i] = 0;
+    l->casters_cap[i] = 0;
+  }
+  l->casters_version = 0;
+  memcpy(l->casters_position, pos, sizeof(vec3));
+
+  l->split                 = 0;
+  l->dynamic_depth_map     = 0;
+  l->dynamic_depth_map_fbo = 0;
+
   return l;
 }
 
-void ex_point_light_begin(ex_point_light_t *l)
+static void ex_point_light_transforms(ex_point_light_t *l)
 {
-  l->update = 0;
-
   // dont ask
   vec3 temp;
   vec3_add(temp, l->position, (vec3){1.0f, 0.0f, 0.0f});
@@ -86,10 +102,111 @@ void ex_point_light_begin(ex_point_light_t *l)
   vec3_add(temp, l->position, (vec3){0.0f, 0.0f, -1.0f});
   mat4x4_look_at(l->transform[5], l->position, temp, (vec3){0.0f, -1.0f, 0.0f});
   mat4x4_mul(l->transform[5], point_shadow_projection, l->transform[5]);
+}
+
+// stores the casters of one list, 1 if any differ from last time
+static int ex_point_light_store(ex_point_light_t *l, int list, size_t index, ex_point_caster_t *c)
+{
+  size_t len = l->casters_len[list];
+  int changed = index >= len || memcmp(&l->casters[list][index], c, sizeof(ex_point_caster_t));
+
+  l->casters[list][index] = *c;
+  return changed;
+}
+
+int ex_point_light_cull_casters(ex_point_light_t *l, ex_point_casters_t *casters)
+{
+  int moved = memcmp(l->casters_position, l->position, sizeof(vec3));
+  if (!l->update && !moved && casters->version == l->casters_version)
+    return 0;
+
+  l->casters_version = casters->version;
+  memcpy(l->casters_position, l->position, sizeof(vec3));
+
+  for (int i=0; i<2; i++) {
+    if (l->casters_cap[i] < casters->count) {
+      l->casters[i]     = realloc(l->casters[i], sizeof(ex_point_caster_t) * casters->count);
+      l->casters_cap[i] = casters->count;
+    }
+  }
+
+  ex_point_light_transforms(l);
+  ex_frustum_t faces[6];
+  for (int i=0; i<6; i++)
+    ex_frustum_from_matrix(&faces[i], l->transform[i]);
+
+  // depth past the far plane clamps to the clear value,
+  // so the cube only ever sees a sphere of that radius
+  float r2 = EX_POINT_FAR_PLANE * EX_POINT_FAR_PLANE;
+  size_t len[2] = {0, 0};
+  int changed[2] = {0, 0};
+  for (size_t i=0; i<casters->count; i++) {
+    vec3 c = {casters->center[0][i], casters->center[1][i], casters->center[2][i]};
+    vec3 h = {casters->half[0][i], casters->half[1][i], casters->half[2][i]};
+
+    float d2 = 0.0f;
+    for (int j=0; j<3; j++) {
+      float d = fabsf(c[j] - l->position[j]) - h[j];
+      if (d > 0.0f)
+        d2 += d*d;
+    }
+    if (d2 > r2)
+      continue;
+
+    ex_point_caster_t caster;
+    memset(&caster, 0, sizeof(caster));
+    caster.handle  = casters->handles[i];
+    caster.version = casters->versions[i];
+    for (int j=0; j<6; j++)
+      if (ex_frustum_aabb(&faces[j], c, h))
+        caster.faces |= 1 << j;
+
+    if (caster.faces) {
+      int list = casters->is_static[i] ? EX_POINT_STATIC : EX_POINT_DYNAMIC;
+      changed[list] |= ex_point_light_store(l, list, len[list]++, &caster);
+    }
+  }
+
+  // the static map holds the dynamic casters too when not split
+  int had_dynamic = !l->split && l->casters_len[EX_POINT_DYNAMIC];
+  for (int i=0; i<2; i++) {
+    changed[i] |= len[i] != l->casters_len[i];
+    l->casters_len[i] = len[i];
+  }
+
+  // only worth a second map when both have something
+  int was_split = l->split;
+  l->split = l->dynamic && len[EX_POINT_STATIC] && len[EX_POINT_DYNAMIC];
+
+  if (l->update || moved)
+    return l->split ? EX_POINT_STATIC_MAP | EX_POINT_DYNAMIC_MAP : EX_POINT_STATIC_MAP;
+
+  int maps = 0;
+  int with_dynamic = !l->split && len[EX_POINT_DYNAMIC];
+  if (changed[EX_POINT_STATIC] || with_dynamic != had_dynamic || (with_dynamic && changed[EX_POINT_DYNAMIC]))
+    maps |= EX_POINT_STATIC_MAP;
+  if (l->split && (changed[EX_POINT_DYNAMIC] || !was_split))
+    maps |= EX_POINT_DYNAMIC_MAP;
+
+  return maps;
+}
+
+void ex_point_light_begin(ex_point_light_t *l, int map)
+{
+  l->update = 0;
+
+  ex_point_light_transforms(l);
+
+  GLuint fbo = l->depth_map_fbo;
+  if (map == EX_POINT_DYNAMIC) {
+    if (!l->dynamic_depth_map)
+      ex_point_light_cube(&l->dynamic_depth_map, &l->dynamic_depth_map_fbo);
+    fbo = l->dynamic_depth_map_fbo;
+  }
 
   // render to depth cube map
   glViewport(0, 0, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE);
-  glBindFramebuffer(GL_FRAMEBUFFER, l->depth_map_fbo);
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo);
 
   glClear(GL_DEPTH_BUFFER_BIT);
   glEnable(GL_DEPTH_TEST);
@@ -105,6 +222,7 @@ void ex_point_light_begin(ex_point_light_t *l)
 
   glUniform1f(ex_uniform(l->shader, "u_far_plane"), EX_POINT_FAR_PLANE);
   glUniform3fv(ex_uniform(l->shader, "u_light_pos"), 1, l->position);
+  glUniform1i(ex_uniform(l->shader, "u_face_mask"), EX_POINT_ALL_FACES);
 }
 
 void ex_point_light_draw(ex_point_light_t *l, GLuint shader, const char *prefix, int deferred)
@@ -120,6 +238,14 @@ void ex_point_light_draw(ex_point_light_t *l, GLuint shader, const char *prefix,
     
     glActiveTexture(GL_TEXTURE0+tid);
     glBindTexture(GL_TEXTURE_CUBE_MAP, l->depth_map);
+
+    // always set, two sampler types on one unit fails the draw
+    glUniform1i(ex_uniform(shader, "u_point_depth_dynamic"), EX_POINT_DYNAMIC_UNIT);
+    glUniform1i(ex_uniform(shader, "u_point_split"), l->split);
+    if (l->split) {
+      glActiveTexture(GL_TEXTURE0+EX_POINT_DYNAMIC_UNIT);
+      glBindTexture(GL_TEXTURE_CUBE_MAP, l->dynamic_depth_map);
+    }
   } else if (prefix != NULL) {
     char buff[64];
     sprintf(buff, "%s.is_shadow", prefix);
@@ -146,5 +272,11 @@ void ex_point_light_destroy(ex_point_light_t *l)
 {
   glDeleteFramebuffers(1, &l->depth_map_fbo);
   glDeleteTextures(1, &l->depth_map);
+  if (l->dynamic_depth_map) {
+    glDeleteFramebuffers(1, &l->dynamic_depth_map_fbo);
+    glDeleteTextures(1, &l->dynamic_depth_map);
+  }
+  free(l->casters[EX_POINT_STATIC]);
+  free(l->casters[EX_POINT_DYNAMIC]);
   free(l);
 }
\ No newline at end of file
@@ -5,18 +5,43 @@
   Shadows are cast using geometry shaders
   to reduce the amount of draw calls per
   light source.
+
+  Each light keeps the list of casters
+  in reach, and which cube faces each
+  one touches, so only those get drawn.
+  The cube map is only redrawn when the
+  light moves or a caster in reach changes.
+
+  Dynamic lights with both static and
+  dynamic casters in reach split them
+  over two cube maps, the shaders take
+  the closest of the two.  A character
+  walking past then only redraws its
+  own map, not the whole level.
 */
 
 #ifndef EX_POINTLIGHT_H
 #define EX_POINTLIGHT_H
 
+#include <stddef.h>
+#include <inttypes.h>
 #include "mathlib.h"
+#include "frustum.h"
+#include "pool.h"
 
 #define GLEW_STATIC
 #include <GL/glew.h>
 
 #define EX_POINT_FAR_PLANE 60
 #define EX_POINT_SHADOW_DIST 150
+#define EX_POINT_ALL_FACES 63
+
+// caster lists and cube maps
+#define EX_POINT_STATIC 0
+#define EX_POINT_DYNAMIC 1
+#define EX_POINT_STATIC_MAP (1 << EX_POINT_STATIC)
+#define EX_POINT_DYNAMIC_MAP (1 << EX_POINT_DYNAMIC)
+#define EX_POINT_DYNAMIC_UNIT 8
 
 /*
   The shadow map resolution, this
@@ -26,14 +51,50 @@
 */
 #define SHADOW_MAP_SIZE 1024
 
+typedef struct {
+  ex_handle_t handle; // into the scene models
+  uint32_t version;
+  uint8_t faces; // a bit per cube face
+} ex_point_caster_t;
+
+typedef struct {
+  float *center[3], *half[3];
+  const ex_handle_t *handles;
+  const uint32_t *versions;
+  const uint8_t *is_static;
+  size_t count;
+  uint32_t version; // bumped whenever anything above changes
+} ex_point_casters_t;
+
 typedef struct {
   vec3 position, color;
   mat4x4 transform[6];
   GLuint depth_map, depth_map_fbo, shader;
   int dynamic, update, is_shadow, is_visible;
   float distance_to_cam;
+
+  // casters as of the last depth map render
+  ex_point_caster_t *casters[2];
+  size_t casters_len[2], casters_cap[2];
+  uint32_t casters_version;
+  vec3 casters_position;
+
+  // dynamic casters go here when split
+  int split;
+  GLuint dynamic_depth_map, dynamic_depth_map_fbo;
 } ex_point_light_t;
 
+/**
+ * [ex_point_light_radius distance past which the light adds under 1/256]
+ * @param  l [the pointlight]
+ * @return   [the radius, matches the shader attenuation]
+ */
+static inline float ex_point_light_radius(ex_point_light_t *l)
+{
+  float c = fmaxf(fmaxf(l->color[0], l->color[1]), l->color[2]);
+  return EX_POINT_FAR_PLANE * sqrtf(fmaxf(c, 0.0f));
+}
+
 /**
  * [ex_point_light_init init the pointlight module]
  */
@@ -48,11 +109,23 @@ void ex_point_light_init();
  */
 ex_point_light_t *ex_point_light_new(vec3 pos, vec3 color, int dynamic);
 
+/**
+ * [ex_point_light_cull_casters find the casters each cube face sees]
+ * @param  l       [pointlight to use]
+ * @param  casters [every shadow caster in the scene]
+ * @return         [EX_POINT_*_MAP bits of the cube maps to redraw]
+ *
+ * Only call this when the returned maps will
+ * be redrawn, the lists are what was drawn.
+ */
+int ex_point_light_cull_casters(ex_point_light_t *l, ex_point_casters_t *casters);
+
 /**
  * [ex_point_light_begin set as rendertarget]
- * @param l [pointlight to use]
+ * @param l   [pointlight to use]
+ * @param map [EX_POINT_STATIC or EX_POINT_DYNAMIC]
  */
-void ex_point_light_begin(ex_point_light_t *l);
+void ex_point_light_begin(ex_point_light_t *l, int map);
 
 /**
  * [ex_point_light_draw render the depth map, light values etc]
@@ -0,0 +1,94 @@
+#include "pool.h"
+#include <stdlib.h>
+#include <string.h>
+
+void ex_pool_init(ex_pool_t *p)
+{
+  memset(p, 0, sizeof(ex_pool_t));
+}
+
+static inline ex_handle_t ex_pool_make(uint32_t slot, uint32_t generation)
+{
+  return ((ex_handle_t)generation << 32) | slot;
+}
+
+ex_handle_t ex_pool_add(ex_pool_t *p, void *item)
+{
+  // slots only grow with items, so both share cap
+  if (p->len >= p->cap) {
+    p->cap = p->cap ? p->cap * 2 : 64;
+    p->items            = realloc(p->items, sizeof(void*) * p->cap);
+    p->item_slots       = realloc(p->item_slots, sizeof(uint32_t) * p->cap);
+    p->slot_items       = realloc(p->slot_items, sizeof(uint32_t) * p->cap);
+    p->slot_generations = realloc(p->slot_generations, sizeof(uint32_t) * p->cap);
+    p->free_slots       = realloc(p->free_slots, sizeof(uint32_t) * p->cap);
+  }
+
+  uint32_t slot;
+  if (p->free_len) {
+    slot = p->free_slots[--p->free_len];
+  } else {
+    slot = p->slots_len++;
+    p->slot_generations[slot] = 1;
+  }
+
+  uint32_t index = p->len++;
+  p->items[index]      = item;
+  p->item_slots[index] = slot;
+  p->slot_items[slot]  = index;
+
+  return ex_pool_make(slot, p->slot_generations[slot]);
+}
+
+static inline int ex_pool_valid(ex_pool_t *p, ex_handle_t h)
+{
+  uint32_t slot = (uint32_t)h;
+  return slot < p->slots_len && p->slot_generations[slot] == (uint32_t)(h >> 32);
+}
+
+void* ex_pool_get(ex_pool_t *p, ex_handle_t h)
+{
+  if (!ex_pool_valid(p, h))
+    return NULL;
+
+  return p->items[p->slot_items[(uint32_t)h]];
+}
+
+void* ex_pool_remove(ex_pool_t *p, ex_handle_t h)
+{
+  if (!ex_pool_valid(p, h))
+    return NULL;
+
+  uint32_t slot  = (uint32_t)h;
+  uint32_t index = p->slot_items[slot];
+  void *item = p->items[index];
+
+  // move the last item into the hole
+  uint32_t last = --p->len;
+  p->items[index]      = p->items[last];
+  p->item_slots[index] = p->item_slots[last];
+  p->slot_items[p->item_slots[index]] = index;
+
+  // skip 0 so no handle is ever EX_HANDLE_NONE
+  if (++p->slot_generations[slot] == 0)
+    p->slot_generations[slot] = 1;
+  p->free_slots[p->free_len++] = slot;
+
+  return item;
+}
+
+ex_handle_t ex_pool_handle(ex_pool_t *p, size_t index)
+{
+  uint32_t slot = p->item_slots[index];
+  return ex_pool_make(slot, p->slot_generations[slot]);
+}
+
+void ex_pool_free(ex_pool_t *p)
+{
+  free(p->items);
+  free(p->item_slots);
+  free(p->slot_items);
+  free(p->slot_generations);
+  free(p->free_slots);
+  ex_pool_init(p);
+}
@@ -0,0 +1,85 @@
+/* pool
+  A growable array of pointers, kept
+  dense so looping only touches live
+  items, with generation checked handles.
+
+  Removing swaps the last item into the
+  hole, so items move around.  Handles
+  name a slot instead, which tracks where
+  its item went.  Each slot counts how
+  often it was reused, a handle to a
+  removed item finds nothing instead of
+  whatever took its slot.
+*/
+
+#ifndef EX_POOL_H
+#define EX_POOL_H
+
+#include <stddef.h>
+#include <inttypes.h>
+
+// generation in the high bits, slot in the low
+typedef uint64_t ex_handle_t;
+
+// never returned by ex_pool_add
+#define EX_HANDLE_NONE 0
+
+typedef struct {
+  // live items, packed at the front
+  void **items;
+  uint32_t *item_slots;
+  size_t len, cap;
+
+  // per slot, the item index and generation
+  uint32_t *slot_items, *slot_generations;
+  uint32_t *free_slots;
+  size_t slots_len, free_len;
+} ex_pool_t;
+
+/**
+ * [ex_pool_init setup an empty pool]
+ * @param p [the pool]
+ */
+void ex_pool_init(ex_pool_t *p);
+
+/**
+ * [ex_pool_add add an item, growing if needed]
+ * @param  p    [the pool]
+ * @param  item [the item]
+ * @return      [handle to the item]
+ */
+ex_handle_t ex_pool_add(ex_pool_t *p, void *item);
+
+/**
+ * [ex_pool_get look up an item]
+ * @param  p [the pool]
+ * @param  h [the handle]
+ * @return   [the item, NULL if it was removed]
+ */
+void* ex_pool_get(ex_pool_t *p, ex_handle_t h);
+
+/**
+ * [ex_pool_remove remove an item in constant time]
+ * @param  p [the pool]
+ * @param  h [the handle]
+ * @return   [the removed item, NULL if already removed]
+ *
+ * The last item takes the removed items index.
+ */
+void* ex_pool_remove(ex_pool_t *p, ex_handle_t h);
+
+/**
+ * [ex_pool_handle handle of the item at an index]
+ * @param  p     [the pool]
+ * @param  index [index into p->items]
+ * @return       [the handle]
+ */
+ex_handle_t ex_pool_handle(ex_pool_t *p, size_t index);
+
+/**
+ * [ex_pool_free release the pools memory, not the items]
+ * @param p [the pool]
+ */
+void ex_pool_free(ex_pool_t *p);
+
+#endif // EX_POOL_H
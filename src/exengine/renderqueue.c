@@ -0,0 +1,184 @@
+#include "renderqueue.h"
+#include "defaults.h"
+#include "shader.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define EX_RENDER_NONE 0xFFFFFFFFu
+
+ex_render_queue_t* ex_render_queue_new()
+{
+  ex_render_queue_t *q = calloc(1, sizeof(ex_render_queue_t));
+  return q;
+}
+
+void ex_render_queue_clear(ex_render_queue_t *q)
+{
+  q->items_len = 0;
+  q->skinned   = 0;
+}
+
+static inline uint64_t ex_render_field(uint64_t value, int bits, int shift)
+{
+  return (value & ((1ull << bits) - 1)) << shift;
+}
+
+void ex_render_queue_add(ex_render_queue_t *q, ex_model_t *m, GLuint shader)
+{
+  // every skinned model has its own bones to upload
+  uint32_t skin = 0;
+  if (m->bones != NULL && m->current_anim != NULL)
+    skin = ++q->skinned;
+
+  for (int i=0; i<EX_MODEL_MAX_MESHES; i++) {
+    ex_mesh_t *mesh = m->meshes[i];
+    if (mesh == NULL)
+      continue;
+
+    if (q->items_len >= q->items_cap) {
+      q->items_cap = q->items_cap ? q->items_cap * 2 : 256;
+      q->items     = realloc(q->items, sizeof(ex_render_item_t) * q->items_cap);
+    }
+
+    ex_render_item_t *item = &q->items[q->items_len];
+    item->index       = q->items_len++;
+    item->shader      = shader;
+    item->vao         = mesh->VAO;
+    item->ebo         = mesh->EBO;
+    item->icount      = mesh->icount;
+    item->model       = m;
+    item->textures[0] = mesh->texture      < 1 ? default_texture_diffuse  : mesh->texture;
+    item->textures[1] = mesh->texture_spec < 1 ? default_texture_specular : mesh->texture_spec;
+    item->textures[2] = mesh->texture_norm < 1 ? default_texture_normal   : mesh->texture_norm;
+
+    int shift = 0;
+    item->key  = ex_render_field(item->vao, EX_RENDER_VAO_BITS, shift);
+    shift += EX_RENDER_VAO_BITS;
+    item->key |= ex_render_field(item->textures[2], EX_RENDER_NORM_BITS, shift);
+    shift += EX_RENDER_NORM_BITS;
+    item->key |= ex_render_field(item->textures[1], EX_RENDER_SPEC_BITS, shift);
+    shift += EX_RENDER_SPEC_BITS;
+    item->key |= ex_render_field(item->textures[0], EX_RENDER_DIFFUSE_BITS, shift);
+    shift += EX_RENDER_DIFFUSE_BITS;
+    item->key |= ex_render_field(skin, EX_RENDER_SKIN_BITS, shift);
+    shift += EX_RENDER_SKIN_BITS;
+    item->key |= ex_render_field(shader, EX_RENDER_SHADER_BITS, shift);
+  }
+}
+
+static int ex_render_item_cmp(const void *a, const void *b)
+{
+  const ex_render_item_t *x = a, *y = b;
+  if (x->key != y->key)
+    return x->key < y->key ? -1 : 1;
+
+  return (x->index > y->index) - (x->index < y->index);
+}
+
+void ex_render_queue_sort(ex_render_queue_t *q)
+{
+  qsort(q->items, q->items_len, sizeof(ex_render_item_t), ex_render_item_cmp);
+}
+
+void ex_render_queue_submit(ex_render_queue_t *q)
+{
+  static const char *samplers[3] = {"u_texture", "u_spec", "u_norm"};
+  ex_render_stats_t *st = &q->stats;
+  memset(st, 0, sizeof(ex_render_stats_t));
+
+  GLuint program = EX_RENDER_NONE, vao = EX_RENDER_NONE;
+  GLuint textures[3] = {EX_RENDER_NONE, EX_RENDER_NONE, EX_RENDER_NONE};
+  GLint unit = -1, has_skeleton = -1, is_lit = -1;
+  ex_model_t *bones = NULL;
+
+  for (size_t i=0; i<q->items_len; i++) {
+    ex_render_item_t *item = &q->items[i];
+    ex_model_t *m = item->model;
+
+    // program, the samplers and uniforms are per program
+    if (item->shader != program) {
+      program = item->shader;
+      glUseProgram(program);
+      for (int j=0; j<3; j++)
+        glUniform1i(ex_uniform(program, samplers[j]), 4+j);
+
+      has_skeleton = is_lit = -1;
+      bones = NULL;
+      st->programs++;
+      st->uniforms += 3;
+    } else {
+      st->programs_skipped++;
+      st->uniforms_skipped += 3;
+    }
+
+    // bone data, once per skinned model
+    GLint skinned = m->bones != NULL && m->current_anim != NULL;
+    if (skinned != has_skeleton) {
+      has_skeleton = skinned;
+      glUniform1i(ex_uniform(program, "u_has_skeleton"), skinned);
+      st->uniforms++;
+    } else {
+      st->uniforms_skipped++;
+    }
+
+    if (skinned && bones != m) {
+      bones = m;
+      glUniformMatrix4fv(ex_uniform(program, "u_bone_matrix"), m->bones_len, GL_TRUE, &m->skeleton[0][0][0]);
+      st->uniforms++;
+    } else if (skinned) {
+      st->uniforms_skipped++;
+    }
+
+    if (m->is_lit != is_lit) {
+      is_lit = m->is_lit;
+      glUniform1i(ex_uniform(program, "u_is_lit"), is_lit);
+      st->uniforms++;
+    } else {
+      st->uniforms_skipped++;
+    }
+
+    // the vao holds the instance buffers, the element
+    // buffer is bound again in case anything detached it
+    if (item->vao != vao) {
+      vao = item->vao;
+      glBindVertexArray(vao);
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, item->ebo);
+      st->vaos++;
+    } else {
+      st->vaos_skipped++;
+    }
+
+    for (int j=0; j<3; j++) {
+      if (item->textures[j] == textures[j]) {
+        st->textures_skipped++;
+        continue;
+      }
+
+      if (unit != 4+j) {
+        unit = 4+j;
+        glActiveTexture(GL_TEXTURE0 + unit);
+      }
+      textures[j] = item->textures[j];
+      glBindTexture(GL_TEXTURE_2D, textures[j]);
+      st->textures++;
+    }
+
+    glDrawElementsInstanced(GL_TRIANGLES, item->icount, GL_UNSIGNED_INT, 0, m->instance_count);
+    st->draws++;
+  }
+
+  // leave things as ex_mesh_draw does
+  for (int j=0; j<3; j++) {
+    if (textures[j] != EX_RENDER_NONE) {
+      glActiveTexture(GL_TEXTURE4 + j);
+      glBindTexture(GL_TEXTURE_2D, 0);
+    }
+  }
+  glBindVertexArray(0);
+}
+
+void ex_render_queue_destroy(ex_render_queue_t *q)
+{
+  free(q->items);
+  free(q);
+}
@@ -0,0 +1,102 @@
+/* renderqueue
+  Collects a frames mesh draws, sorts
+  them by a packed 64 bit key and submits
+  them skipping redundant gl state.
+
+  From the most significant bits down the
+  key holds the shader, the skinned model,
+  the three textures and the vao.  So draws
+  sharing a program stay together, bone
+  matrices go up once per skinned model,
+  and texture binds are shared where they
+  can be.  Key fields are truncated gl
+  names, they only order the draws, the
+  state filter compares the real values.
+
+  Building and sorting doesnt touch gl,
+  only submitting does.  Models instance
+  data has to be uploaded before submit,
+  see ex_model_upload.
+*/
+
+#ifndef EX_RENDERQUEUE_H
+#define EX_RENDERQUEUE_H
+
+#include <stddef.h>
+#include <inttypes.h>
+#include "model.h"
+
+#define EX_RENDER_SHADER_BITS  8
+#define EX_RENDER_SKIN_BITS    12
+#define EX_RENDER_DIFFUSE_BITS 12
+#define EX_RENDER_SPEC_BITS    8
+#define EX_RENDER_NORM_BITS    8
+#define EX_RENDER_VAO_BITS     16
+
+typedef struct {
+  uint64_t key;
+  uint32_t index; // add order, breaks ties
+  GLuint shader, vao, ebo, textures[3];
+  GLsizei icount;
+  ex_model_t *model;
+} ex_render_item_t;
+
+typedef struct {
+  // gl calls made and skipped by the last submit
+  uint32_t draws, programs, vaos, textures, uniforms;
+  uint32_t programs_skipped, vaos_skipped, textures_skipped, uniforms_skipped;
+} ex_render_stats_t;
+
+typedef struct {
+  ex_render_item_t *items;
+  size_t items_len, items_cap;
+
+  // skinned models get their own key range
+  uint32_t skinned;
+
+  ex_render_stats_t stats;
+} ex_render_queue_t;
+
+/**
+ * [ex_render_queue_new create an empty queue]
+ * @return [the new queue]
+ */
+ex_render_queue_t* ex_render_queue_new();
+
+/**
+ * [ex_render_queue_clear drop last frames draws]
+ * @param q [the queue]
+ */
+void ex_render_queue_clear(ex_render_queue_t *q);
+
+/**
+ * [ex_render_queue_add add a draw for every mesh of a model]
+ * @param q      [the queue]
+ * @param m      [the model]
+ * @param shader [the program to draw with]
+ */
+void ex_render_queue_add(ex_render_queue_t *q, ex_model_t *m, GLuint shader);
+
+/**
+ * [ex_render_queue_sort order the draws by key]
+ * @param q [the queue]
+ */
+void ex_render_queue_sort(ex_render_queue_t *q);
+
+/**
+ * [ex_render_queue_submit issue the sorted draws]
+ * @param q [the queue]
+ *
+ * Can be called more than once a frame, for
+ * each light pass.  Sets q->stats, and leaves
+ * no vao or textures bound.
+ */
+void ex_render_queue_submit(ex_render_queue_t *q);
+
+/**
+ * [ex_render_queue_destroy cleanup the queue]
+ * @param q [the queue to destroy]
+ */
+void ex_render_queue_destroy(ex_render_queue_t *q);
+
+#endif // EX_RENDERQUEUE_H
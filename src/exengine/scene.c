@@ -8,6 +8,7 @@
 #include "window.h"
 #include "dbgui.h"
 #include "sound.h"
+#include "jobs.h"
 #include "ssao.h"
 
 ex_scene_t* ex_scene_new(uint8_t flags)
@@ -17,24 +18,57 @@ ex_scene_t* ex_scene_new(uint8_t flags)
   // renderer features
   s->ssao     = 0;
   s->deferred = 0;
-
-  // init framebuffers etc
-  s->framebuffer = ex_framebuffer_new(0, 0);
-
-  // init lights
-  ex_point_light_init();
-  for (int i=0; i<EX_MAX_POINT_LIGHTS; i++)
-    s->point_lights[i] = NULL;
+  s->bvh      = (flags & EX_SCENE_BVH) ? 1 : 0;
+
+  s->framebuffer = NULL;
+  ex_pool_init(&s->models);
+  ex_pool_init(&s->point_lights);
+  ex_pool_init(&s->spot_lights);
+  ex_pool_init(&s->reflection_probes);
+
+  // culling arrays grow on the first cull
+  for (int i=0; i<3; i++) {
+    s->model_center[i]  = s->model_half[i]  = NULL;
+    s->caster_center[i] = s->caster_half[i] = NULL;
+    s->light_center[i]  = NULL;
+  }
+  s->visible_models  = s->visible_lights = NULL;
+  s->light_radius    = NULL;
+  s->caster_handles  = NULL;
+  s->caster_versions = NULL;
+  s->caster_static   = NULL;
+  s->models_cap = s->lights_cap = 0;
+  s->visible_models_len = 0;
+  s->casters_len        = 0;
+  s->caster_version     = 0;
+  s->cluster = ex_cluster_new();
+  s->queue   = ex_render_queue_new();
+  s->instances = NULL;
+  memset(&s->anim_scratch, 0, sizeof(ex_model_anim_scratch_t));
 
   // init physics shiz
   memset(s->gravity, 0, sizeof(vec3));
-  s->coll_tree = ex_octree_new(OBJ_TYPE_UINT);
+  s->coll_tree = NULL;
+  s->coll_bvh  = NULL;
+  memset(&s->coll_cache, 0, sizeof(ex_coll_cache_t));
   s->coll_list = list_new();
   s->coll_vertices   = NULL;
   s->collision_built = 0;
+  s->coll_version    = 0;
   s->coll_vertices_last = 0;
-  memset(s->coll_tree->region.min, 0, sizeof(vec3));
-  memset(s->coll_tree->region.max, 0, sizeof(vec3));
+  vec3 dyn_center = {0.0f, 0.0f, 0.0f};
+  s->dyn_tree = ex_loose_octree_new(dyn_center, EX_SCENE_DYNAMIC_SIZE);
+  ex_pool_init(&s->colliders);
+
+  if (flags & EX_SCENE_HEADLESS)
+    return s;
+
+  // init framebuffers etc
+  s->framebuffer = ex_framebuffer_new(0, 0);
+  s->instances   = ex_instance_ring_new(EX_INSTANCE_REGION_SIZE);
+
+  // init lights
+  ex_point_light_init();
 
   // init debug gui
   ex_dbgui_init(s);
@@ -58,9 +92,6 @@ ex_scene_t* ex_scene_new(uint8_t flags)
     s->defaultshader = s->forwardshader;
   }
 
-  for (int i=0; i<EX_SCENE_MAX_MODELS; i++)
-    s->models[i] = NULL;
-
   return s;
 }
 
@@ -69,116 +100,557 @@ void ex_scene_add_collision(ex_scene_t *s, ex_model_t *model)
   if (model != NULL) {
     if (model->vertices != NULL && model->num_vertices > 0) {
       list_add(s->coll_list, (void*)model);
-      s->collision_built = 0;
-
-      if (s->coll_vertices != NULL) {
-        size_t len = model->num_vertices + s->coll_vertices_last;
-        s->coll_vertices = realloc(s->coll_vertices, sizeof(vec3)*len);
-        memcpy(&s->coll_vertices[s->coll_vertices_last], &model->vertices[0], sizeof(vec3)*model->num_vertices);
-        s->coll_vertices_last = len;
-      } else {
-        s->coll_vertices = malloc(sizeof(vec3)*model->num_vertices);
-        memcpy(&s->coll_vertices[0], &model->vertices[0], sizeof(vec3)*model->num_vertices);
-        s->coll_vertices_last = model->num_vertices;
-      }
+      ex_scene_add_collision_vertices(s, model->vertices, model->num_vertices);
 
       free(model->vertices);
       model->vertices     = NULL;
       model->num_vertices = 0;
-      s->collision_built  = 0;
     }
   }
 }
 
+void ex_scene_add_collision_vertices(ex_scene_t *s, vec3 *vertices, size_t len)
+{
+  if (vertices == NULL || len == 0)
+    return;
+
+  s->coll_vertices = realloc(s->coll_vertices, sizeof(vec3)*(s->coll_vertices_last + len));
+  memcpy(&s->coll_vertices[s->coll_vertices_last], &vertices[0], sizeof(vec3)*len);
+  s->coll_vertices_last += len;
+  s->collision_built = 0;
+}
+
 void ex_scene_build_collision(ex_scene_t *s)
 {
   // destroy and reconstruct tree
-  if (s->coll_tree->built)
-    s->coll_tree = ex_octree_reset(s->coll_tree);
+  if (s->coll_tree != NULL) {
+    ex_octree_compact_destroy(s->coll_tree);
+    s->coll_tree = NULL;
+  }
+  if (s->coll_bvh != NULL) {
+    ex_bvh_destroy(s->coll_bvh);
+    s->coll_bvh = NULL;
+  }
+  ex_coll_cache_destroy(&s->coll_cache);
+  s->coll_version++;
 
-  if (s->coll_tree == NULL || s->coll_vertices == NULL || s->coll_vertices_last == 0)
+  if (s->coll_vertices == NULL || s->coll_vertices_last == 0)
     return;
 
-  ex_rect_t region;
-  memcpy(&region, &s->coll_tree->region, sizeof(ex_rect_t));
-  for (int i=0; i<s->coll_vertices_last; i+=3) {
-    vec3 tri[3];
-    memcpy(tri[0], s->coll_vertices[i+0], sizeof(vec3));
-    memcpy(tri[1], s->coll_vertices[i+1], sizeof(vec3));
-    memcpy(tri[2], s->coll_vertices[i+2], sizeof(vec3));
+  // one box per triangle, partitioned in place by the build
+  size_t len = s->coll_vertices_last / 3;
+  ex_rect_t *boxes = malloc(sizeof(ex_rect_t) * len);
+  uint32_t  *data  = malloc(sizeof(uint32_t) * len);
 
-    vec3_min(region.min, region.min, tri[0]);
-    vec3_min(region.min, region.min, tri[1]);
-    vec3_min(region.min, region.min, tri[2]);
-    vec3_max(region.max, region.max, tri[0]);
-    vec3_max(region.max, region.max, tri[1]);
-    vec3_max(region.max, region.max, tri[2]);
+  ex_rect_t region;
+  memset(&region, 0, sizeof(ex_rect_t));
+  for (size_t i=0; i<len; i++) {
+    vec3 *tri = &s->coll_vertices[i*3];
+    boxes[i]  = ex_rect_from_triangle(tri);
+    data[i]   = i*3;
+
+    vec3_min(region.min, region.min, boxes[i].min);
+    vec3_max(region.max, region.max, boxes[i].max);
+  }
 
-    ex_octree_obj_t *obj = malloc(sizeof(ex_octree_obj_t));
+  if (s->bvh)
+    s->coll_bvh = ex_bvh_build(boxes, data, len);
+  else
+    s->coll_tree = ex_octree_compact_build_parallel(region, boxes, data, len);
 
-    obj->data_uint    = i;
-    obj->box          = ex_rect_from_triangle(tri);
-    list_add(s->coll_tree->obj_list, (void*)obj);
-  }
+  free(boxes);
+  free(data);
 
-  memcpy(&s->coll_tree->region, &region, sizeof(ex_rect_t));
-  ex_octree_build(s->coll_tree);
+  ex_coll_cache_build(&s->coll_cache, s->coll_vertices, len);
 
   s->collision_built = 1;
 }
 
-void ex_scene_add_model(ex_scene_t *s, ex_model_t *m)
+void ex_scene_query_collision(ex_scene_t *s, ex_rect_t *bounds, ex_query_buffer_t *out)
+{
+  if (s->bvh)
+    ex_bvh_query(s->coll_bvh, bounds, out);
+  else
+    ex_octree_compact_query(s->coll_tree, bounds, out);
+}
+
+typedef struct {
+  ex_scene_t *s;
+  vec3 from, dir;
+  float dist;
+  int tri;
+  ex_collider_t *collider;
+} ex_scene_ray_t;
+
+static float ex_scene_ray_leaf(void *data, uint32_t *items, size_t len, float max)
 {
-  for (int i=0; i<EX_SCENE_MAX_MODELS; i++) {
-    if (s->models[i] == NULL) {
-      s->models[i] = m;
-      return;
+  ex_scene_ray_t *r = data;
+  int i = ex_ray_check_triangles(r->from, r->dir, r->s->coll_vertices, items, len, &max);
+  if (i >= 0) {
+    r->tri  = items[i] / 3;
+    r->dist = max;
+  }
+
+  return max;
+}
+
+static float ex_scene_ray_collider(void *data, uint32_t *items, size_t len, float max)
+{
+  ex_scene_ray_t *r = data;
+  for (size_t i=0; i<len; i++) {
+    ex_collider_t *c = r->s->colliders.items[items[i]];
+    int tri = ex_ray_check_triangles(r->from, r->dir, c->world, NULL, c->len / 3, &max);
+    if (tri >= 0) {
+      r->tri      = tri;
+      r->dist     = max;
+      r->collider = c;
     }
   }
 
-  printf("Maximum scene model count exceeded!\n");
+  return max;
 }
 
-void ex_scene_remove_model(ex_scene_t *s, ex_model_t *m)
+static void ex_scene_raycast_single(ex_scene_t *s, ex_ray_t *ray, ex_ray_hit_t *hit)
 {
-  for (int i=0; i<EX_SCENE_MAX_MODELS; i++) {
-    if (s->models[i] == m) {
-      s->models[i] = NULL;
-      return;
+  hit->hit      = 0;
+  hit->dist     = 0.0f;
+  hit->tri      = -1;
+  hit->collider = NULL;
+
+  float len = vec3_len(ray->to);
+  if (len <= 0.0f)
+    return;
+
+  // unit direction, so distances are world units
+  ex_scene_ray_t r;
+  r.s    = s;
+  r.dist = len;
+  r.tri  = -1;
+  r.collider = NULL;
+  memcpy(r.from, ray->from, sizeof(vec3));
+  vec3_scale(r.dir, ray->to, 1.0f / len);
+
+  if (s->bvh)
+    ex_bvh_raycast(s->coll_bvh, r.from, r.dir, r.dist, ex_scene_ray_leaf, &r);
+  else
+    ex_octree_compact_raycast(s->coll_tree, r.from, r.dir, r.dist, ex_scene_ray_leaf, &r);
+
+  // dynamic colliders, only past the static hit
+  ex_loose_octree_raycast(s->dyn_tree, r.from, r.dir, r.dist, ex_scene_ray_collider, &r);
+
+  if (r.tri < 0)
+    return;
+
+  hit->hit      = 1;
+  hit->dist     = r.dist;
+  hit->tri      = r.tri;
+  hit->collider = r.collider;
+  if (hit->collider == NULL) {
+    // static geometry, the plane is cached
+    memcpy(hit->plane.origin, s->coll_vertices[r.tri*3], sizeof(vec3));
+    for (int i=0; i<3; i++) {
+      hit->plane.normal[i]   = s->coll_cache.normal[i][r.tri];
+      hit->plane.equation[i] = s->coll_cache.normal[i][r.tri];
     }
+    hit->plane.equation[3] = s->coll_cache.d[r.tri];
+  } else {
+    vec3 *v = &hit->collider->world[r.tri*3];
+    hit->plane = ex_triangle_to_plane(v[0], v[1], v[2]);
+  }
+}
+
+typedef struct {
+  ex_scene_t *s;
+  ex_ray_t *rays;
+  ex_ray_hit_t *hits;
+  size_t count;
+} ex_scene_ray_batch_t;
+
+static void ex_scene_raycast_job(void *data, size_t index)
+{
+  ex_scene_ray_batch_t *batch = data;
+  size_t first = index * EX_SCENE_RAY_JOB_SIZE;
+  size_t last  = MIN(first + EX_SCENE_RAY_JOB_SIZE, batch->count);
+  for (size_t i=first; i<last; i++)
+    ex_scene_raycast_single(batch->s, &batch->rays[i], &batch->hits[i]);
+}
+
+void ex_scene_raycast(ex_scene_t *s, ex_ray_t *rays, ex_ray_hit_t *hits, size_t count)
+{
+  ex_scene_ray_batch_t batch = {s, rays, hits, count};
+  ex_jobs_run(ex_scene_raycast_job, &batch, (count + EX_SCENE_RAY_JOB_SIZE - 1) / EX_SCENE_RAY_JOB_SIZE);
+}
+
+enum {
+  EX_SCENE_SPHERE,
+  EX_SCENE_AABB,
+  EX_SCENE_CAPSULE
+};
+
+typedef struct {
+  ex_scene_t *s;
+  int shape;
+  vec3 a, b;    // sphere center, box center and half extents, capsule segment
+  float radius;
+  vec3 motion;
+  ex_contact_t *contacts;
+  size_t len, max;
+  ex_coll_packet_t *packet;
+} ex_scene_shape_t;
+
+static void ex_scene_visit_collision(ex_scene_t *s, ex_rect_t *bounds, ex_visit_func_t func, void *data)
+{
+  if (s->bvh)
+    ex_bvh_visit(s->coll_bvh, bounds, func, data);
+  else
+    ex_octree_compact_visit(s->coll_tree, bounds, func, data);
+}
+
+static inline void ex_scene_shape_bounds(ex_scene_shape_t *q, ex_rect_t *r)
+{
+  switch (q->shape) {
+    case EX_SCENE_SPHERE:
+      for (int i=0; i<3; i++) {
+        r->min[i] = q->a[i] - q->radius;
+        r->max[i] = q->a[i] + q->radius;
+      }
+      break;
+    case EX_SCENE_AABB:
+      vec3_sub(r->min, q->a, q->b);
+      vec3_add(r->max, q->a, q->b);
+      break;
+    case EX_SCENE_CAPSULE:
+      for (int i=0; i<3; i++) {
+        r->min[i] = MIN(q->a[i], q->b[i]) - q->radius;
+        r->max[i] = MAX(q->a[i], q->b[i]) + q->radius;
+      }
+      break;
+  }
+
+  // sweeps cover the whole path
+  for (int i=0; i<3; i++) {
+    if (q->motion[i] < 0.0f)
+      r->min[i] += q->motion[i];
+    else
+      r->max[i] += q->motion[i];
   }
 }
 
-void ex_scene_add_pointlight(ex_scene_t *s, ex_point_light_t *pl)
+static int ex_scene_overlap_visit(void *data, uint32_t *items, size_t len)
 {
-  for (int i=0; i<EX_MAX_POINT_LIGHTS; i++) {
-    if (s->point_lights[i] == NULL) {
-      s->point_lights[i] = pl;
-      return;
+  ex_scene_shape_t *q = data;
+  vec3 *vertices = q->s->coll_vertices;
+
+  for (size_t i=0; i<len; i++) {
+    vec3 *tri = &vertices[items[i]];
+    ex_contact_t *c = &q->contacts[q->len];
+    vec3 p;
+
+    if (q->shape == EX_SCENE_AABB) {
+      if (!ex_aabb_triangle(q->a, q->b, tri[0], tri[1], tri[2], c->normal, &c->depth))
+        continue;
+      ex_closest_point_triangle(c->point, q->a, tri[0], tri[1], tri[2]);
+    } else {
+      if (q->shape == EX_SCENE_SPHERE) {
+        memcpy(p, q->a, sizeof(vec3));
+        ex_closest_point_triangle(c->point, p, tri[0], tri[1], tri[2]);
+      } else {
+        ex_closest_segment_triangle(p, c->point, q->a, q->b, tri[0], tri[1], tri[2]);
+      }
+
+      vec3_sub(c->normal, p, c->point);
+      // written so a nan distance is rejected too
+      float dist = vec3_len(c->normal);
+      if (!(dist <= q->radius))
+        continue;
+
+      if (dist > 0.0f) {
+        vec3_scale(c->normal, c->normal, 1.0f / dist);
+      } else {
+        // touching the face, use its plane
+        for (int j=0; j<3; j++)
+          c->normal[j] = q->s->coll_cache.normal[j][items[i]/3];
+      }
+      c->depth = q->radius - dist;
     }
+
+    c->tri = items[i] / 3;
+    c->t   = 0.0f;
+    if (++q->len >= q->max)
+      return 0;
+  }
+
+  return 1;
+}
+
+static size_t ex_scene_overlap(ex_scene_shape_t *q)
+{
+  if (q->max == 0)
+    return 0;
+
+  ex_rect_t r;
+  ex_scene_shape_bounds(q, &r);
+  ex_scene_visit_collision(q->s, &r, ex_scene_overlap_visit, q);
+  return q->len;
+}
+
+size_t ex_scene_overlap_sphere(ex_scene_t *s, vec3 center, float radius, ex_contact_t *contacts, size_t max)
+{
+  ex_scene_shape_t q = {s, EX_SCENE_SPHERE, {0.0f}, {0.0f}, radius, {0.0f}, contacts, 0, max, NULL};
+  memcpy(q.a, center, sizeof(vec3));
+  return ex_scene_overlap(&q);
+}
+
+size_t ex_scene_overlap_aabb(ex_scene_t *s, ex_rect_t *box, ex_contact_t *contacts, size_t max)
+{
+  ex_scene_shape_t q = {s, EX_SCENE_AABB, {0.0f}, {0.0f}, 0.0f, {0.0f}, contacts, 0, max, NULL};
+  vec3_add(q.a, box->min, box->max);
+  vec3_scale(q.a, q.a, 0.5f);
+  vec3_sub(q.b, box->max, box->min);
+  vec3_scale(q.b, q.b, 0.5f);
+  return ex_scene_overlap(&q);
+}
+
+size_t ex_scene_overlap_capsule(ex_scene_t *s, vec3 a, vec3 b, float radius, ex_contact_t *contacts, size_t max)
+{
+  ex_scene_shape_t q = {s, EX_SCENE_CAPSULE, {0.0f}, {0.0f}, radius, {0.0f}, contacts, 0, max, NULL};
+  memcpy(q.a, a, sizeof(vec3));
+  memcpy(q.b, b, sizeof(vec3));
+  return ex_scene_overlap(&q);
+}
+
+static int ex_scene_sweep_visit(void *data, uint32_t *items, size_t len)
+{
+  ex_scene_shape_t *q = data;
+  vec3 *vertices = q->s->coll_vertices;
+
+  if (q->shape == EX_SCENE_SPHERE) {
+    ex_collision_check_triangles(q->packet, vertices, items, len, &q->s->coll_cache);
+    return 1;
+  }
+
+  // contacts holds the best hit so far
+  ex_contact_t *hit = q->contacts;
+  for (size_t i=0; i<len; i++) {
+    vec3 *tri = &vertices[items[i]];
+    float t;
+    vec3 normal;
+    int found;
+    if (q->shape == EX_SCENE_AABB)
+      found = ex_aabb_triangle_sweep(q->a, q->b, q->motion, tri[0], tri[1], tri[2], &t, normal);
+    else
+      found = ex_capsule_triangle_sweep(q->a, q->b, q->radius, q->motion, tri[0], tri[1], tri[2], &t, normal);
+
+    if (!found || (q->len > 0 && t >= hit->t))
+      continue;
+
+    q->len = 1;
+    hit->t   = t;
+    hit->tri = items[i] / 3;
+    memcpy(hit->normal, normal, sizeof(vec3));
   }
 
-  printf("Maximum point lights exceeded!\n");
+  return 1;
 }
 
-void ex_scene_add_spotlight(ex_scene_t *s, ex_spot_light_t *sl)
+static int ex_scene_sweep(ex_scene_shape_t *q)
 {
-  for (int i=0; i<EX_MAX_SPOT_LIGHTS; i++) {
-    if (s->spot_lights[i] == NULL) {
-      s->spot_lights[i] = sl;
-      return;
+  ex_contact_t *hit = q->contacts;
+  ex_rect_t r;
+  ex_scene_shape_bounds(q, &r);
+  ex_scene_visit_collision(q->s, &r, ex_scene_sweep_visit, q);
+
+  if (q->shape == EX_SCENE_SPHERE) {
+    ex_coll_packet_t *p = q->packet;
+    if (!p->found_collision)
+      return 0;
+
+    // back out of ellipsoid space
+    hit->t   = p->t;
+    hit->tri = p->hit_tri;
+    vec3_scale(hit->point, p->intersect_point, q->radius);
+    vec3 center;
+    vec3_scale(center, q->motion, hit->t);
+    vec3_add(center, center, q->a);
+    vec3_sub(hit->normal, center, hit->point);
+    vec3_norm(hit->normal, hit->normal);
+  } else {
+    if (q->len == 0)
+      return 0;
+
+    // closest point on the triangle to the
+    // shape center where they touch
+    vec3 center, move;
+    vec3 *tri = &q->s->coll_vertices[hit->tri*3];
+    if (q->shape == EX_SCENE_AABB) {
+      memcpy(center, q->a, sizeof(vec3));
+    } else {
+      vec3_add(center, q->a, q->b);
+      vec3_scale(center, center, 0.5f);
     }
+    vec3_scale(move, q->motion, hit->t);
+    vec3_add(center, center, move);
+    ex_closest_point_triangle(hit->point, center, tri[0], tri[1], tri[2]);
+  }
+
+  hit->depth = 0.0f;
+  return 1;
+}
+
+int ex_scene_sweep_sphere(ex_scene_t *s, vec3 center, float radius, vec3 motion, ex_contact_t *hit)
+{
+  // the entity sweep needs a direction, without
+  // one any touching triangle is a contact at 0
+  if (vec3_len(motion) <= 0.0f) {
+    if (ex_scene_overlap_sphere(s, center, radius, hit, 1) == 0)
+      return 0;
+
+    hit->t     = 0.0f;
+    hit->depth = 0.0f;
+    return 1;
   }
+
+  // the entity sweep with a round ellipsoid
+  ex_coll_packet_t packet;
+  for (int i=0; i<3; i++) {
+    packet.e_radius[i]     = radius;
+    packet.e_base_point[i] = center[i] / radius;
+    packet.e_velocity[i]   = motion[i] / radius;
+  }
+  vec3_norm(packet.e_norm_velocity, packet.e_velocity);
+  packet.found_collision  = 0;
+  packet.nearest_distance = FLT_MAX;
+  packet.t       = 0.0f;
+  packet.hit_tri = -1;
+
+  ex_scene_shape_t q = {s, EX_SCENE_SPHERE, {0.0f}, {0.0f}, radius, {0.0f}, hit, 0, 1, &packet};
+  memcpy(q.a, center, sizeof(vec3));
+  memcpy(q.motion, motion, sizeof(vec3));
+  return ex_scene_sweep(&q);
+}
+
+int ex_scene_sweep_aabb(ex_scene_t *s, ex_rect_t *box, vec3 motion, ex_contact_t *hit)
+{
+  ex_scene_shape_t q = {s, EX_SCENE_AABB, {0.0f}, {0.0f}, 0.0f, {0.0f}, hit, 0, 1, NULL};
+  vec3_add(q.a, box->min, box->max);
+  vec3_scale(q.a, q.a, 0.5f);
+  vec3_sub(q.b, box->max, box->min);
+  vec3_scale(q.b, q.b, 0.5f);
+  memcpy(q.motion, motion, sizeof(vec3));
+  return ex_scene_sweep(&q);
+}
+
+int ex_scene_sweep_capsule(ex_scene_t *s, vec3 a, vec3 b, float radius, vec3 motion, ex_contact_t *hit)
+{
+  ex_scene_shape_t q = {s, EX_SCENE_CAPSULE, {0.0f}, {0.0f}, radius, {0.0f}, hit, 0, 1, NULL};
+  memcpy(q.a, a, sizeof(vec3));
+  memcpy(q.b, b, sizeof(vec3));
+  memcpy(q.motion, motion, sizeof(vec3));
+  return ex_scene_sweep(&q);
 }
 
-void ex_scene_add_reflection(ex_scene_t *s, ex_reflection_t *r)
+static ex_rect_t ex_scene_transform_collider(ex_collider_t *c, mat4x4 transform)
 {
-  for (int i=0; i<EX_MAX_REFLECTIONS; i++) {
-    if (s->reflection_probes[i] == NULL) {
-      s->reflection_probes[i] = r;
-      return;
+  ex_rect_t box;
+  for (size_t i=0; i<c->len; i++) {
+    vec4 v = {c->vertices[i][0], c->vertices[i][1], c->vertices[i][2], 1.0f}, r;
+    mat4x4_mul_vec4(r, transform, v);
+    memcpy(c->world[i], r, sizeof(vec3));
+
+    if (i == 0) {
+      memcpy(box.min, r, sizeof(vec3));
+      memcpy(box.max, r, sizeof(vec3));
+    } else {
+      vec3_min(box.min, box.min, c->world[i]);
+      vec3_max(box.max, box.max, c->world[i]);
     }
-  } 
+  }
+
+  return box;
+}
+
+ex_collider_t* ex_scene_add_collider(ex_scene_t *s, ex_model_t *m, mat4x4 transform)
+{
+  if (m == NULL || m->vertices == NULL || m->num_vertices < 3)
+    return NULL;
+
+  ex_collider_t *c = malloc(sizeof(ex_collider_t));
+  c->vertices = m->vertices;
+  c->world    = malloc(sizeof(vec3) * m->num_vertices);
+  c->len      = m->num_vertices;
+
+  m->vertices     = NULL;
+  m->num_vertices = 0;
+
+  ex_pool_add(&s->colliders, c);
+  c->index = s->colliders.len - 1;
+
+  ex_rect_t box = ex_scene_transform_collider(c, transform);
+  c->handle = ex_loose_octree_insert(s->dyn_tree, box, c->index);
+  return c;
+}
+
+void ex_scene_move_collider(ex_scene_t *s, ex_collider_t *c, mat4x4 transform)
+{
+  ex_rect_t box = ex_scene_transform_collider(c, transform);
+  ex_loose_octree_move(s->dyn_tree, c->handle, box);
+}
+
+void ex_scene_remove_collider(ex_scene_t *s, ex_collider_t *c)
+{
+  ex_loose_octree_remove(s->dyn_tree, c->handle);
+  ex_pool_remove(&s->colliders, ex_pool_handle(&s->colliders, c->index));
+
+  // the last collider took its place
+  if (c->index < s->colliders.len) {
+    ex_collider_t *moved = s->colliders.items[c->index];
+    moved->index = c->index;
+    ex_loose_octree_set_data(s->dyn_tree, moved->handle, c->index);
+  }
+
+  free(c->vertices);
+  free(c->world);
+  free(c);
+}
+
+ex_handle_t ex_scene_add_model(ex_scene_t *s, ex_model_t *m)
+{
+  return ex_pool_add(&s->models, m);
+}
+
+ex_model_t* ex_scene_remove_model(ex_scene_t *s, ex_handle_t h)
+{
+  return ex_pool_remove(&s->models, h);
+}
+
+ex_handle_t ex_scene_add_pointlight(ex_scene_t *s, ex_point_light_t *pl)
+{
+  return ex_pool_add(&s->point_lights, pl);
+}
+
+ex_point_light_t* ex_scene_remove_pointlight(ex_scene_t *s, ex_handle_t h)
+{
+  return ex_pool_remove(&s->point_lights, h);
+}
+
+ex_handle_t ex_scene_add_spotlight(ex_scene_t *s, ex_spot_light_t *sl)
+{
+  return ex_pool_add(&s->spot_lights, sl);
+}
+
+ex_spot_light_t* ex_scene_remove_spotlight(ex_scene_t *s, ex_handle_t h)
+{
+  return ex_pool_remove(&s->spot_lights, h);
+}
+
+ex_handle_t ex_scene_add_reflection(ex_scene_t *s, ex_reflection_t *r)
+{
+  return ex_pool_add(&s->reflection_probes, r);
+}
+
+ex_reflection_t* ex_scene_remove_reflection(ex_scene_t *s, ex_handle_t h)
+{
+  return ex_pool_remove(&s->reflection_probes, h);
 }
 
 void ex_scene_update(ex_scene_t *s, float delta_time)
@@ -188,15 +660,15 @@ void ex_scene_update(ex_scene_t *s, float delta_time)
   if (!s->collision_built)
     ex_scene_build_collision(s);
 
+  // merge away dynamic nodes that emptied out
+  ex_loose_octree_prune(s->dyn_tree);
+
   // update models animations etc
-  for (int i=0; i<EX_SCENE_MAX_MODELS; i++) {
-    if (s->models[i]) {
-      ex_model_update(s->models[i], delta_time);
-    }
-  }
+  // posed across the job threads
+  ex_model_update_batch(&s->anim_scratch, (ex_model_t **)s->models.items, s->models.len, delta_time);
 
-  // handle light stuffs
-  ex_scene_manage_lights(s);
+  // rebuild moved model matrices once, for culling and drawing
+  ex_model_update_transforms((ex_model_t **)s->models.items, s->models.len);
 
   ex_dbgprofiler.end[ex_dbgprofiler_update] = glfwGetTime();
 }
@@ -206,22 +678,188 @@ void ex_scene_render_depthmaps(ex_scene_t *s)
   // render pointlight depth maps
   glCullFace(GL_BACK);
   ex_dbgprofiler.begin[ex_dbgprofiler_lighting_depth] = glfwGetTime();
-  for (int i=0; i<EX_MAX_POINT_LIGHTS; i++) {
-    ex_point_light_t *l = s->point_lights[i];
-    if (l != NULL && (l->dynamic || l->update) && l->is_shadow && l->is_visible) {
-      ex_point_light_begin(l);
-      ex_scene_render_models(s, l->shader, 1);
+  ex_point_casters_t casters = {
+    .center    = {s->caster_center[0], s->caster_center[1], s->caster_center[2]},
+    .half      = {s->caster_half[0], s->caster_half[1], s->caster_half[2]},
+    .handles   = s->caster_handles,
+    .versions  = s->caster_versions,
+    .is_static = s->caster_static,
+    .count     = s->casters_len,
+    .version   = s->caster_version
+  };
+  for (size_t i=0; i<s->point_lights.len; i++) {
+    ex_point_light_t *l = s->point_lights.items[i];
+    if ((l->dynamic || l->update) && l->is_shadow && l->is_visible) {
+      int maps = ex_point_light_cull_casters(l, &casters);
+
+      // unsplit lights keep everything in the one map
+      if (maps & EX_POINT_STATIC_MAP) {
+        ex_point_light_begin(l, EX_POINT_STATIC);
+        ex_scene_render_casters(s, l, EX_POINT_STATIC);
+        if (!l->split)
+          ex_scene_render_casters(s, l, EX_POINT_DYNAMIC);
+      }
+
+      if (maps & EX_POINT_DYNAMIC_MAP) {
+        ex_point_light_begin(l, EX_POINT_DYNAMIC);
+        ex_scene_render_casters(s, l, EX_POINT_DYNAMIC);
+      }
     }
   }
   ex_dbgprofiler.end[ex_dbgprofiler_lighting_depth] = glfwGetTime();
 }
 
+static void ex_scene_grow(ex_scene_t *s)
+{
+  if (s->models.len > s->models_cap) {
+    size_t cap = s->models.cap;
+    for (int i=0; i<3; i++) {
+      s->model_center[i]  = realloc(s->model_center[i], sizeof(float) * cap);
+      s->model_half[i]    = realloc(s->model_half[i], sizeof(float) * cap);
+      s->caster_center[i] = realloc(s->caster_center[i], sizeof(float) * cap);
+      s->caster_half[i]   = realloc(s->caster_half[i], sizeof(float) * cap);
+    }
+    s->visible_models  = realloc(s->visible_models, sizeof(uint32_t) * cap);
+    s->caster_handles  = realloc(s->caster_handles, sizeof(ex_handle_t) * cap);
+    s->caster_versions = realloc(s->caster_versions, sizeof(uint32_t) * cap);
+    s->caster_static   = realloc(s->caster_static, cap);
+    s->models_cap = cap;
+  }
+
+  if (s->point_lights.len > s->lights_cap) {
+    size_t cap = s->point_lights.cap;
+    for (int i=0; i<3; i++)
+      s->light_center[i] = realloc(s->light_center[i], sizeof(float) * cap);
+    s->light_radius   = realloc(s->light_radius, sizeof(float) * cap);
+    s->visible_lights = realloc(s->visible_lights, sizeof(uint32_t) * cap);
+    s->lights_cap = cap;
+  }
+}
+
+static void ex_scene_update_casters(ex_scene_t *s)
+{
+  // compared as they are written, lights only
+  // look at their own casters when this bumps
+  size_t len = 0;
+  int changed = 0;
+  for (size_t i=0; i<s->models.len; i++) {
+    ex_model_t *m = s->models.items[i];
+    if (!m->is_shadow)
+      continue;
+
+    ex_handle_t handle = ex_pool_handle(&s->models, i);
+    uint8_t is_static  = m->is_static != 0;
+    changed |= len >= s->casters_len || s->caster_handles[len] != handle
+      || s->caster_versions[len] != m->version || s->caster_static[len] != is_static;
+
+    for (int j=0; j<3; j++) {
+      changed |= len >= s->casters_len || s->caster_center[j][len] != s->model_center[j][i]
+        || s->caster_half[j][len] != s->model_half[j][i];
+      s->caster_center[j][len] = s->model_center[j][i];
+      s->caster_half[j][len]   = s->model_half[j][i];
+    }
+    s->caster_handles[len]  = handle;
+    s->caster_versions[len] = m->version;
+    s->caster_static[len]   = is_static;
+    len++;
+  }
+
+  if (changed || len != s->casters_len) {
+    s->casters_len = len;
+    s->caster_version++;
+  }
+}
+
+void ex_scene_cull(ex_scene_t *s, ex_camera_matrices_t *matrices)
+{
+  mat4x4 view_projection;
+  mat4x4_mul(view_projection, matrices->projection, matrices->view);
+  ex_frustum_from_matrix(&s->frustum, view_projection);
+  memcpy(s->camera_position, matrices->inverse_view[3], sizeof(vec3));
+
+  ex_scene_grow(s);
+
+  // models are packed, so the batched
+  // test runs over contiguous arrays
+  size_t len = s->models.len;
+  for (size_t i=0; i<len; i++) {
+    vec3 c, h;
+    ex_model_world_bounds(s->models.items[i], c, h);
+    for (int j=0; j<3; j++) {
+      s->model_center[j][i] = c[j];
+      s->model_half[j][i]   = h[j];
+    }
+  }
+
+  ex_scene_update_casters(s);
+
+  s->visible_models_len = ex_frustum_cull_aabbs(&s->frustum, s->model_center, s->model_half, len, s->visible_models);
+
+  ex_render_queue_clear(s->queue);
+  for (size_t i=0; i<s->visible_models_len; i++) {
+    ex_model_t *m = s->models.items[s->visible_models[i]];
+    ex_render_queue_add(s->queue, m, m->shader);
+  }
+  ex_render_queue_sort(s->queue);
+
+  ex_scene_manage_lights(s);
+}
+
 void ex_scene_draw(ex_scene_t *s, int view_x, int view_y, int view_width, int view_height, ex_camera_matrices_t *matrices)
 {
+  ex_scene_cull(s, matrices);
+
+  // moving models stream into this frames ring region
+  ex_instance_ring = s->instances;
+  if (s->instances != NULL)
+    ex_instance_ring_begin(s->instances);
+
+  // the queue draws without touching instance data
+  for (size_t i=0; i<s->visible_models_len; i++)
+    ex_model_upload(s->models.items[s->visible_models[i]]);
+
   if (s->deferred)
     ex_scene_render_deferred(s, view_x, view_y, view_width, view_height, matrices);
   else
     ex_scene_render_forward(s, view_x, view_y, view_width, view_height, matrices);
+
+  if (s->instances != NULL)
+    ex_instance_ring_end(s->instances);
+  ex_instance_ring = NULL;
+}
+
+void ex_scene_cluster_lights(ex_scene_t *s, ex_camera_matrices_t *matrices)
+{
+  ex_cluster_begin(s->cluster, matrices->view, matrices->projection);
+
+  for (size_t i=0; i<s->point_lights.len; i++) {
+    ex_point_light_t *pl = s->point_lights.items[i];
+    if (!pl->is_visible || pl->is_shadow)
+      continue;
+
+    ex_cluster_add_light(s->cluster, pl->position, pl->color, ex_point_light_radius(pl));
+  }
+
+  ex_cluster_build(s->cluster);
+
+  if (s->framebuffer != NULL)
+    ex_cluster_upload(s->cluster);
+}
+
+static int ex_scene_light_scissor(ex_scene_t *s, ex_point_light_t *pl, GLint *viewport)
+{
+  vec4 view, rect, world = {pl->position[0], pl->position[1], pl->position[2], 1.0f};
+  mat4x4_mul_vec4(view, s->cluster->view, world);
+  if (!ex_cluster_rect(s->cluster, view, ex_point_light_radius(pl), rect))
+    return 0;
+
+  int x0 = floorf((rect[0] * 0.5f + 0.5f) * viewport[2]);
+  int y0 = floorf((rect[1] * 0.5f + 0.5f) * viewport[3]);
+  int x1 = ceilf((rect[2] * 0.5f + 0.5f) * viewport[2]);
+  int y1 = ceilf((rect[3] * 0.5f + 0.5f) * viewport[3]);
+  glScissor(viewport[0] + x0, viewport[1] + y0, x1 - x0, y1 - y0);
+
+  return 1;
 }
 
 void ex_scene_render_deferred(ex_scene_t *s, int view_x, int view_y, int view_width, int view_height, ex_camera_matrices_t *matrices)
@@ -249,7 +887,7 @@ void ex_scene_render_deferred(ex_scene_t *s, int view_x, int view_y, int view_wi
   glUniformMatrix4fv(ex_uniform(ex_gshader, "u_projection"), 1, GL_FALSE, matrices->projection[0]);
   glUniformMatrix4fv(ex_uniform(ex_gshader, "u_view"), 1, GL_FALSE, matrices->view[0]);
   glUniformMatrix4fv(ex_uniform(ex_gshader, "u_inverse_view"), 1, GL_FALSE, matrices->inverse_view[0]);
-  ex_scene_render_models(s, 0, 0);
+  ex_scene_render_visible(s);
 
   // render ssao
   if (s->ssao)
@@ -265,11 +903,17 @@ void ex_scene_render_deferred(ex_scene_t *s, int view_x, int view_y, int view_wi
   glUniformMatrix4fv(ex_uniform(ex_gmainshader, "u_view"), 1, GL_FALSE, matrices->view[0]);
   glUniformMatrix4fv(ex_uniform(ex_gmainshader, "u_inverse_view"), 1, GL_FALSE, matrices->inverse_view[0]);
 
-  // first pass is ambient
+  // bin the non shadow casting lights
+  ex_scene_cluster_lights(s, matrices);
+  ex_cluster_bind(s->cluster, ex_gmainshader);
+
+  // first pass is ambient, plus all non shadow casting
+  // lights, each pixel only loops over its froxels lights
   glDisable(GL_BLEND);
   glCullFace(GL_BACK);
 
   glUniform1i(ex_uniform(ex_gmainshader, "u_ambient_pass"), 1);
+  glUniform1i(ex_uniform(ex_gmainshader, "u_cluster_active"), 1);
   glUniform1i(ex_uniform(ex_gmainshader, "u_point_active"), 0);
 
   if (s->ssao)
@@ -278,36 +922,8 @@ void ex_scene_render_deferred(ex_scene_t *s, int view_x, int view_y, int view_wi
     ssao_bind_default(ex_gmainshader);
   
   ex_gbuffer_render(ex_gmainshader);
-
-  // enable blending for second pass onwards
-  glEnable(GL_BLEND);
-  glBlendFunc(GL_SRC_ALPHA, GL_ONE);
-
-  // do all non shadow casting lights in a single pass
-  // including the one directional light
-  // and lights outside of the shadow render range
-  int pcount = 0;
-  char buff[64];
-  for (int i=0; i<EX_MAX_POINT_LIGHTS; i++) {
-    ex_point_light_t *pl = s->point_lights[i];
-    if (pl == NULL || !pl->is_visible)
-      continue;
-
-    if (!pl->is_shadow) {
-      sprintf(buff, "u_point_lights[%d]", pcount);
-      ex_point_light_draw(pl, ex_gmainshader, buff, 1);
-      pcount++;
-    }
-  }
-
-  glUniform1i(ex_uniform(ex_gmainshader, "u_point_count"), pcount);
   glUniform1i(ex_uniform(ex_gmainshader, "u_ambient_pass"), 0);
-  if (s->ssao)
-    ssao_bind_texture(ex_gmainshader);
-  else
-    ssao_bind_default(ex_gmainshader);
-  ex_gbuffer_render(ex_gmainshader);
-  glUniform1i(ex_uniform(ex_gmainshader, "u_point_count"), 0);
+  glUniform1i(ex_uniform(ex_gmainshader, "u_cluster_active"), 0);
 
   // enable blending for second pass onwards
   glEnable(GL_BLEND);
@@ -315,32 +931,30 @@ void ex_scene_render_deferred(ex_scene_t *s, int view_x, int view_y, int view_wi
 
   // render all shadow casting point lights
   ex_dbgprofiler.begin[ex_dbgprofiler_lighting_render] = glfwGetTime();
-  for (int i=0; i<EX_SCENE_BIGGEST_LIGHT; i++) {
-    ex_point_light_t *pl = i > EX_MAX_POINT_LIGHTS ? NULL : s->point_lights[i];
-    
-    if (pl == NULL || !pl->is_shadow)
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  glEnable(GL_SCISSOR_TEST);
+  for (size_t i=0; i<s->point_lights.len; i++) {
+    ex_point_light_t *pl = s->point_lights.items[i];
+    if (!pl->is_shadow || !pl->is_visible)
       continue;
 
-    // point light
-    if (pl != NULL) {
-      if (pl->is_visible) {
-        glUniform1i(ex_uniform(ex_gmainshader, "u_point_active"), 1);
-        ex_point_light_draw(pl, ex_gmainshader, NULL, 1);
-      } else {
-        glUniform1i(ex_uniform(ex_gmainshader, "u_point_active"), 0);
-      } 
-    }
+    // only shade the pixels the light reaches
+    if (!ex_scene_light_scissor(s, pl, viewport))
+      continue;
+
+    glUniform1i(ex_uniform(ex_gmainshader, "u_point_active"), 1);
+    ex_point_light_draw(pl, ex_gmainshader, NULL, 1);
 
     // render gbuffer to screen quad
-    if (pl != NULL) {
-      if (s->ssao)
-        ssao_bind_texture(ex_gmainshader);
-      else
-        ssao_bind_default(ex_gmainshader);
+    if (s->ssao)
+      ssao_bind_texture(ex_gmainshader);
+    else
+      ssao_bind_default(ex_gmainshader);
 
-      ex_gbuffer_render(ex_gmainshader);
-    }
+    ex_gbuffer_render(ex_gmainshader);
   }
+  glDisable(GL_SCISSOR_TEST);
   glDisable(GL_BLEND);
   ex_dbgprofiler.end[ex_dbgprofiler_lighting_render] = glfwGetTime();
 
@@ -353,7 +967,7 @@ void ex_scene_render_deferred(ex_scene_t *s, int view_x, int view_y, int view_wi
   glUniformMatrix4fv(ex_uniform(s->primshader, "u_inverse_view"), 1, GL_FALSE, matrices->inverse_view[0]);
 
   if (ex_dbgprofiler.render_octree)
-    ex_octree_render(s->coll_tree);
+    ex_octree_compact_render(s->coll_tree);
 
   // render screen quad
   glBindFramebuffer(GL_FRAMEBUFFER, 0);
@@ -394,29 +1008,17 @@ void ex_scene_render_forward(ex_scene_t *s, int view_x, int view_y, int view_wid
   glDisable(GL_BLEND);
   glCullFace(GL_BACK);
 
-  // do all non shadow casting lights in a single pass
-  // including the one directional light
-  // and lights outside of the shadow render range
-  int pcount = 0;
-  char buff[64];
-  for (int i=0; i<EX_MAX_POINT_LIGHTS; i++) {
-    ex_point_light_t *pl = s->point_lights[i];
-    if (pl == NULL || !pl->is_visible)
-      continue;
-
-    if (!pl->is_shadow) {
-      sprintf(buff, "u_point_lights[%d]", pcount);
-      ex_point_light_draw(pl, s->forwardshader, buff, 0);
-      pcount++;
-    }
-  }
+  // do all non shadow casting lights in the ambient
+  // pass, each pixel only loops over its froxels lights
+  ex_scene_cluster_lights(s, matrices);
+  ex_cluster_bind(s->cluster, s->forwardshader);
 
   glUniform1i(ex_uniform(s->forwardshader, "u_point_active"), 0);
-  glUniform1i(ex_uniform(s->forwardshader, "u_point_count"), pcount);
+  glUniform1i(ex_uniform(s->forwardshader, "u_cluster_active"), 1);
   glUniform1i(ex_uniform(s->forwardshader, "u_ambient_pass"), 1);
-  ex_scene_render_models(s, 0, 0);
+  ex_scene_render_visible(s);
   glUniform1i(ex_uniform(s->forwardshader, "u_ambient_pass"), 0);
-  glUniform1i(ex_uniform(s->forwardshader, "u_point_count"), 0);
+  glUniform1i(ex_uniform(s->forwardshader, "u_cluster_active"), 0);
 
   // enable blending for second pass onwards
   glEnable(GL_BLEND);
@@ -424,16 +1026,22 @@ void ex_scene_render_forward(ex_scene_t *s, int view_x, int view_y, int view_wid
 
   // render all shadow casting point lights
   ex_dbgprofiler.begin[ex_dbgprofiler_lighting_render] = glfwGetTime();
-  for (int i=0; i<EX_SCENE_BIGGEST_LIGHT; i++) {
-    ex_point_light_t *pl = i > EX_MAX_POINT_LIGHTS ? NULL : s->point_lights[i];
-    
-    if (pl == NULL || !pl->is_shadow || !pl->is_visible)
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  glEnable(GL_SCISSOR_TEST);
+  for (size_t i=0; i<s->point_lights.len; i++) {
+    ex_point_light_t *pl = s->point_lights.items[i];
+    if (!pl->is_shadow || !pl->is_visible)
+      continue;
+
+    if (!ex_scene_light_scissor(s, pl, viewport))
       continue;
 
     glUniform1i(ex_uniform(s->forwardshader, "u_point_active"), 1);
     ex_point_light_draw(pl, s->forwardshader, NULL, 0);
-    ex_scene_render_models(s, 0, 0);
+    ex_scene_render_visible(s);
   }
+  glDisable(GL_SCISSOR_TEST);
   glDisable(GL_BLEND);
   ex_dbgprofiler.end[ex_dbgprofiler_lighting_render] = glfwGetTime();
 
@@ -446,7 +1054,7 @@ void ex_scene_render_forward(ex_scene_t *s, int view_x, int view_y, int view_wid
   glUniformMatrix4fv(ex_uniform(s->primshader, "u_inverse_view"), 1, GL_FALSE, matrices->inverse_view[0]);
 
   if (ex_dbgprofiler.render_octree)
-    ex_octree_render(s->coll_tree);
+    ex_octree_compact_render(s->coll_tree);
 
   // render screen quad
   glBindFramebuffer(GL_FRAMEBUFFER, 0);
@@ -458,62 +1066,32 @@ void ex_scene_render_forward(ex_scene_t *s, int view_x, int view_y, int view_wid
 
 void ex_scene_manage_lights(ex_scene_t *s)
 {
-  return;
-
-  // FIX THIS
+  // point lights, culled by how far they reach
+  size_t len = s->point_lights.len;
+  for (size_t i=0; i<len; i++) {
+    ex_point_light_t *pl = s->point_lights.items[i];
+    for (int j=0; j<3; j++)
+      s->light_center[j][i] = pl->position[j];
+    s->light_radius[i] = ex_point_light_radius(pl);
 
-  // set our position and front vector
-  vec3 thispos, thisfront;
-  /*if (s->fps_camera != NULL) {
-    memcpy(thisfront, s->fps_camera->front, sizeof(vec3));
-    memcpy(thispos, s->fps_camera->position, sizeof(vec3));
-  }*/
-
-  // point lights
-  for (int i=0; i<EX_MAX_POINT_LIGHTS; i++) {
-    ex_point_light_t *pl = s->point_lights[i];
-    if (pl == NULL)
-      continue;
-
-    // direction to light
     vec3 thatpos;
-    vec3_sub(thatpos, pl->position, thispos);
+    vec3_sub(thatpos, pl->position, s->camera_position);
     pl->distance_to_cam = vec3_len(thatpos);
-    vec3_norm(thatpos, thatpos);
-    vec3_norm(thisfront, thisfront);
-
-    // dot to light
-    float f = vec3_mul_inner(thisfront, thatpos);
-
-    // check if its behind us and far away
-    float offset = fmax(fmax(pl->color[0], pl->color[1]), pl->color[2]);
-    if (f < 0.1f-(offset*0.5) && pl->distance_to_cam > EX_POINT_FAR_PLANE*offset)
-      pl->is_visible = 0;
-    else
-      pl->is_visible = 1;
+    pl->is_visible = 0;
   }
 
-  // spot lights
-  for (int i=0; i<EX_MAX_SPOT_LIGHTS; i++) {
-    ex_spot_light_t *sl = s->spot_lights[i];
-    if (sl == NULL)
-      continue;
+  size_t visible = ex_frustum_cull_spheres(&s->frustum, s->light_center, s->light_radius, len, s->visible_lights);
+  for (size_t i=0; i<visible; i++)
+    ((ex_point_light_t *)s->point_lights.items[s->visible_lights[i]])->is_visible = 1;
+
+  // spot lights, the cone fits in its far plane sphere
+  for (size_t i=0; i<s->spot_lights.len; i++) {
+    ex_spot_light_t *sl = s->spot_lights.items[i];
 
-    // direction to light
     vec3 thatpos;
-    vec3_sub(thatpos, sl->position, thispos);
+    vec3_sub(thatpos, sl->position, s->camera_position);
     sl->distance_to_cam = vec3_len(thatpos);
-    vec3_norm(thatpos, thatpos);
-    vec3_norm(thisfront, thisfront);
-
-    // dot to light
-    float f = vec3_mul_inner(thisfront, thatpos);
-
-    // check if its behind us and far away
-    if (f <= -0.5f && sl->distance_to_cam > EX_SPOT_FAR_PLANE)
-      sl->is_visible = 0;
-    else
-      sl->is_visible = 1;
+    sl->is_visible = ex_frustum_sphere(&s->frustum, sl->position, EX_SPOT_FAR_PLANE);
   }
 }
 
@@ -545,16 +1123,37 @@ void ex_scene_dbgui(ex_scene_t *s)
   igEnd();
 }
 
-void ex_scene_render_models(ex_scene_t *s, GLuint shader, int shadows)
+void ex_scene_render_visible(ex_scene_t *s)
 {
   if (ex_dbgprofiler.wireframe)
     glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
-  for (int i=0; i<EX_SCENE_MAX_MODELS; i++) {
-    if (!s->models[i])
+  ex_render_queue_submit(s->queue);
+  glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+}
+
+void ex_scene_render_casters(ex_scene_t *s, ex_point_light_t *l, int list)
+{
+  GLuint mask_loc = ex_uniform(l->shader, "u_face_mask");
+  for (size_t i=0; i<l->casters_len[list]; i++) {
+    ex_point_caster_t *c = &l->casters[list][i];
+    ex_model_t *m = ex_pool_get(&s->models, c->handle);
+    if (m == NULL)
       continue;
-    
-    ex_model_t *m = s->models[i];
+
+    glUniform1i(mask_loc, c->faces);
+    ex_model_draw(m, l->shader);
+  }
+  glUniform1i(mask_loc, EX_POINT_ALL_FACES);
+}
+
+void ex_scene_render_models(ex_scene_t *s, GLuint shader, int shadows)
+{
+  if (ex_dbgprofiler.wireframe)
+    glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+
+  for (size_t i=0; i<s->models.len; i++) {
+    ex_model_t *m = s->models.items[i];
 
     if (shadows == 0) {
       shader = m->shader;
@@ -580,12 +1179,43 @@ void ex_scene_destroy(ex_scene_t *s)
   printf("Cleaning up scene\n");
 
   // cleanup point lights
-  for (int i=0; i<EX_MAX_POINT_LIGHTS; i++) {
-    if (s->point_lights[i] != NULL) {
-      ex_point_light_destroy(s->point_lights[i]);
-    }
+  for (size_t i=0; i<s->point_lights.len; i++)
+    ex_point_light_destroy(s->point_lights.items[i]);
+
+  // cleanup collision data
+  ex_octree_compact_destroy(s->coll_tree);
+  ex_bvh_destroy(s->coll_bvh);
+  ex_coll_cache_destroy(&s->coll_cache);
+  while (s->colliders.len > 0)
+    ex_scene_remove_collider(s, s->colliders.items[s->colliders.len - 1]);
+  ex_loose_octree_destroy(s->dyn_tree);
+  ex_cluster_destroy(s->cluster);
+  ex_render_queue_destroy(s->queue);
+  ex_model_anim_scratch_destroy(&s->anim_scratch);
+
+  if (s->instances != NULL)
+    ex_instance_ring_destroy(s->instances);
+
+  ex_pool_free(&s->models);
+  ex_pool_free(&s->point_lights);
+  ex_pool_free(&s->spot_lights);
+  ex_pool_free(&s->reflection_probes);
+  ex_pool_free(&s->colliders);
+  for (int i=0; i<3; i++) {
+    free(s->model_center[i]);
+    free(s->model_half[i]);
+    free(s->caster_center[i]);
+    free(s->caster_half[i]);
+    free(s->light_center[i]);
   }
+  free(s->visible_models);
+  free(s->visible_lights);
+  free(s->light_radius);
+  free(s->caster_handles);
+  free(s->caster_versions);
+  free(s->caster_static);
 
   // cleanup framebuffers
-  ex_framebuffer_destroy(s->framebuffer);
+  if (s->framebuffer != NULL)
+    ex_framebuffer_destroy(s->framebuffer);
 }
\ No newline at end of file
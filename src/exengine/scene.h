@@ -5,13 +5,12 @@
   want to render each frame, as
   well as your collision vertices
   which are stored in an internal
-  octree.
+  octree, or a bvh when the scene
+  is made with EX_SCENE_BVH.
 
-  Currently it uses a deferred renderer,
-  and has semi-function light culling.
-
-  The following are features that need implementing:
-  * Frustrum culling for models, lights etc
+  Currently it uses a deferred renderer.
+  Models and lights are frustum culled
+  against the camera before each draw.
 */
 
 #ifndef EX_SCENE_H
@@ -26,21 +25,27 @@
 #include "dirlight.h"
 #include "spotlight.h"
 #include "octree.h"
+#include "looseoctree.h"
+#include "bvh.h"
+#include "collision.h"
 #include "reflectionprobe.h"
 #include "framebuffer.h"
+#include "frustum.h"
+#include "cluster.h"
+#include "renderqueue.h"
+#include "instancering.h"
+#include "pool.h"
 
 #define GLEW_STATIC
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
-#define EX_MAX_POINT_LIGHTS 500
-#define EX_MAX_SPOT_LIGHTS 128
-#define EX_MAX_REFLECTIONS 50
-
-// this should be the value of the biggest define above
-#define EX_SCENE_BIGGEST_LIGHT 500
+// half the width of the dynamic collision tree,
+// colliders outside of it still work, just slower
+#define EX_SCENE_DYNAMIC_SIZE 1024.0f
 
-#define EX_SCENE_MAX_MODELS 500
+// rays handed to each job thread at once
+#define EX_SCENE_RAY_JOB_SIZE 64
 
 /*
   The renderer feature flags,
@@ -50,22 +55,106 @@
 */
 #define EX_SCENE_SSAO 1
 #define EX_SCENE_DEFERRED 2
+#define EX_SCENE_BVH 4
+
+// collision only, no gl resources are made,
+// for servers and tools without a window
+#define EX_SCENE_HEADLESS 8
+
+/*
+  A dynamic collision mesh, moving platforms,
+  doors etc.  Kept in its own loose octree so
+  moving one never rebuilds the static tree.
+*/
+typedef struct {
+  vec3 *vertices, *world;
+  size_t len;
+  uint32_t index;  // in the scenes colliders pool, and the dyn_tree data
+  uint32_t handle; // in the dyn_tree
+} ex_collider_t;
+
+/*
+  A ray starting at from along to, hits
+  are found up to the length of to away.
+*/
+typedef struct {
+  vec3 from, to;
+} ex_ray_t;
+
+typedef struct {
+  int hit;
+  float dist;
+  int tri;                 // triangle in coll_vertices, or the colliders world vertices
+  ex_collider_t *collider; // NULL for static geometry
+  ex_plane_t plane;
+} ex_ray_hit_t;
+
+/*
+  A shape query contact with the static
+  geometry, the normal points from the
+  triangle towards the shape.
+*/
+typedef struct {
+  int tri;     // triangle in coll_vertices
+  vec3 point;  // on the triangle
+  vec3 normal;
+  float depth; // overlaps, how far the shape is inside
+  float t;     // sweeps, fraction of motion at first contact
+} ex_contact_t;
 
 typedef struct {
   GLuint shader, primshader, forwardshader, defaultshader;
   list_t *coll_list;
   ex_skybox_t *skybox;
   vec3 gravity;
-  ex_model_t *models[EX_SCENE_MAX_MODELS];
-  ex_point_light_t *point_lights[EX_MAX_POINT_LIGHTS];
-  ex_spot_light_t *spot_lights[EX_MAX_SPOT_LIGHTS];
   ex_dir_light_t *dir_light;
-  ex_reflection_t *reflection_probes[EX_MAX_REFLECTIONS];
+
+  // dense and growable, addressed by handle
+  ex_pool_t models;            // ex_model_t
+  ex_pool_t point_lights;      // ex_point_light_t
+  ex_pool_t spot_lights;       // ex_spot_light_t
+  ex_pool_t reflection_probes; // ex_reflection_t
   
-  ex_octree_t *coll_tree;
+  ex_octree_compact_t *coll_tree;
+  ex_bvh_t *coll_bvh;
   int collision_built;
+  uint32_t coll_version; // bumped on every static rebuild
   vec3 *coll_vertices;
   size_t coll_vertices_last;
+  ex_coll_cache_t coll_cache;
+  ex_loose_octree_t *dyn_tree;
+  ex_pool_t colliders;         // ex_collider_t
+
+  /* non shadow casting lights, binned each draw */
+  ex_cluster_t *cluster;
+
+  /* visible meshes sorted by state, built by ex_scene_cull */
+  ex_render_queue_t *queue;
+
+  /* ex_model_update_batch working arrays */
+  ex_model_anim_scratch_t anim_scratch;
+
+  /* moving models instance data, NULL when headless */
+  ex_instance_ring_t *instances;
+
+  /* culling, rebuilt by ex_scene_cull, indices
+     are into the pools items and grow with them */
+  ex_frustum_t frustum;
+  float *model_center[3], *model_half[3];
+  uint32_t *visible_models;
+  size_t visible_models_len, models_cap;
+  float *light_center[3], *light_radius;
+  uint32_t *visible_lights;
+  size_t lights_cap;
+  vec3 camera_position;
+
+  // shadow casters, caster_version bumps when any change
+  float *caster_center[3], *caster_half[3];
+  ex_handle_t *caster_handles;
+  uint32_t *caster_versions;
+  uint8_t *caster_static;
+  size_t casters_len;
+  uint32_t caster_version;
 
   /* dbug vars */
   int dynplightc, shdplightc, plightc, dlightc, slightc, modelc;
@@ -75,6 +164,9 @@ typedef struct {
   /* rendering features */
   int ssao;
   int deferred;
+
+  /* collision features */
+  int bvh;
 } ex_scene_t;
 
 /**
@@ -94,46 +186,214 @@ ex_scene_t* ex_scene_new(uint8_t flags);
  */
 void ex_scene_add_collision(ex_scene_t *s, ex_model_t *m);
 
+/**
+ * [ex_scene_add_collision_vertices add triangles to the coll tree]
+ * @param s        [the scene to use]
+ * @param vertices [three per triangle, copied]
+ * @param len      [the vertex count]
+ */
+void ex_scene_add_collision_vertices(ex_scene_t *s, vec3 *vertices, size_t len);
+
 /**
  * [ex_scene_build_collision build the collision tree]
  * @param s [the scene to use]
  */
 void ex_scene_build_collision(ex_scene_t *s);
 
+/**
+ * [ex_scene_query_collision gather static collision triangles near bounds]
+ * @param s      [the scene to use]
+ * @param bounds [the bounds to test]
+ * @param out    [reset, then filled with coll_vertices indices]
+ *
+ * Uses the bvh when the scene was made
+ * with EX_SCENE_BVH, the octree otherwise.
+ */
+void ex_scene_query_collision(ex_scene_t *s, ex_rect_t *bounds, ex_query_buffer_t *out);
+
+/**
+ * [ex_scene_raycast find the nearest hit for each ray]
+ * @param s     [the scene to use]
+ * @param rays  [the rays to cast]
+ * @param hits  [filled with each rays nearest hit]
+ * @param count [the ray count]
+ *
+ * The static tree, then the dynamic one, are
+ * walked front to back and stop once nothing
+ * closer can be hit.  Rays are split
+ * across the job threads, the scene must not be
+ * changed until this returns.
+ */
+void ex_scene_raycast(ex_scene_t *s, ex_ray_t *rays, ex_ray_hit_t *hits, size_t count);
+
+/**
+ * [ex_scene_overlap_sphere find static triangles touching a sphere]
+ * @param  s        [the scene to use]
+ * @param  center   [the sphere center]
+ * @param  radius   [the sphere radius]
+ * @param  contacts [filled with a contact per triangle]
+ * @param  max      [the size of contacts]
+ * @return          [the number of contacts, at most max]
+ *
+ * The shape queries walk the collision tree
+ * directly and never allocate, so they are
+ * cheap enough for triggers and placement
+ * checks.  Like ex_scene_raycast they can be
+ * called from job threads.
+ */
+size_t ex_scene_overlap_sphere(ex_scene_t *s, vec3 center, float radius, ex_contact_t *contacts, size_t max);
+
+/**
+ * [ex_scene_overlap_aabb find static triangles touching a box]
+ * @param  s        [the scene to use]
+ * @param  box      [the box]
+ * @param  contacts [filled with a contact per triangle]
+ * @param  max      [the size of contacts]
+ * @return          [the number of contacts, at most max]
+ */
+size_t ex_scene_overlap_aabb(ex_scene_t *s, ex_rect_t *box, ex_contact_t *contacts, size_t max);
+
+/**
+ * [ex_scene_overlap_capsule find static triangles touching a capsule]
+ * @param  s        [the scene to use]
+ * @param  a        [capsule segment start]
+ * @param  b        [capsule segment end]
+ * @param  radius   [the capsule radius]
+ * @param  contacts [filled with a contact per triangle]
+ * @param  max      [the size of contacts]
+ * @return          [the number of contacts, at most max]
+ */
+size_t ex_scene_overlap_capsule(ex_scene_t *s, vec3 a, vec3 b, float radius, ex_contact_t *contacts, size_t max);
+
+/**
+ * [ex_scene_sweep_sphere first static contact of a moving sphere]
+ * @param  s      [the scene to use]
+ * @param  center [the sphere center]
+ * @param  radius [the sphere radius]
+ * @param  motion [the spheres movement]
+ * @param  hit    [the first contact]
+ * @return        [1 if anything was hit]
+ *
+ * Uses the entity sweep, so like entities
+ * only front faces block the sphere.  Like
+ * the other sweeps, a shape that already
+ * touches geometry hits at t 0, also when
+ * there is no motion.
+ */
+int ex_scene_sweep_sphere(ex_scene_t *s, vec3 center, float radius, vec3 motion, ex_contact_t *hit);
+
+/**
+ * [ex_scene_sweep_aabb first static contact of a moving box]
+ * @param  s      [the scene to use]
+ * @param  box    [the box]
+ * @param  motion [the boxes movement]
+ * @param  hit    [the first contact]
+ * @return        [1 if anything was hit]
+ */
+int ex_scene_sweep_aabb(ex_scene_t *s, ex_rect_t *box, vec3 motion, ex_contact_t *hit);
+
+/**
+ * [ex_scene_sweep_capsule first static contact of a moving capsule]
+ * @param  s      [the scene to use]
+ * @param  a      [capsule segment start]
+ * @param  b      [capsule segment end]
+ * @param  radius [the capsule radius]
+ * @param  motion [the capsules movement]
+ * @param  hit    [the first contact]
+ * @return        [1 if anything was hit]
+ */
+int ex_scene_sweep_capsule(ex_scene_t *s, vec3 a, vec3 b, float radius, vec3 motion, ex_contact_t *hit);
+
+/**
+ * [ex_scene_add_collider add a models vertices as a dynamic collider]
+ * @param  s         [the scene to use]
+ * @param  m         [the model which contains the vertices]
+ * @param  transform [the colliders world transform]
+ * @return           [the new collider, NULL without vertices]
+ *
+ * Like ex_scene_add_collision the models
+ * vertices are taken over by the scene.
+ */
+ex_collider_t* ex_scene_add_collider(ex_scene_t *s, ex_model_t *m, mat4x4 transform);
+
+/**
+ * [ex_scene_move_collider set a colliders world transform]
+ * @param s         [the scene to use]
+ * @param c         [the collider to move]
+ * @param transform [the new world transform]
+ */
+void ex_scene_move_collider(ex_scene_t *s, ex_collider_t *c, mat4x4 transform);
+
+/**
+ * [ex_scene_remove_collider remove and free a collider]
+ * @param s [the scene to use]
+ * @param c [the collider to remove]
+ */
+void ex_scene_remove_collider(ex_scene_t *s, ex_collider_t *c);
+
 /**
  * [ex_scene_add_model add a model to the render list]
- * @param s [the scene]
- * @param m [the model to add]
+ * @param  s [the scene]
+ * @param  m [the model to add]
+ * @return   [handle for ex_scene_remove_model]
  */
-void ex_scene_add_model(ex_scene_t *s, ex_model_t *m);
+ex_handle_t ex_scene_add_model(ex_scene_t *s, ex_model_t *m);
 
 /**
  * [ex_scene_remove_model remove a model from the render list]
- * @param s [the scene]
- * @param m [the model to remove]
+ * @param  s [the scene]
+ * @param  h [the handle from ex_scene_add_model]
+ * @return   [the model, NULL if already removed]
  */
-void ex_scene_remove_model(ex_scene_t *s, ex_model_t *m);
+ex_model_t* ex_scene_remove_model(ex_scene_t *s, ex_handle_t h);
 
 /**
  * [ex_scene_add_pointlight]
- * @param s  [the scene to use]
- * @param pl [the pointlight to add]
+ * @param  s  [the scene to use]
+ * @param  pl [the pointlight to add]
+ * @return    [handle for ex_scene_remove_pointlight]
+ */
+ex_handle_t ex_scene_add_pointlight(ex_scene_t *s, ex_point_light_t *pl);
+
+/**
+ * [ex_scene_remove_pointlight]
+ * @param  s [the scene to use]
+ * @param  h [the handle from ex_scene_add_pointlight]
+ * @return   [the light, NULL if already removed]
  */
-void ex_scene_add_pointlight(ex_scene_t *s, ex_point_light_t *pl);
+ex_point_light_t* ex_scene_remove_pointlight(ex_scene_t *s, ex_handle_t h);
 
 /**
  * [ex_scene_add_spotlight]
- * @param s  [the scene to use]
- * @param pl [the spotlight to add]
+ * @param  s  [the scene to use]
+ * @param  pl [the spotlight to add]
+ * @return    [handle for ex_scene_remove_spotlight]
  */
-void ex_scene_add_spotlight(ex_scene_t *s, ex_spot_light_t *pl);
+ex_handle_t ex_scene_add_spotlight(ex_scene_t *s, ex_spot_light_t *pl);
+
+/**
+ * [ex_scene_remove_spotlight]
+ * @param  s [the scene to use]
+ * @param  h [the handle from ex_scene_add_spotlight]
+ * @return   [the light, NULL if already removed]
+ */
+ex_spot_light_t* ex_scene_remove_spotlight(ex_scene_t *s, ex_handle_t h);
 
 /**
  * [ex_scene_add_reflection]
- * @param s [the scene to use]
- * @param r [the relfection probe to add]
+ * @param  s [the scene to use]
+ * @param  r [the relfection probe to add]
+ * @return   [handle for ex_scene_remove_reflection]
+ */
+ex_handle_t ex_scene_add_reflection(ex_scene_t *s, ex_reflection_t *r);
+
+/**
+ * [ex_scene_remove_reflection]
+ * @param  s [the scene to use]
+ * @param  h [the handle from ex_scene_add_reflection]
+ * @return   [the probe, NULL if already removed]
  */
-void ex_scene_add_reflection(ex_scene_t *s, ex_reflection_t *r);
+ex_reflection_t* ex_scene_remove_reflection(ex_scene_t *s, ex_handle_t h);
 
 /**
  * [ex_scene_update builds collision, updates models etc]
@@ -175,13 +435,36 @@ void ex_scene_render_deferred(ex_scene_t *s, int x, int y, int width, int height
  */
 void ex_scene_render_forward(ex_scene_t *s, int x, int y, int width, int height, ex_camera_matrices_t *matrices);
 
+/**
+ * [ex_scene_cull find the models and lights in view]
+ * @param s        [the scene to cull]
+ * @param matrices [the view to cull against]
+ *
+ * Fills visible_models with the indices into
+ * models.items that might be on screen, and sets is_visible
+ * on the lights.  ex_scene_draw does this itself,
+ * only uses the model bounds so it works without
+ * a gl context.
+ */
+void ex_scene_cull(ex_scene_t *s, ex_camera_matrices_t *matrices);
+
+/**
+ * [ex_scene_cluster_lights bin the non shadow casting lights]
+ * @param s        [the scene to use]
+ * @param matrices [the view to bin for]
+ *
+ * Called by the renderers after ex_scene_cull,
+ * uploads only when there is a gl context.
+ */
+void ex_scene_cluster_lights(ex_scene_t *s, ex_camera_matrices_t *matrices);
+
 /**
  * [ex_scene_manage_lights cull lights]
  * @param s [the scene to use]
  *
- * Currently broken-ish, isn't very good
- * anyway.  Needs to be replaced with
- * generic frustrum culling.
+ * Tests the sphere each light reaches against
+ * s->frustum, so a light out of view that still
+ * lights visible geometry is kept.
  */
 void ex_scene_manage_lights(ex_scene_t *s);
 
@@ -199,6 +482,20 @@ void ex_scene_dbgui(ex_scene_t *s);
  */
 void ex_scene_render_models(ex_scene_t *s, GLuint shader, int shadows);
 
+/**
+ * [ex_scene_render_visible renders the models left by ex_scene_cull]
+ * @param s [the scene to use]
+ */
+void ex_scene_render_visible(ex_scene_t *s);
+
+/**
+ * [ex_scene_render_casters renders one of a light's caster lists]
+ * @param s    [the scene to use]
+ * @param l    [the light, after ex_point_light_cull_casters]
+ * @param list [EX_POINT_STATIC or EX_POINT_DYNAMIC]
+ */
+void ex_scene_render_casters(ex_scene_t *s, ex_point_light_t *l, int list);
+
 /**
  * [ex_scene_resize resize internal frambuffers]
  * @param s      [the scene to resize]
@@ -0,0 +1,176 @@
+#include "transform.h"
+#include <string.h>
+#include <math.h>
+#include <inttypes.h>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define EX_TRANSFORM_WIDTH 8
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define EX_TRANSFORM_WIDTH 4
+#else
+#define EX_TRANSFORM_WIDTH 1
+#endif
+
+#if EX_TRANSFORM_WIDTH == 8
+typedef __m256 ex_vf_t;
+
+static inline ex_vf_t ex_vf_set1(float f)              { return _mm256_set1_ps(f); }
+static inline ex_vf_t ex_vf_load(const float *p)       { return _mm256_loadu_ps(p); }
+static inline void    ex_vf_store(float *p, ex_vf_t a) { _mm256_storeu_ps(p, a); }
+static inline ex_vf_t ex_vf_add(ex_vf_t a, ex_vf_t b)  { return _mm256_add_ps(a, b); }
+static inline ex_vf_t ex_vf_sub(ex_vf_t a, ex_vf_t b)  { return _mm256_sub_ps(a, b); }
+static inline ex_vf_t ex_vf_mul(ex_vf_t a, ex_vf_t b)  { return _mm256_mul_ps(a, b); }
+static inline ex_vf_t ex_vf_and(ex_vf_t a, ex_vf_t b)  { return _mm256_and_ps(a, b); }
+static inline ex_vf_t ex_vf_or(ex_vf_t a, ex_vf_t b)   { return _mm256_or_ps(a, b); }
+static inline ex_vf_t ex_vf_xor(ex_vf_t a, ex_vf_t b)  { return _mm256_xor_ps(a, b); }
+static inline ex_vf_t ex_vf_eq(ex_vf_t a, ex_vf_t b)   { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+static inline ex_vf_t ex_vf_round(ex_vf_t a)           { return _mm256_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+static inline ex_vf_t ex_vf_select(ex_vf_t m, ex_vf_t a, ex_vf_t b) { return _mm256_blendv_ps(b, a, m); }
+#elif EX_TRANSFORM_WIDTH == 4
+typedef __m128 ex_vf_t;
+
+static inline ex_vf_t ex_vf_set1(float f)              { return _mm_set1_ps(f); }
+static inline ex_vf_t ex_vf_load(const float *p)       { return _mm_loadu_ps(p); }
+static inline void    ex_vf_store(float *p, ex_vf_t a) { _mm_storeu_ps(p, a); }
+static inline ex_vf_t ex_vf_add(ex_vf_t a, ex_vf_t b)  { return _mm_add_ps(a, b); }
+static inline ex_vf_t ex_vf_sub(ex_vf_t a, ex_vf_t b)  { return _mm_sub_ps(a, b); }
+static inline ex_vf_t ex_vf_mul(ex_vf_t a, ex_vf_t b)  { return _mm_mul_ps(a, b); }
+static inline ex_vf_t ex_vf_and(ex_vf_t a, ex_vf_t b)  { return _mm_and_ps(a, b); }
+static inline ex_vf_t ex_vf_or(ex_vf_t a, ex_vf_t b)   { return _mm_or_ps(a, b); }
+static inline ex_vf_t ex_vf_xor(ex_vf_t a, ex_vf_t b)  { return _mm_xor_ps(a, b); }
+static inline ex_vf_t ex_vf_eq(ex_vf_t a, ex_vf_t b)   { return _mm_cmpeq_ps(a, b); }
+static inline ex_vf_t ex_vf_round(ex_vf_t a)           { return _mm_cvtepi32_ps(_mm_cvtps_epi32(a)); }
+static inline ex_vf_t ex_vf_select(ex_vf_t m, ex_vf_t a, ex_vf_t b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+#else
+typedef union { float f; uint32_t u; } ex_vf_t;
+
+static inline ex_vf_t ex_vf_set1(float f)              { ex_vf_t r; r.f = f; return r; }
+static inline ex_vf_t ex_vf_load(const float *p)       { return ex_vf_set1(*p); }
+static inline void    ex_vf_store(float *p, ex_vf_t a) { *p = a.f; }
+static inline ex_vf_t ex_vf_add(ex_vf_t a, ex_vf_t b)  { return ex_vf_set1(a.f + b.f); }
+static inline ex_vf_t ex_vf_sub(ex_vf_t a, ex_vf_t b)  { return ex_vf_set1(a.f - b.f); }
+static inline ex_vf_t ex_vf_mul(ex_vf_t a, ex_vf_t b)  { return ex_vf_set1(a.f * b.f); }
+static inline ex_vf_t ex_vf_and(ex_vf_t a, ex_vf_t b)  { ex_vf_t r; r.u = a.u & b.u; return r; }
+static inline ex_vf_t ex_vf_or(ex_vf_t a, ex_vf_t b)   { ex_vf_t r; r.u = a.u | b.u; return r; }
+static inline ex_vf_t ex_vf_xor(ex_vf_t a, ex_vf_t b)  { ex_vf_t r; r.u = a.u ^ b.u; return r; }
+static inline ex_vf_t ex_vf_eq(ex_vf_t a, ex_vf_t b)   { ex_vf_t r; r.u = a.f == b.f ? 0xFFFFFFFFu : 0; return r; }
+static inline ex_vf_t ex_vf_round(ex_vf_t a)           { return ex_vf_set1(nearbyintf(a.f)); }
+static inline ex_vf_t ex_vf_select(ex_vf_t m, ex_vf_t a, ex_vf_t b) { return m.u ? a : b; }
+#endif
+
+// cephes style, reduced to a quarter turn around 0
+static void ex_vf_sincos(ex_vf_t x, ex_vf_t *s, ex_vf_t *c)
+{
+  ex_vf_t j = ex_vf_round(ex_vf_mul(x, ex_vf_set1(0.63661977236758134f)));
+
+  // x - j * pi/2, in three parts to keep precision
+  x = ex_vf_sub(x, ex_vf_mul(j, ex_vf_set1(1.5703125f)));
+  x = ex_vf_sub(x, ex_vf_mul(j, ex_vf_set1(4.837512969970703125e-4f)));
+  x = ex_vf_sub(x, ex_vf_mul(j, ex_vf_set1(7.54978995489188216e-8f)));
+
+  ex_vf_t z = ex_vf_mul(x, x);
+  ex_vf_t ps = ex_vf_add(ex_vf_mul(ex_vf_add(ex_vf_mul(ex_vf_set1(-1.9515295891e-4f), z), ex_vf_set1(8.3321608736e-3f)), z), ex_vf_set1(-1.6666654611e-1f));
+  ps = ex_vf_add(x, ex_vf_mul(ex_vf_mul(x, z), ps));
+  ex_vf_t pc = ex_vf_add(ex_vf_mul(ex_vf_add(ex_vf_mul(ex_vf_set1(2.443315711809948e-5f), z), ex_vf_set1(-1.388731625493765e-3f)), z), ex_vf_set1(4.166664568298827e-2f));
+  pc = ex_vf_add(ex_vf_sub(ex_vf_set1(1.0f), ex_vf_mul(z, ex_vf_set1(0.5f))), ex_vf_mul(ex_vf_mul(z, z), pc));
+
+  // quadrant, floor(j/4) is round(j/4 - 3/8) for whole j
+  ex_vf_t q = ex_vf_sub(j, ex_vf_mul(ex_vf_round(ex_vf_sub(ex_vf_mul(j, ex_vf_set1(0.25f)), ex_vf_set1(0.375f))), ex_vf_set1(4.0f)));
+  ex_vf_t q1 = ex_vf_eq(q, ex_vf_set1(1.0f));
+  ex_vf_t q2 = ex_vf_eq(q, ex_vf_set1(2.0f));
+  ex_vf_t q3 = ex_vf_eq(q, ex_vf_set1(3.0f));
+  ex_vf_t sign = ex_vf_set1(-0.0f);
+
+  ex_vf_t swap = ex_vf_or(q1, q3);
+  *s = ex_vf_xor(ex_vf_select(swap, pc, ps), ex_vf_and(ex_vf_or(q2, q3), sign));
+  *c = ex_vf_xor(ex_vf_select(swap, ps, pc), ex_vf_and(ex_vf_or(q1, q2), sign));
+}
+
+// one register of models, lanes past count are ignored
+static void ex_transform_compose_lanes(const float *position[3], const float *rotation[3], const float *scale, mat4x4 *const *out, size_t count)
+{
+  ex_vf_t sin[3], cos[3];
+  for (int i=0; i<3; i++) {
+    // whole turns off in degrees first, exact for sane angles
+    ex_vf_t d = ex_vf_load(rotation[i]);
+    d = ex_vf_sub(d, ex_vf_mul(ex_vf_round(ex_vf_mul(d, ex_vf_set1(1.0f / 360.0f))), ex_vf_set1(360.0f)));
+    ex_vf_sincos(ex_vf_mul(d, ex_vf_set1((float)(M_PI / 180.0))), &sin[i], &cos[i]);
+  }
+
+  ex_vf_t sx = sin[0], sy = sin[1], sz = sin[2];
+  ex_vf_t cx = cos[0], cy = cos[1], cz = cos[2];
+  ex_vf_t s = ex_vf_load(scale);
+
+  // columns of Ry * Rx * Rz, scaled
+  ex_vf_t sxsy = ex_vf_mul(sx, sy), sxcy = ex_vf_mul(sx, cy);
+  ex_vf_t cols[12] = {
+    ex_vf_mul(ex_vf_sub(ex_vf_mul(cz, cy), ex_vf_mul(sz, sxsy)), s),
+    ex_vf_mul(ex_vf_mul(sz, cx), s),
+    ex_vf_mul(ex_vf_add(ex_vf_mul(cz, sy), ex_vf_mul(sz, sxcy)), s),
+
+    ex_vf_mul(ex_vf_sub(ex_vf_set1(0.0f), ex_vf_add(ex_vf_mul(sz, cy), ex_vf_mul(cz, sxsy))), s),
+    ex_vf_mul(ex_vf_mul(cz, cx), s),
+    ex_vf_mul(ex_vf_sub(ex_vf_mul(cz, sxcy), ex_vf_mul(sz, sy)), s),
+
+    ex_vf_mul(ex_vf_sub(ex_vf_set1(0.0f), ex_vf_mul(cx, sy)), s),
+    ex_vf_mul(ex_vf_sub(ex_vf_set1(0.0f), sx), s),
+    ex_vf_mul(ex_vf_mul(cx, cy), s),
+
+    ex_vf_load(position[0]),
+    ex_vf_load(position[1]),
+    ex_vf_load(position[2])
+  };
+
+  float lanes[12][EX_TRANSFORM_WIDTH];
+  for (int i=0; i<12; i++)
+    ex_vf_store(lanes[i], cols[i]);
+
+  for (size_t i=0; i<count; i++) {
+    float (*m)[4] = *out[i];
+    for (int col=0; col<4; col++) {
+      m[col][0] = lanes[col*3+0][i];
+      m[col][1] = lanes[col*3+1][i];
+      m[col][2] = lanes[col*3+2][i];
+      m[col][3] = col == 3 ? 1.0f : 0.0f;
+    }
+  }
+}
+
+void ex_transform_compose_batch(float *const position[3], float *const rotation[3], const float *scale, mat4x4 *const *out, size_t count)
+{
+  size_t i = 0;
+  for (; i+EX_TRANSFORM_WIDTH<=count; i+=EX_TRANSFORM_WIDTH) {
+    const float *p[3] = {&position[0][i], &position[1][i], &position[2][i]};
+    const float *r[3] = {&rotation[0][i], &rotation[1][i], &rotation[2][i]};
+    ex_transform_compose_lanes(p, r, &scale[i], &out[i], EX_TRANSFORM_WIDTH);
+  }
+
+  // the tail goes through the same lanes, padded
+  if (i < count) {
+    float pad[7][EX_TRANSFORM_WIDTH];
+    memset(pad, 0, sizeof(pad));
+    for (size_t j=i; j<count; j++) {
+      for (int k=0; k<3; k++) {
+        pad[k][j-i]   = position[k][j];
+        pad[k+3][j-i] = rotation[k][j];
+      }
+      pad[6][j-i] = scale[j];
+    }
+
+    const float *p[3] = {pad[0], pad[1], pad[2]};
+    const float *r[3] = {pad[3], pad[4], pad[5]};
+    ex_transform_compose_lanes(p, r, pad[6], &out[i], count - i);
+  }
+}
+
+void ex_transform_compose(mat4x4 out, const vec3 position, const vec3 rotation, float scale)
+{
+  float p[3] = {position[0], position[1], position[2]};
+  float r[3] = {rotation[0], rotation[1], rotation[2]};
+  float *pp[3] = {&p[0], &p[1], &p[2]};
+  float *rp[3] = {&r[0], &r[1], &r[2]};
+  mat4x4 *o = (mat4x4 *)out;
+  ex_transform_compose_batch(pp, rp, &scale, &o, 1);
+}
@@ -0,0 +1,38 @@
+/* transform
+  Builds model matrices from a position,
+  euler rotation in degrees and uniform
+  scale, same as translating then rotating
+  around Y, X and Z then scaling.
+
+  The batched version works over SoA
+  arrays a simd register of models at a
+  time, the single version runs the very
+  same math so both give equal matrices.
+*/
+
+#ifndef EX_TRANSFORM_H
+#define EX_TRANSFORM_H
+
+#include <stddef.h>
+#include "mathlib.h"
+
+/**
+ * [ex_transform_compose build one model matrix]
+ * @param out      [the matrix]
+ * @param position [translation]
+ * @param rotation [euler angles in degrees]
+ * @param scale    [uniform scale]
+ */
+void ex_transform_compose(mat4x4 out, const vec3 position, const vec3 rotation, float scale);
+
+/**
+ * [ex_transform_compose_batch build many model matrices]
+ * @param position [x, y and z arrays]
+ * @param rotation [x, y and z arrays, degrees]
+ * @param scale    [scale array]
+ * @param out      [a matrix pointer per model]
+ * @param count    [how many models]
+ */
+void ex_transform_compose_batch(float *const position[3], float *const rotation[3], const float *scale, mat4x4 *const *out, size_t count);
+
+#endif // EX_TRANSFORM_H